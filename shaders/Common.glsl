@@ -5,6 +5,7 @@ struct DrawData
 	int normalId;
     int mruId;
 	int emissiveId;
+	float alphaCutoff;
 };
 
 struct Light 
@@ -31,4 +32,19 @@ vec2 getQuadPosition(uint index) {
 
 vec2 getQuadCoords(vec2 position) {
 	return 0.5 * vec2(position.x , -position.y) + vec2(0.5);
-}
\ No newline at end of file
+}
+
+// Direction through a texel of a cube face, uv in [-1, 1] with v going down the rows. The Vulkan face layout with y negated,
+// which is what the multiview passes render into each layer through their flipped viewport.
+vec3 cubeDirection(int face, vec2 uv) {
+	vec3 direction;
+	switch (face) {
+	case 0: direction = vec3(1.0, uv.y, -uv.x); break;
+	case 1: direction = vec3(-1.0, uv.y, uv.x); break;
+	case 2: direction = vec3(uv.x, -1.0, uv.y); break;
+	case 3: direction = vec3(uv.x, 1.0, -uv.y); break;
+	case 4: direction = vec3(uv.x, uv.y, 1.0); break;
+	default: direction = vec3(-uv.x, uv.y, -1.0); break;
+	}
+	return normalize(direction);
+}
@@ -0,0 +1,33 @@
+#version 460
+
+#extension GL_EXT_scalar_block_layout: require
+
+#include "Common.glsl"
+
+// The depth pre-pass, from the position stream alone. Computes the position exactly as PBR.vert does,
+// so the colour pass can test for equal depth.
+
+layout(GLOBAL_UNIFORM_BINDING) uniform GlobalUniform {
+    mat4 view;
+    mat4 projection;
+	vec3 viewPos;
+} ubo;
+
+layout(scalar, set = 0, binding = 1) buffer PerMeshDraw {
+    DrawData drawDatas[];
+};
+
+layout( push_constant ) uniform DrawIdOffset  {
+	uint drawOffset;
+};
+
+layout(location = 0) in vec3 inPosition;
+
+invariant gl_Position;
+
+void main() {
+	DrawData drawData = drawDatas[gl_DrawID + drawOffset];
+
+	vec3 fragPos = vec3(drawData.model * vec4(inPosition.xyz, 1.0));
+    gl_Position = ubo.projection * ubo.view * vec4(fragPos, 1.0);
+}
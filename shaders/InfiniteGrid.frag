@@ -1,52 +0,0 @@
-#version 460
-
-layout(location = 0) out vec4 outColor;
-
-layout(location = 0) in vec3 nearPoint;
-layout(location = 1) in vec3 farPoint;
-layout(location = 2) in mat4 fragView;
-layout(location = 6) in mat4 fragProjection;
-layout(location = 10) in float near;
-layout(location = 11) in float far;
-
-vec4 grid(vec3 fragPos, float scale) {
-    vec2 coord = fragPos.xz * scale; // use the scale variable to set the distance between the lines
-    vec2 derivative = fwidth(coord);
-    vec2 grid = abs(fract(coord - 0.5) - 0.5) / derivative;
-    float line = min(grid.x, grid.y);
-    float minimumz = min(derivative.y, 1);
-    float minimumx = min(derivative.x, 1);
-    vec4 color = vec4(0.2, 0.2, 0.2, 1.0 - min(line, 1.0));
-    // z axis
-    if(fragPos.x > -0.1 * minimumx && fragPos.x < 0.1 * minimumx)
-        color.z = 1.0;
-    // x axis
-    if(fragPos.z > -0.1 * minimumz && fragPos.z < 0.1 * minimumz)
-        color.x = 1.0;
-    return color;
-}
-
-float calculateDepth(vec3 pos) {
-    vec4 clipPos = fragProjection * fragView * vec4(pos.xyz, 1.0);
-    return (clipPos.z / clipPos.w);
-}
-
-float calculateLinearDepth(vec3 pos) {
-    vec4 clipPos = fragProjection * fragView * vec4(pos.xyz, 1.0);
-    float clipDepth = (clipPos.z / clipPos.w) * 2.0 - 1.0;
-    float linearDepth = (2.0 * near * far) / (far + near - clipDepth * (far - near));
-    return linearDepth / far;
-}
-
-void main() {
-    float t = -nearPoint.y / (farPoint.y - nearPoint.y);
-    vec3 fragPos = nearPoint + t * (farPoint - nearPoint);
-
-    gl_FragDepth = calculateDepth(fragPos);
-
-    float linearDepth = calculateLinearDepth(fragPos);
-    float fading = max(0, (0.5 - linearDepth));
-
-    outColor = (grid(fragPos, 10) + grid(fragPos, 1)) * float(t > 0);
-    outColor.a *= fading;
-}
\ No newline at end of file
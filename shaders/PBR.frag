@@ -6,7 +6,6 @@
 #include "Common.glsl"
 
 layout (constant_id = 0) const bool ALPHA_MASK = false;
-layout (constant_id = 1) const float ALPHA_MASK_CUTOFF = 0.0;
 
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec2 fragTexCoord;
@@ -17,6 +16,7 @@ layout(location = 5) flat in int fragNormalId;
 layout(location = 6) flat in int fragMRUId;
 layout(location = 7) flat in int fragEmissiveId;
 layout(location = 8) in vec3 viewPos;
+layout(location = 9) flat in float fragAlphaCutoff;
 
 layout(location = 0) out vec4 outColor;
 
@@ -47,7 +47,7 @@ void main() {
     if (fragColorId != -1) {
         color = texture(textures[fragColorId], fragTexCoord);
 		if (ALPHA_MASK) {
-			if (color.a < ALPHA_MASK_CUTOFF) {
+			if (color.a < fragAlphaCutoff) {
 				discard;
 			}
 		}
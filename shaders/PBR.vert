@@ -32,6 +32,10 @@ layout(location = 5) out int fragNormalId;
 layout(location = 6) out int fragMRUId;
 layout(location = 7) out int fragEmissiveId;
 layout(location = 8) out vec3 viewPos;
+layout(location = 9) flat out float fragAlphaCutoff;
+
+// Matches Depth.vert bit for bit, which the colour pass after a depth pre-pass relies on.
+invariant gl_Position;
 
 void main() {
 	// vec4 pos = constants.model * vec4(inPosition, 1.0);
@@ -51,4 +55,5 @@ void main() {
 	fragNormalId = drawData.normalId;
 	fragMRUId = drawData.mruId;
 	fragEmissiveId = drawData.emissiveId;
+	fragAlphaCutoff = drawData.alphaCutoff;
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#version 460 core
+
+// The last pass of the frame, see PostProcess.h. Reads the HDR target once and mixes the bloom over it, exposes, tonemaps,
+// draws the grid over the result and encodes to sRGB when the swapchain does not. What is switched off is specialized away.
+
+// As PostProcess::Tonemap.
+const uint TonemapNone = 0;
+const uint TonemapReinhard = 1;
+const uint TonemapAces = 2;
+
+layout(constant_id = 0) const uint tonemap = TonemapAces;
+layout(constant_id = 1) const bool drawGrid = false;
+layout(constant_id = 2) const bool encodeSrgb = false;
+
+layout(binding = 0) uniform sampler2D hdrImage;
+layout(binding = 1) uniform sampler2D bloomImage;
+layout(binding = 2) uniform sampler2D depthImage; // Only read with the grid.
+
+layout(push_constant) uniform PostProcessConstants {
+	mat4 inverseViewProjection;
+	// Rows of the view projection that give the clip depth of a point.
+	vec4 viewProjectionZ;
+	vec4 viewProjectionW;
+	float exposure;
+	float bloomStrength;
+} constants;
+
+layout (location = 0) in vec2 fragCoord;
+layout (location = 0) out vec4 FragColor;
+
+// Beyond this distance from the camera the grid has faded out.
+const float gridFadeDistance = 50.0;
+
+// Narkowicz's fit of the ACES filmic curve.
+vec3 aces(vec3 x) {
+	return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 linearToSrgb(vec3 color) {
+	return mix(12.92 * color, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, color));
+}
+
+// Credits to https://asliceofrendering.com/scene%20helper/2020/01/05/InfiniteGrid/.
+vec4 grid(vec3 fragPos, float scale) {
+	vec2 coord = fragPos.xz * scale;
+	vec2 derivative = fwidth(coord);
+	vec2 lines = abs(fract(coord - 0.5) - 0.5) / derivative;
+	float line = min(lines.x, lines.y);
+	float minimumz = min(derivative.y, 1);
+	float minimumx = min(derivative.x, 1);
+	vec4 color = vec4(0.2, 0.2, 0.2, 1.0 - min(line, 1.0));
+	// z axis
+	if (fragPos.x > -0.1 * minimumx && fragPos.x < 0.1 * minimumx)
+		color.z = 1.0;
+	// x axis
+	if (fragPos.z > -0.1 * minimumz && fragPos.z < 0.1 * minimumz)
+		color.x = 1.0;
+	return color;
+}
+
+vec3 unproject(vec2 ndc, float depth) {
+	vec4 point = constants.inverseViewProjection * vec4(ndc, depth, 1.0);
+	return point.xyz / point.w;
+}
+
+// The y = 0 plane where the scene in front of it leaves it visible.
+vec4 gridOverlay() {
+	// The scene is drawn with a flipped viewport, its y goes up the screen.
+	vec2 ndc = vec2(2.0 * fragCoord.x - 1.0, 1.0 - 2.0 * fragCoord.y);
+	vec3 nearPoint = unproject(ndc, 0.0);
+	vec3 farPoint = unproject(ndc, 1.0);
+	float t = -nearPoint.y / (farPoint.y - nearPoint.y);
+	vec3 fragPos = nearPoint + t * (farPoint - nearPoint);
+
+	// Called unconditionally, fwidth needs the whole quad.
+	vec4 color = grid(fragPos, 10) + grid(fragPos, 1);
+
+	float depth = dot(constants.viewProjectionZ, vec4(fragPos, 1.0)) / dot(constants.viewProjectionW, vec4(fragPos, 1.0));
+	float sceneDepth = texelFetch(depthImage, ivec2(gl_FragCoord.xy), 0).r;
+	float fading = max(0.0, 1.0 - distance(nearPoint, fragPos) / gridFadeDistance);
+	color.a *= fading * float(t > 0.0 && depth < sceneDepth);
+	return clamp(color, 0.0, 1.0);
+}
+
+void main()
+{
+	vec3 hdrColor = texture(hdrImage, fragCoord).rgb;
+	vec3 bloomColor = texture(bloomImage, fragCoord).rgb;
+	vec3 color = mix(hdrColor, bloomColor, constants.bloomStrength) * constants.exposure;
+
+	if (tonemap == TonemapReinhard) {
+		color = color / (1.0 + color);
+	} else if (tonemap == TonemapAces) {
+		color = aces(color);
+	}
+	color = clamp(color, 0.0, 1.0);
+
+	if (drawGrid) {
+		vec4 overlay = gridOverlay();
+		color = mix(color, overlay.rgb, overlay.a);
+	}
+
+	if (encodeSrgb) {
+		color = linearToSrgb(color);
+	}
+	FragColor = vec4(color, 1.0);
+}
@@ -2,12 +2,12 @@
 
 layout(location = 0) out vec4 outColor;
 
-layout(location = 0) in vec3 fragUV;
+layout(location = 0) in vec3 fragDirection;
 
-layout(set = 0, binding = 1) uniform samplerCube cubemap;
+layout(set = 0, binding = 0) uniform samplerCube cubemap;
 
 
 void main()
 {		
-    outColor = texture(cubemap, fragUV);
-}
\ No newline at end of file
+    outColor = texture(cubemap, fragDirection);
+}
@@ -1,18 +1,18 @@
 #version 460 core
 
-layout (location = 0) in vec3 inPos;
+#include "Common.glsl"
 
-layout (location = 0) out vec3 fragUV;
+layout (location = 0) out vec3 fragDirection;
 
-layout(set = 0, binding = 0) uniform Bind0 {
-    mat4 projection;
-    mat4 view;
+layout(push_constant) uniform SkyboxConstants {
+    mat4 inverseViewProjection; // Of the view without its translation.
 };
 
 void main()
 {
-    fragUV = inPos;  
-    // fragUV.xy *= -1.0;
-    vec4 pos = projection * mat4(mat3(view)) * vec4(inPos, 1.0);
-    gl_Position = pos.xyww;
-}
\ No newline at end of file
+    vec2 position = getQuadPosition(gl_VertexIndex);
+    // At the far plane, so only what the opaque geometry left uncovered passes the early depth test.
+    gl_Position = vec4(position, 1.0, 1.0);
+    // Left homogeneous, which is still the direction and interpolates linearly across the screen.
+    fragDirection = (inverseViewProjection * vec4(position, 1.0, 1.0)).xyz;
+}
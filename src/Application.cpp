@@ -3,10 +3,13 @@
 #include "Core/Common.h"
 #include "Core/Transition.h"
 #include "Core/Image.h"
+#include "Common/AllocationCounter.h"
 
 #include <VkBootstrap.h>
 #include <volk.h>
 #include <spdlog/spdlog.h>
+#include <BS_thread_pool.hpp>
+#include <tuple>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
@@ -140,9 +143,11 @@ namespace {
 		}
 	}
 
+	constexpr VkPresentModeKHR presentModes[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+	constexpr const char* presentModeNames[] = { "FIFO", "FIFO relaxed", "Mailbox", "Immediate" };
 }
 
-Application::Application(int width, int height)
+Application::Application(int width, int height, uint32_t framesInFlight, VkPresentModeKHR presentMode, bool asyncCompute, HdrPrecision hdrPrecision, bool depthPrepass)
 {
 	check(glfwInit());
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -207,7 +212,7 @@ Application::Application(int width, int height)
 	state_.camera_ = std::make_unique<ArcballCamera>(glm::vec3(2, 0, 0), glm::vec3(0, 0, 0), float(width), float(height), 0.01f, 50.0f);
 	//state_.camera_ = std::make_unique<FreeCamera>(glm::vec3(0, 2, 0), 0.f, -177.f, width, height, 0.01f, 50.0f);
 
-	device_.init(window_);
+	device_.init(window_, framesInFlight);
 	
 	// ImGui
 	IMGUI_CHECKVERSION();
@@ -231,10 +236,20 @@ Application::Application(int width, int height)
 	imgui_ = std::make_unique<ImGuiAdapter>(window_, device_);
 
 	//
-	swapchain_ = std::make_unique<Swapchain>(device_, device_.getDepthFormat());
+	swapchain_ = std::make_unique<Swapchain>(device_, device_.getDepthFormat(), presentMode);
 
-	scene_ = std::make_unique<Scene>(device_);
-	renderer_ = std::make_unique<Renderer>(device_, *scene_);
+	workers_ = std::make_unique<BS::thread_pool>();
+	scene_ = std::make_unique<Scene>(device_, *workers_);
+	renderer_ = std::make_unique<Renderer>(device_, *scene_, *workers_);
+	renderer_->setAsyncCompute(asyncCompute);
+	renderer_->setDepthPrepass(depthPrepass);
+	// Before the lighting maps are generated, so they are only generated once.
+	renderer_->setHdrPrecision(hdrPrecision);
+
+	for (uint32_t i = 0; i < device_.getMaxFramesInFlight(); i++)
+	{
+		frameArenas_.push_back(std::make_unique<LinearArena>());
+	}
 
 	// scene_->loadCubeMap("assets/rostock_laage_airport_4k.hdr");
 	scene_->loadCubeMap("assets/metro_noord_4k.hdr", renderer_->getIBRSet());
@@ -242,7 +257,7 @@ Application::Application(int width, int height)
 #define RE(r) \
 r->getVertexModule(),\
 r->getFragmentModule(),\
-r->getImageSet(),\
+r->getBindlessTextures(),\
 r->getPipelineLayout()
 
 	// scene_->loadGLTF("assets/subway/scene.gltf");
@@ -252,6 +267,13 @@ r->getPipelineLayout()
 	// scene_->loadGLTF("assets/glTF-Sample-Assets/Models/Sponza/glTF/Sponza.gltf");
 	scene_->loadGLTF("assets/glTF-Sample-Assets/Models/ABeautifulGame/glTF/ABeautifulGame.gltf", RE(renderer_));
 	// scene_->loadGLTF("assets/glTF-Sample-Assets/Models/Suzanne/glTF/Suzanne.gltf");
+
+	const auto pipelineStats = device_.getPipelineStats();
+	SPDLOG_INFO("Created {} pipelines in {:.2f}ms with a {} pipeline cache.", pipelineStats.count, pipelineStats.milliseconds, pipelineStats.warmCache ? "warm" : "cold");
+	const auto registryStats = device_.registry.getStats();
+	SPDLOG_INFO("Registry holds {} shader modules and {} set layouts, {} requests were shared.", registryStats.shaderModules, registryStats.setLayouts, registryStats.reused);
+	const auto descriptorStats = device_.descriptors.getStats();
+	SPDLOG_INFO("Persistent descriptor sets: {} in {} pools.", descriptorStats.sets, descriptorStats.pools);
 }
 
 void Application::run()
@@ -259,6 +281,7 @@ void Application::run()
 	while (!glfwWindowShouldClose(window_))
 	{
 		glfwPollEvents();
+		inputTime_ = Bench::record();
 
 		// Update Camera
 		int width, height;
@@ -327,7 +350,108 @@ void Application::run()
 			state_.lights_.push_back(Light{ lightPosition_ });
 			lightPosition_ = glm::vec3();
 		}
-		
+
+		ImGui::SeparatorText("Culling");
+		bool occlusionCulling = scene_->getOcclusionCulling();
+		if (ImGui::Checkbox("Occlusion culling", &occlusionCulling))
+		{
+			scene_->setOcclusionCulling(occlusionCulling);
+		}
+		const auto cullingStats = scene_->getCullingStats();
+		ImGui::Text("Culled %u / %u (%u occluder triangles, %.3fms)", cullingStats.culled, cullingStats.tested, cullingStats.occluderTriangles, cullingStats.rasterMs);
+		bool depthPrepass = renderer_->getDepthPrepass();
+		if (ImGui::Checkbox("Depth pre-pass", &depthPrepass))
+		{
+			renderer_->setDepthPrepass(depthPrepass);
+		}
+
+		ImGui::SeparatorText("Pipelines");
+		ImGui::Text("Variants compiling, drawn with the fallback: %u", scene_->getCompilingPipelines());
+
+		ImGui::SeparatorText("Memory");
+		const auto& arena = *frameArenas_[(frameIndex_ + frameArenas_.size() - 1) % frameArenas_.size()]; // Last frame's.
+		ImGui::Text("Frame arena: %zu / %zu bytes, %llu blocks allocated", arena.getUsed(), arena.getCapacity(), static_cast<unsigned long long>(arena.getHeapAllocations()));
+		ImGui::Text("Heap allocations while building the frame: %llu", static_cast<unsigned long long>(frameAllocations_));
+		const auto transientStats = device_.transients.getStats();
+		ImGui::Text("Render targets: %u allocations, %u reused, %u free, %.1f MiB", transientStats.allocations, transientStats.reused, transientStats.free, float(transientStats.bytes) / (1024.f * 1024.f));
+
+		ImGui::SeparatorText("Presentation");
+		ImGui::Text("Frames in flight: %u", device_.getMaxFramesInFlight());
+		int presentMode = 0;
+		for (int i = 0; i < int(std::size(presentModes)); i++)
+		{
+			if (presentModes[i] == swapchain_->getPresentMode())
+			{
+				presentMode = i;
+			}
+		}
+		if (ImGui::Combo("Present mode", &presentMode, presentModeNames, int(std::size(presentModeNames))))
+		{
+			swapchain_->setPresentMode(presentModes[presentMode]);
+		}
+		const auto timings = swapchain_->getTimings();
+		ImGui::Text("Frame wait %.2fms, acquire %.2fms", timings.frameWaitMs, timings.acquireMs);
+		ImGui::Text("Input to GPU done: %.2fms (presentation not included)", timings.latencyMs);
+
+		ImGui::SeparatorText("Async compute");
+		bool asyncCompute = renderer_->getAsyncCompute();
+		if (ImGui::Checkbox("Bloom on the compute queue (a frame late)", &asyncCompute))
+		{
+			renderer_->setAsyncCompute(asyncCompute);
+		}
+		const auto gpuTimings = renderer_->getGpuTimings();
+		ImGui::Text("Scene %.2fms, bloom %.2fms, composite %.2fms", gpuTimings.sceneMs, gpuTimings.bloomMs, gpuTimings.compositeMs);
+		ImGui::Text("Bloom overlapped with graphics: %.2fms", gpuTimings.overlapMs);
+
+		ImGui::SeparatorText("Bloom");
+		bool singlePassBloom = renderer_->getSinglePassBloom();
+		if (ImGui::Checkbox("Single pass downsample and fused upsample", &singlePassBloom))
+		{
+			renderer_->setSinglePassBloom(singlePassBloom);
+		}
+		ImGui::Text("Average blur: per level %.3fms, single pass %.3fms", gpuTimings.perLevelBloomMs, gpuTimings.singlePassBloomMs);
+
+		ImGui::SeparatorText("HDR precision");
+		const HdrPrecision hdrPrecision = renderer_->getHdrPrecision();
+		if (ImGui::BeginCombo("Targets and lighting maps", getName(hdrPrecision)))
+		{
+			for (const HdrPrecision precision : hdrPrecisions)
+			{
+				const bool supported = renderer_->supportsHdrPrecision(precision);
+				if (ImGui::Selectable(getName(precision), precision == hdrPrecision, supported ? 0 : ImGuiSelectableFlags_Disabled))
+				{
+					renderer_->setHdrPrecision(precision);
+				}
+			}
+			ImGui::EndCombo();
+		}
+
+		ImGui::SeparatorText("Post-processing");
+		float exposure = renderer_->getExposure();
+		if (ImGui::SliderFloat("Exposure", &exposure, 0.1f, 8.f, "%.2f", ImGuiSliderFlags_Logarithmic))
+		{
+			renderer_->setExposure(exposure);
+		}
+		const PostProcess::Tonemap tonemap = renderer_->getTonemap();
+		if (ImGui::BeginCombo("Tonemap", PostProcess::getName(tonemap)))
+		{
+			for (const PostProcess::Tonemap option : PostProcess::tonemaps)
+			{
+				if (ImGui::Selectable(PostProcess::getName(option), option == tonemap))
+				{
+					renderer_->setTonemap(option);
+				}
+			}
+			ImGui::EndCombo();
+		}
+		bool grid = renderer_->getGrid();
+		ImGui::BeginDisabled(!renderer_->supportsGrid());
+		if (ImGui::Checkbox("Grid", &grid))
+		{
+			renderer_->setGrid(grid);
+		}
+		ImGui::EndDisabled();
+
 		ImGui::End();
 
 		imgui_->EndFrame();
@@ -342,6 +466,7 @@ Application::~Application()
 	
 	renderer_.reset();
 	scene_.reset();
+	workers_.reset();
 	
 	imgui_.reset();
 	swapchain_.reset();
@@ -360,11 +485,27 @@ void Application::Draw()
 	}
 
 	// Scene Rendering
-	auto commandBuffer = swapchain_->acquire(width , height);
+	auto commandBuffer = swapchain_->acquire(width , height, inputTime_);
 
-	Transition::UndefinedToColorAttachment(swapchain_->getCurrentImage(), commandBuffer, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+	// The last submission of this frame was waited on in acquire, nothing from its last use is read anymore.
+	auto& arena = *frameArenas_[frameIndex_];
+	arena.reset();
 
-	renderer_->draw(commandBuffer, swapchain_->getCurrentImageView(), swapchain_->getDepthImageView(), scene_->getDrawables(), state_);
+	const uint64_t allocationsBefore = AllocationCounter::get();
+	const auto viewProjection = state_.camera_->calculateProjection() * state_.camera_->calculateView();
+	renderer_->draw(commandBuffer, swapchain_->getDepthImageView(), scene_->getDrawables(viewProjection, arena), state_, arena);
+	frameAllocations_ = AllocationCounter::get() - allocationsBefore;
+
+	// The scene goes ahead, so the compute queue can blur it while the rest of the frame is drawn.
+	Device::Ticket scene{};
+	if (renderer_->defersBloom())
+	{
+		std::tie(scene, commandBuffer) = swapchain_->split();
+	}
+
+	// After the split, as the scene does not wait for the image to be acquired.
+	Transition::UndefinedToColorAttachment(swapchain_->getCurrentImage(), commandBuffer, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+	renderer_->composite(commandBuffer, swapchain_->getCurrentImageView(), swapchain_->getDepthImage());
 
 	// ImGui Rendering
 	imgui_->Draw(swapchain_->getCurrentImageView(), swapchain_->getExtent(), commandBuffer);
@@ -373,4 +514,7 @@ void Application::Draw()
 	auto image = swapchain_->getCurrentImage();
 	Transition::ColorAttachmentToPresentable(image, commandBuffer);
 	swapchain_->present();
+	renderer_->endFrame(scene);
+
+	frameIndex_ = (frameIndex_ + 1) % static_cast<uint32_t>(frameArenas_.size());
 }
@@ -17,7 +17,15 @@ class Application
 {
 public:
 	Application() = default;
-	Application(int width, int height);
+	/**
+	 * @param framesInFlight 1 to 4, fixed for the application's lifetime.
+	 * @param presentMode Can be changed at runtime.
+	 * @param asyncCompute Bloom blurred on the compute queue, a frame late. Can be changed at runtime.
+	 * @param hdrPrecision Of the HDR target, bloom and lighting maps. Can be changed at runtime.
+	 * @param depthPrepass Opaque geometry is drawn depth only first. Can be changed at runtime.
+	*/
+	Application(int width, int height, uint32_t framesInFlight = 2, VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR, bool asyncCompute = false,
+		HdrPrecision hdrPrecision = HdrPrecision::Half, bool depthPrepass = false);
 
 	void run();
 
@@ -27,11 +35,21 @@ private:
 	
 	Device device_;
 
+	// Job system shared by culling and command recording.
+	std::unique_ptr<BS::thread_pool> workers_;
+
 	std::unique_ptr<Swapchain> swapchain_;
 	std::unique_ptr<ImGuiAdapter> imgui_;
 	std::unique_ptr<Scene> scene_;
 	std::unique_ptr<Renderer> renderer_;
 
+	// Transient CPU data of a frame, one arena per frame in flight.
+	std::vector<std::unique_ptr<LinearArena>> frameArenas_;
+	uint32_t frameIndex_ = 0;
+	uint64_t frameAllocations_ = 0;
+	// When this frame's input was polled.
+	Bench::TimePoint inputTime_{};
+
 	State state_{};
 	//
 	bool showLightMenu_ = true;
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Counts every call to the global operator new, on all threads. Sample it before and after a piece of code to see how often it hits the heap.
+*/
+namespace AllocationCounter
+{
+	uint64_t get();
+}
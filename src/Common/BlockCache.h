@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Released blocks of memory, kept to be handed out again instead of being freed.
+ * A block is only handed out once the frame that released it has retired, and only to a request of the same key that it fits
+ * without wasting more than half of it. Blocks left unused for maxUnusedFrames frames are evicted, least recently used first.
+*/
+template<typename Key, typename Block, typename KeyHash = std::hash<Key>>
+class BlockCache
+{
+public:
+	BlockCache(uint32_t framesInFlight, uint32_t maxUnusedFrames) :
+		maxUnusedFrames_(maxUnusedFrames), pending_(framesInFlight) {}
+
+	/**
+	 * @return The smallest free block of key holding at least size, if there is one small enough.
+	*/
+	std::optional<Block> acquire(const Key& key, uint64_t size) {
+		const auto it = free_.find(key);
+		if (it == free_.end()) {
+			return std::nullopt;
+		}
+		auto& entries = it->second;
+		auto best = entries.end();
+		for (auto entry = entries.begin(); entry != entries.end(); entry++) {
+			if (entry->size >= size && entry->size / 2 <= size && (best == entries.end() || entry->size < best->size)) {
+				best = entry;
+			}
+		}
+		if (best == entries.end()) {
+			return std::nullopt;
+		}
+		const Block block = best->block;
+		entries.erase(best);
+		freeCount_--;
+		return block;
+	}
+
+	/**
+	 * @brief The block may still be in use by the frame being recorded and those in flight.
+	*/
+	void release(const Key& key, uint64_t size, const Block& block) {
+		pending_[frame_].push_back({ key, { block, size, 0 } });
+	}
+
+	/**
+	 * @brief Call once the frame's fence has been waited on. What the frame released last time becomes free.
+	 * @param evict Called with each block that was unused for too long, which has to be freed.
+	*/
+	template<typename Evict>
+	void beginFrame(uint32_t frame, Evict&& evict) {
+		frame_ = frame;
+		frameNumber_++;
+		for (auto& [key, entry] : pending_[frame_]) {
+			entry.lastUsed = frameNumber_;
+			free_[key].push_back(entry);
+			freeCount_++;
+		}
+		pending_[frame_].clear();
+
+		for (auto& [key, entries] : free_) {
+			std::erase_if(entries, [&](const Entry& entry) {
+				if (frameNumber_ - entry.lastUsed <= maxUnusedFrames_) {
+					return false;
+				}
+				evict(entry.block);
+				freeCount_--;
+				return true;
+			});
+		}
+	}
+
+	/**
+	 * @brief Hands every block, free or pending, to evict. Nothing may be in flight.
+	*/
+	template<typename Evict>
+	void clear(Evict&& evict) {
+		for (auto& [key, entries] : free_) {
+			for (const auto& entry : entries) {
+				evict(entry.block);
+			}
+		}
+		for (auto& frame : pending_) {
+			for (const auto& [key, entry] : frame) {
+				evict(entry.block);
+			}
+			frame.clear();
+		}
+		free_.clear();
+		freeCount_ = 0;
+	}
+
+	/**
+	 * @brief Blocks that can be handed out, not counting those waiting for their frame.
+	*/
+	size_t getFreeCount() const { return freeCount_; }
+
+private:
+	struct Entry
+	{
+		Block block;
+		uint64_t size;
+		uint64_t lastUsed;
+	};
+
+	const uint32_t maxUnusedFrames_;
+	std::unordered_map<Key, std::vector<Entry>, KeyHash> free_;
+	std::vector<std::vector<std::pair<Key, Entry>>> pending_; // Per frame in flight.
+	size_t freeCount_ = 0;
+	uint32_t frame_ = 0;
+	uint64_t frameNumber_ = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <BS_thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+/**
+ * @brief Compiles on threads of its own, so a frame that waits on its workers never waits on a compile.
+ * A result is published through the atomic the frame reads, which keeps its previous value until then.
+ * Half the cores by default, the other half keep recording frames while a compile runs.
+*/
+class CompileQueue
+{
+public:
+	explicit CompileQueue(uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency() / 2)) : pool_(threadCount) {}
+
+	/**
+	 * @param compile T(), stored into target once it returns.
+	*/
+	template<class T, class Compile>
+	void compile(std::atomic<T>& target, Compile&& compile) {
+		run([&target, compile = std::forward<Compile>(compile)]() mutable {
+			target.store(compile(), std::memory_order_release);
+		});
+	}
+
+	/**
+	 * @param task void(), publishes its result itself, such as a link that replaces a pipeline already in use.
+	*/
+	template<class Task>
+	void run(Task&& task) {
+		pending_++;
+		pool_.detach_task([this, task = std::forward<Task>(task)]() mutable {
+			task();
+			pending_--;
+		});
+	}
+
+	/**
+	 * @brief Returns once every compile queued so far has been stored.
+	*/
+	void wait() {
+		pool_.wait();
+	}
+
+	/**
+	 * @return Compiles queued or running.
+	*/
+	uint32_t getPending() const {
+		return pending_.load(std::memory_order_relaxed);
+	}
+
+	uint32_t getThreadCount() const {
+		return static_cast<uint32_t>(pool_.get_thread_count());
+	}
+private:
+	std::atomic<uint32_t> pending_ = 0; // Before the pool, which finishes its tasks when destroyed.
+	BS::thread_pool pool_;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "MpscQueue.h"
+
+/**
+ * @brief Destruction held back until the GPU is done with what is destroyed.
+ * Each destruction carries a Key naming the GPU work that may still use the object, such as a frame or queue submissions.
+ * Any thread pushes without locking, one consumer at a time collects and runs what the owner reports complete.
+*/
+template<typename Key = uint64_t>
+class DeletionQueue
+{
+public:
+	/**
+	 * @brief Any thread.
+	*/
+	void push(Key key, std::function<void()> destroy) {
+		pending_.fetch_add(1, std::memory_order_relaxed);
+		incoming_.push({ std::move(key), std::move(destroy) });
+	}
+
+	/**
+	 * @brief Consumer only. Runs, in push order, what isComplete reports the GPU is done with.
+	 * @return How many ran.
+	*/
+	template<typename IsComplete>
+	size_t collect(IsComplete&& isComplete) {
+		incoming_.drain([&](Entry&& entry) {
+			waiting_.push_back(std::move(entry));
+		});
+
+		ready_.clear();
+		std::erase_if(waiting_, [&](Entry& entry) {
+			if (!isComplete(entry.key)) {
+				return false;
+			}
+			ready_.push_back(std::move(entry.destroy));
+			return true;
+		});
+		// Destroying may push more, which waits for the next collect.
+		for (const auto& destroy : ready_) {
+			destroy();
+		}
+		pending_.fetch_sub(ready_.size(), std::memory_order_relaxed);
+		return ready_.size();
+	}
+
+	/**
+	 * @brief Consumer only. Runs everything, nothing may be in flight.
+	*/
+	void flush() {
+		while (collect([](const Key&) { return true; }) > 0) {
+		}
+	}
+
+	/**
+	 * @return Pushed and not yet run.
+	*/
+	size_t getPending() const {
+		return pending_.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Entry
+	{
+		Key key;
+		std::function<void()> destroy;
+	};
+
+	MpscQueue<Entry> incoming_;
+	std::vector<Entry> waiting_; // Drained, not yet complete.
+	std::vector<std::function<void()>> ready_;
+	std::atomic<size_t> pending_ = 0;
+};
@@ -35,7 +35,7 @@ public:
 		recycle_buffer_.push_back(handle.id);
 	}
 
-	bool is_valid(const Handle& handle) {
+	bool is_valid(const Handle& handle) const {
 		if (auto it = map_.find(handle.id); it != map_.end()) {
 			return it->second.second == handle.generation;
 		}
@@ -52,19 +52,19 @@ public:
 
 private:
 	using Item = std::pair<T, uint32_t>;
-	uint16_t get_id() {
+	uint32_t get_id() {
 		if (recycle_buffer_.empty()) {
 			return frontier++;
 		}
 		else {
-			uint16_t id = recycle_buffer_.front();
+			uint32_t id = recycle_buffer_.front();
 			recycle_buffer_.pop_front();
 			return id;
 		}
 	}
 
 	template<class ...Args>
-	const Item& get_or_create_item(uint16_t id, Args&&... args) {
+	const Item& get_or_create_item(uint32_t id, Args&&... args) {
 		if (auto it = map_.find(id); it != map_.end()) {
 			return it->second;
 		}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Bump allocator for data that lives for one frame. Allocations only move an offset forward, nothing is freed until reset().
+ * When a frame needs more than the block holds, overflow blocks are chained and reset() replaces them with one block big enough
+ * for the whole frame, so a steady frame stops touching the heap after the first few frames. Not thread safe.
+*/
+class LinearArena
+{
+public:
+	explicit LinearArena(size_t capacity = 64 * 1024) {
+		allocateBlock(capacity);
+	}
+
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void* allocate(size_t size, size_t alignment) {
+		std::byte* result = align(block_.get() + offset_, alignment);
+		if (result + size > block_.get() + capacity_) {
+			// Earlier allocations still point into the current block, so it is kept alive until reset().
+			retiredCapacity_ += capacity_;
+			retired_.push_back(std::move(block_));
+			allocateBlock(std::max(capacity_ * 2, size + alignment));
+			result = align(block_.get(), alignment);
+		}
+		offset_ = static_cast<size_t>(result - block_.get()) + size;
+		used_ += size;
+		return result;
+	}
+
+	/**
+	 * @brief Invalidates everything allocated since the last reset.
+	*/
+	void reset() {
+		if (!retired_.empty()) {
+			const size_t total = capacity_ + retiredCapacity_;
+			retired_.clear();
+			retiredCapacity_ = 0;
+			allocateBlock(total);
+		}
+		offset_ = 0;
+		used_ = 0;
+	}
+
+	size_t getUsed() const { return used_; }
+	size_t getCapacity() const { return capacity_ + retiredCapacity_; }
+	/**
+	 * @brief Number of blocks taken from the heap since construction.
+	*/
+	uint64_t getHeapAllocations() const { return heapAllocations_; }
+
+private:
+	static std::byte* align(std::byte* pointer, size_t alignment) {
+		const auto address = reinterpret_cast<uintptr_t>(pointer);
+		return pointer + ((alignment - address % alignment) % alignment);
+	}
+
+	void allocateBlock(size_t capacity) {
+		block_ = std::make_unique_for_overwrite<std::byte[]>(capacity);
+		capacity_ = capacity;
+		offset_ = 0;
+		heapAllocations_++;
+	}
+
+	std::unique_ptr<std::byte[]> block_;
+	size_t capacity_ = 0;
+	size_t offset_ = 0;
+	size_t used_ = 0;
+
+	std::vector<std::unique_ptr<std::byte[]>> retired_;
+	size_t retiredCapacity_ = 0;
+
+	uint64_t heapAllocations_ = 0;
+};
+
+/**
+ * @brief STL allocator on top of a LinearArena. Deallocation is a no-op, memory comes back on reset().
+ * A default constructed allocator has no arena and falls back to the heap, so containers stay default constructible.
+*/
+template<class T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+	// Assigning a container from one built on an arena moves the arena along with the memory.
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	ArenaAllocator() noexcept = default;
+	ArenaAllocator(LinearArena& arena) noexcept : arena_(&arena) {}
+	explicit ArenaAllocator(LinearArena* arena) noexcept : arena_(arena) {}
+
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena_(other.getArena()) {}
+
+	T* allocate(size_t n) {
+		if (arena_) {
+			return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+		}
+		return std::allocator<T>{}.allocate(n);
+	}
+
+	void deallocate(T* pointer, size_t n) noexcept {
+		if (!arena_) {
+			std::allocator<T>{}.deallocate(pointer, n);
+		}
+	}
+
+	LinearArena* getArena() const noexcept { return arena_; }
+
+	template<class U>
+	bool operator==(const ArenaAllocator<U>& rhs) const noexcept { return arena_ == rhs.getArena(); }
+
+private:
+	LinearArena* arena_ = nullptr;
+};
+
+template<class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
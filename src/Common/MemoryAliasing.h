@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+/**
+ * @brief A resource that wants memory from a shared heap, alive from its first to its last use, both inclusive.
+*/
+struct AliasRequest
+{
+	uint64_t size;
+	uint64_t alignment;
+	uint32_t firstUse;
+	uint32_t lastUse;
+
+	bool overlapsInTime(const AliasRequest& other) const {
+		return firstUse <= other.lastUse && other.firstUse <= lastUse;
+	}
+};
+
+struct AliasPlacement
+{
+	std::vector<uint64_t> offsets; // Per request.
+	uint64_t size = 0; // Of the heap.
+
+	bool overlapsInMemory(const std::vector<AliasRequest>& requests, size_t a, size_t b) const {
+		return offsets[a] < offsets[b] + requests[b].size && offsets[b] < offsets[a] + requests[a].size;
+	}
+};
+
+/**
+ * @brief Places requests in one heap so that only resources whose lifetimes do not overlap share memory.
+ * Largest first, each at the lowest aligned offset clear of everything placed that is alive at the same time.
+*/
+inline AliasPlacement placeAliased(const std::vector<AliasRequest>& requests)
+{
+	std::vector<size_t> order(requests.size());
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return requests[a].size > requests[b].size; });
+
+	AliasPlacement placement;
+	placement.offsets.resize(requests.size());
+
+	std::vector<size_t> placed;
+	std::vector<std::pair<uint64_t, uint64_t>> taken; // [begin, end) of what is alive alongside.
+	for (const size_t index : order) {
+		const auto& request = requests[index];
+		taken.clear();
+		for (const size_t other : placed) {
+			if (request.overlapsInTime(requests[other])) {
+				taken.emplace_back(placement.offsets[other], placement.offsets[other] + requests[other].size);
+			}
+		}
+		std::sort(taken.begin(), taken.end());
+
+		const auto align = [&](uint64_t offset) {
+			return (offset + request.alignment - 1) / request.alignment * request.alignment;
+		};
+		uint64_t offset = 0;
+		for (const auto& [begin, end] : taken) {
+			if (offset + request.size <= begin) {
+				break;
+			}
+			offset = std::max(offset, align(end));
+		}
+
+		placement.offsets[index] = offset;
+		placement.size = std::max(placement.size, offset + request.size);
+		placed.push_back(index);
+	}
+	return placement;
+}
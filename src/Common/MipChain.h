@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * @brief Levels of a mip chain of width by height that stops before the smaller side would go below minExtent.
+ * At least one, at most maxLevels. Each level halves the one above, rounding down.
+*/
+inline uint32_t getMipLevels(uint32_t width, uint32_t height, uint32_t minExtent, uint32_t maxLevels)
+{
+	uint32_t levels = 1;
+	uint32_t extent = std::min(width, height);
+	while (levels < maxLevels && extent / 2 >= minExtent)
+	{
+		extent /= 2;
+		levels++;
+	}
+	return levels;
+}
+
+/**
+ * @brief How a single pass downsample splits the first level of a chain: each workgroup reduces a tile of tileExtent
+ * texels by levelsPerGroup levels, and the last workgroup to finish reduces what they wrote by up to levelsPerGroup more.
+*/
+struct DownsampleTiles
+{
+	static constexpr uint32_t levelsPerGroup = 6;
+	static constexpr uint32_t tileExtent = 1u << levelsPerGroup;
+
+	uint32_t groupsX;
+	uint32_t groupsY;
+
+	uint32_t getGroupCount() const { return groupsX * groupsY; }
+	/**
+	 * @brief Whether the last workgroup finds everything it reduces in one tile. The workgroups then write at most
+	 * tileExtent texels on each side of level levelsPerGroup.
+	*/
+	bool fitsLastGroup() const { return groupsX <= tileExtent && groupsY <= tileExtent; }
+};
+
+inline DownsampleTiles getDownsampleTiles(uint32_t width, uint32_t height)
+{
+	return { (width + DownsampleTiles::tileExtent - 1) / DownsampleTiles::tileExtent, (height + DownsampleTiles::tileExtent - 1) / DownsampleTiles::tileExtent };
+}
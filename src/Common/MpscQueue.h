@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @brief Unbounded queue any number of threads push to without locking, drained by one consumer at a time.
+ * Producers link a node onto an atomic head, the consumer takes the whole list with one exchange and hands it out in push order.
+ * As the consumer never looks at single nodes while producers run, nodes cannot be reused under it.
+*/
+template<typename T>
+class MpscQueue
+{
+public:
+	MpscQueue() = default;
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	void push(T value) {
+		Node* node = new Node{ std::move(value), head_.load(std::memory_order_relaxed) };
+		while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+		}
+	}
+
+	/**
+	 * @brief Consumer only. Calls consume with everything pushed so far, oldest first.
+	 * @return How many were consumed.
+	*/
+	template<typename F>
+	size_t drain(F&& consume) {
+		Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+		// Pushed newest first, reverse into push order.
+		Node* oldest = nullptr;
+		while (node) {
+			Node* next = node->next;
+			node->next = oldest;
+			oldest = node;
+			node = next;
+		}
+
+		size_t count = 0;
+		while (oldest) {
+			Node* next = oldest->next;
+			consume(std::move(oldest->value));
+			delete oldest;
+			oldest = next;
+			count++;
+		}
+		return count;
+	}
+
+	bool empty() const {
+		return head_.load(std::memory_order_acquire) == nullptr;
+	}
+
+	~MpscQueue() {
+		drain([](T&&) {});
+	}
+
+private:
+	struct Node
+	{
+		T value;
+		Node* next;
+	};
+	std::atomic<Node*> head_{ nullptr };
+};
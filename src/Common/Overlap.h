@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+
+/**
+ * @brief A span of time, such as a pass on the GPU. Empty when end is not after begin.
+*/
+struct Interval
+{
+	double begin = 0.0;
+	double end = 0.0;
+
+	double length() const { return std::max(0.0, end - begin); }
+};
+
+/**
+ * @brief How much of interval the others cover, each moment counted once however many cover it.
+ * Used to tell how much of the work on one queue ran while another queue was busy.
+ * @param others Sorted in place, nothing is allocated.
+*/
+inline double covered(Interval interval, std::span<Interval> others)
+{
+	std::sort(others.begin(), others.end(), [](const Interval& lhs, const Interval& rhs) { return lhs.begin < rhs.begin; });
+
+	double total = 0.0;
+	double reached = interval.begin; // Everything before is already counted.
+	for (const Interval& other : others)
+	{
+		const double begin = std::max(other.begin, reached);
+		const double end = std::min(other.end, interval.end);
+		if (end > begin)
+		{
+			total += end - begin;
+			reached = end;
+		}
+	}
+	return total;
+}
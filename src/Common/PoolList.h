@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief The pools of a per-frame allocator that only resets them all at once, such as descriptor pools.
+ * Every pool with room is tried before the caller has to create one, and reset puts the largest pool first in line,
+ * so once a frame's demand has been met the same demand never creates another pool.
+*/
+template<class Pool>
+class PoolList
+{
+public:
+	/**
+	 * @param tryAllocate bool(Pool), false when the pool has no room left. A pool that has none is set aside until reset.
+	 * @return False when no pool had room, add one and allocate from it.
+	*/
+	template<class TryAllocate>
+	bool allocate(TryAllocate&& tryAllocate) {
+		while (!ready_.empty()) {
+			if (tryAllocate(ready_.back().pool)) {
+				return true;
+			}
+			full_.push_back(ready_.back());
+			ready_.pop_back();
+		}
+		return false;
+	}
+
+	/**
+	 * @brief Tried first from now on.
+	 * @param capacity Of the pool, the larger are tried first after a reset.
+	*/
+	void add(Pool pool, uint32_t capacity) {
+		ready_.push_back({ pool, capacity });
+	}
+
+	/**
+	 * @brief Every pool has room again. Reset the pools themselves before allocating from them.
+	*/
+	void reset() {
+		ready_.insert(ready_.end(), full_.begin(), full_.end());
+		full_.clear();
+		// Allocation starts at the back.
+		std::stable_sort(ready_.begin(), ready_.end(), [](const Entry& a, const Entry& b) { return a.capacity < b.capacity; });
+	}
+
+	template<class Function>
+	void forEach(Function&& function) const {
+		for (const auto& entry : ready_) {
+			function(entry.pool);
+		}
+		for (const auto& entry : full_) {
+			function(entry.pool);
+		}
+	}
+
+	size_t size() const {
+		return ready_.size() + full_.size();
+	}
+
+	void clear() {
+		ready_.clear();
+		full_.clear();
+	}
+private:
+	struct Entry
+	{
+		Pool pool;
+		uint32_t capacity;
+	};
+	std::vector<Entry> ready_;
+	std::vector<Entry> full_;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Handle.h"
+
+/**
+ * @brief Hands out indices into a descriptor array. The handle id is the index, the generation tells a stale handle from a live one.
+ * A freed index is only handed out again once the frame that freed it has retired, as the GPU may still be reading it.
+ * The capacity doubles when every index is taken, up to maxCapacity.
+*/
+class SlotAllocator
+{
+public:
+	SlotAllocator(uint32_t capacity, uint32_t maxCapacity, uint32_t framesInFlight) :
+		retiring_(framesInFlight), capacity_(std::min(capacity, maxCapacity)), maxCapacity_(maxCapacity) {}
+
+	/**
+	 * @throws std::length_error when maxCapacity indices are taken or waiting to retire.
+	*/
+	Handle allocate() {
+		if (recycled_ == 0 && highWater_ == maxCapacity_) {
+			throw std::length_error("Out of descriptor slots.");
+		}
+		const Handle handle = slots_.add(true);
+		slots_.at(handle) = true;
+		if (recycled_ > 0) {
+			recycled_--;
+		}
+		else {
+			highWater_++;
+		}
+		if (handle.id >= capacity_) {
+			capacity_ = std::min(maxCapacity_, std::max(capacity_ * 2, handle.id + 1));
+		}
+		used_++;
+		return handle;
+	}
+
+	/**
+	 * @brief The handle is invalid right away, its index is reused after the current frame comes around again.
+	*/
+	void free(const Handle& handle) {
+		if (!isValid(handle)) {
+			return;
+		}
+		slots_.at(handle) = false;
+		retiring_[frame_].push_back(handle);
+		used_--;
+	}
+
+	/**
+	 * @brief Call once the frame's fence has been waited on. Indices freed the last time this frame was recorded become available.
+	*/
+	void beginFrame(uint32_t frame) {
+		frame_ = frame;
+		for (const auto& handle : retiring_[frame_]) {
+			slots_.remove(handle);
+			recycled_++;
+		}
+		retiring_[frame_].clear();
+	}
+
+	bool isValid(const Handle& handle) const {
+		return slots_.is_valid(handle) && slots_.at(handle);
+	}
+
+	uint32_t getCapacity() const { return capacity_; }
+	uint32_t getMaxCapacity() const { return maxCapacity_; }
+	uint32_t getUsed() const { return used_; }
+	/**
+	 * @brief One past the highest index ever handed out.
+	*/
+	uint32_t getHighWater() const { return highWater_; }
+
+private:
+	HandleMap<bool> slots_; // True while the slot is live.
+	std::vector<std::vector<Handle>> retiring_;
+	uint32_t frame_ = 0;
+
+	uint32_t capacity_;
+	const uint32_t maxCapacity_;
+	uint32_t highWater_ = 0;
+	uint32_t recycled_ = 0; // Removed from slots_ and waiting in its recycle queue.
+	uint32_t used_ = 0;
+};
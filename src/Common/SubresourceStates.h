@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief One State per mip level and array layer of an image.
+ * forEachRun walks a range as few rectangles of equal state as it can find: consecutive mips of a layer are joined,
+ * and consecutive layers with the same runs are joined, so a uniformly used image costs one barrier.
+*/
+template<typename State>
+class SubresourceStates
+{
+public:
+	SubresourceStates(uint32_t mipLevels, uint32_t arrayLayers, const State& initial = {}) :
+		mipLevels_(mipLevels), arrayLayers_(arrayLayers), states_(size_t(mipLevels) * arrayLayers, initial) {}
+
+	const State& get(uint32_t mip, uint32_t layer) const {
+		return states_[index(mip, layer)];
+	}
+
+	void set(uint32_t baseMip, uint32_t levelCount, uint32_t baseLayer, uint32_t layerCount, const State& state) {
+		for (uint32_t layer = baseLayer; layer < baseLayer + layerCount; layer++) {
+			for (uint32_t mip = baseMip; mip < baseMip + levelCount; mip++) {
+				states_[index(mip, layer)] = state;
+			}
+		}
+	}
+
+	/**
+	 * @param visit Called as visit(baseMip, levelCount, baseLayer, layerCount, state).
+	*/
+	template<typename Visit>
+	void forEachRun(uint32_t baseMip, uint32_t levelCount, uint32_t baseLayer, uint32_t layerCount, Visit&& visit) const {
+		uint32_t first = baseLayer;
+		while (first < baseLayer + layerCount) {
+			uint32_t last = first + 1;
+			while (last < baseLayer + layerCount && sameMips(first, last, baseMip, levelCount)) {
+				last++;
+			}
+
+			uint32_t mip = baseMip;
+			while (mip < baseMip + levelCount) {
+				uint32_t end = mip + 1;
+				while (end < baseMip + levelCount && get(end, first) == get(mip, first)) {
+					end++;
+				}
+				visit(mip, end - mip, first, last - first, get(mip, first));
+				mip = end;
+			}
+			first = last;
+		}
+	}
+
+	uint32_t getMipLevels() const { return mipLevels_; }
+	uint32_t getArrayLayers() const { return arrayLayers_; }
+
+private:
+	size_t index(uint32_t mip, uint32_t layer) const {
+		assert(mip < mipLevels_ && layer < arrayLayers_);
+		return size_t(layer) * mipLevels_ + mip;
+	}
+
+	bool sameMips(uint32_t a, uint32_t b, uint32_t baseMip, uint32_t levelCount) const {
+		for (uint32_t mip = baseMip; mip < baseMip + levelCount; mip++) {
+			if (!(get(mip, a) == get(mip, b))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t mipLevels_;
+	uint32_t arrayLayers_;
+	std::vector<State> states_; // [layer][mip]
+};
@@ -0,0 +1,148 @@
+#include "BindlessTextures.h"
+#include "Device.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <volk.h>
+
+BindlessTextures::BindlessTextures(Device& device, VkDescriptorSetLayout layout, uint32_t binding, uint32_t reserved, uint32_t initialCapacity, uint32_t maxCapacity, uint32_t framesInFlight) :
+	device_(device), layout_(layout), binding_(binding), reserved_(reserved), slots_(initialCapacity, maxCapacity, framesInFlight)
+{
+	current_ = allocate(slots_.getCapacity());
+}
+
+Handle BindlessTextures::add(VkImageView view, VkSampler sampler, VkImageLayout imageLayout)
+{
+	const Handle handle = slots_.allocate();
+	pending_.push_back({ handle, { .sampler = sampler, .imageView = view, .imageLayout = imageLayout } });
+	return handle;
+}
+
+void BindlessTextures::remove(const Handle& handle)
+{
+	slots_.free(handle);
+}
+
+void BindlessTextures::beginFrame(uint32_t frame)
+{
+	frame_ = frame;
+	slots_.beginFrame(frame_);
+
+	flush();
+}
+
+void BindlessTextures::flush()
+{
+	if (slots_.getCapacity() > current_.capacity)
+	{
+		const Allocation next = allocate(slots_.getCapacity());
+		if (written_ > 0)
+		{
+			VkCopyDescriptorSet copy{ VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET };
+			copy.srcSet = current_.set;
+			copy.srcBinding = binding_;
+			copy.dstSet = next.set;
+			copy.dstBinding = binding_;
+			copy.descriptorCount = written_;
+			vkUpdateDescriptorSets(device_.device, 0, nullptr, 1, &copy);
+		}
+		// Frames in flight may have bound the old set.
+		device_.release([device = device_.device, pool = current_.pool]() {
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		});
+		current_ = next;
+	}
+
+	if (pending_.empty())
+	{
+		return;
+	}
+
+	// Slots removed before their first write are dropped, runs of consecutive indices share one write.
+	std::erase_if(pending_, [&](const PendingWrite& write) { return !slots_.isValid(write.handle); });
+	std::sort(pending_.begin(), pending_.end(), [](const PendingWrite& a, const PendingWrite& b) { return a.handle.id < b.handle.id; });
+
+	std::vector<VkDescriptorImageInfo> infos;
+	std::vector<VkWriteDescriptorSet> writes;
+	infos.reserve(pending_.size());
+	for (const auto& write : pending_)
+	{
+		if (writes.empty() || writes.back().dstArrayElement + writes.back().descriptorCount != write.handle.id)
+		{
+			VkWriteDescriptorSet descriptorWrite{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+			descriptorWrite.dstSet = current_.set;
+			descriptorWrite.dstBinding = binding_;
+			descriptorWrite.dstArrayElement = write.handle.id;
+			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes.push_back(descriptorWrite);
+		}
+		writes.back().descriptorCount++;
+		infos.push_back(write.info);
+		written_ = std::max(written_, write.handle.id + 1);
+	}
+	// infos no longer grows, so pointers into it are stable.
+	size_t first = 0;
+	for (auto& write : writes)
+	{
+		write.pImageInfo = &infos[first];
+		first += write.descriptorCount;
+	}
+
+	vkUpdateDescriptorSets(device_.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	pending_.clear();
+}
+
+VkDescriptorSet BindlessTextures::getSet() const
+{
+	return current_.set;
+}
+
+uint32_t BindlessTextures::getCapacity() const
+{
+	return current_.capacity;
+}
+
+uint32_t BindlessTextures::getUsed() const
+{
+	return slots_.getUsed();
+}
+
+BindlessTextures::~BindlessTextures()
+{
+	device_.release([device = device_.device, pool = current_.pool]() {
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	});
+}
+
+BindlessTextures::Allocation BindlessTextures::allocate(uint32_t capacity) const
+{
+	Allocation allocation{ .capacity = capacity };
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = reserved_ + capacity;
+
+	VkDescriptorPoolCreateInfo poolCI{};
+	poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCI.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolCI.maxSets = 1;
+	poolCI.poolSizeCount = 1;
+	poolCI.pPoolSizes = &poolSize;
+	check(vkCreateDescriptorPool(device_.device, &poolCI, nullptr, &allocation.pool));
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfo variableCI{};
+	variableCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	variableCI.descriptorSetCount = 1;
+	variableCI.pDescriptorCounts = &capacity;
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = &variableCI;
+	allocateInfo.descriptorPool = allocation.pool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &layout_;
+	check(vkAllocateDescriptorSets(device_.device, &allocateInfo, &allocation.set));
+	setName(device_.device, allocation.set, fmt::format("Bindless Set ({} textures)", capacity));
+	return allocation;
+}
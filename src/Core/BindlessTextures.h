@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include "../Common/SlotAllocator.h"
+
+class Device;
+
+/**
+ * @brief The bindless texture array. Slots come from a SlotAllocator, their id is the index shaders use.
+ * Writes are queued and go out in one vkUpdateDescriptorSets per flush. When the allocator outgrows the set,
+ * a bigger set is allocated, live descriptors are copied over and the old set is destroyed once no frame can still use it.
+*/
+class BindlessTextures
+{
+public:
+	/**
+	 * @param binding The variable count binding of layout that holds the textures.
+	 * @param reserved Descriptors of the other bindings of layout, all combined image samplers.
+	*/
+	BindlessTextures(Device& device, VkDescriptorSetLayout layout, uint32_t binding, uint32_t reserved, uint32_t initialCapacity, uint32_t maxCapacity, uint32_t framesInFlight);
+
+	Handle add(VkImageView view, VkSampler sampler, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void remove(const Handle& handle);
+
+	/**
+	 * @brief Call once the frame's fence has been waited on and before anything is recorded. Retires slots freed
+	 * the last time this frame was recorded, then flushes.
+	*/
+	void beginFrame(uint32_t frame);
+	/**
+	 * @brief Grows the set if needed and writes every queued descriptor. Not while a command buffer using getSet() is being recorded.
+	*/
+	void flush();
+
+	VkDescriptorSet getSet() const;
+	uint32_t getCapacity() const;
+	uint32_t getUsed() const;
+
+	~BindlessTextures();
+private:
+	struct Allocation
+	{
+		VkDescriptorPool pool;
+		VkDescriptorSet set;
+		uint32_t capacity;
+	};
+	Allocation allocate(uint32_t capacity) const;
+
+	Device& device_;
+	const VkDescriptorSetLayout layout_;
+	const uint32_t binding_;
+	const uint32_t reserved_;
+
+	SlotAllocator slots_;
+	Allocation current_{};
+	uint32_t frame_ = 0;
+
+	struct PendingWrite
+	{
+		Handle handle;
+		VkDescriptorImageInfo info;
+	};
+	std::vector<PendingWrite> pending_;
+	uint32_t written_ = 0; // One past the highest index written, what a bigger set has to copy.
+};
@@ -57,7 +57,10 @@ void Buffer::copy(const Buffer& destBuffer, VkCommandBuffer commandBuffer, size_
 
 Buffer::~Buffer()
 {
-	vmaDestroyBuffer(device_.allocator, buffer_, allocation_);
+	// Frames in flight and submitted work may still read it.
+	device_.release([allocator = device_.allocator, buffer = buffer_, allocation = allocation_]() {
+		vmaDestroyBuffer(allocator, buffer, allocation);
+	});
 }
 
 void* Buffer::map()
@@ -13,6 +13,19 @@ void check(bool condition, const std::string& message, const std::source_locatio
 }
 
 #include <volk.h>
+#include <vector>
+
+void releasePipeline(Device& device, std::span<const VkDescriptorSetLayout> setLayouts, VkPipelineLayout layout, VkPipeline pipeline)
+{
+	device.release([vkDevice = device.device, setLayouts = std::vector<VkDescriptorSetLayout>(setLayouts.begin(), setLayouts.end()), layout, pipeline]() {
+		for (const auto& setLayout : setLayouts)
+		{
+			vkDestroyDescriptorSetLayout(vkDevice, setLayout, nullptr);
+		}
+		vkDestroyPipelineLayout(vkDevice, layout, nullptr);
+		vkDestroyPipeline(vkDevice, pipeline, nullptr);
+	});
+}
 
 VkFence CreateInfo::createFence(VkDevice device, VkFenceCreateFlags flags)
 {
@@ -33,6 +46,20 @@ VkSemaphore CreateInfo::createBinarySemaphore(VkDevice device)
 	return semaphore;
 }
 
+VkSemaphore CreateInfo::createTimelineSemaphore(VkDevice device, uint64_t initialValue)
+{
+	VkSemaphore semaphore;
+	VkSemaphoreTypeCreateInfo typeCI{};
+	typeCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeCI.initialValue = initialValue;
+	VkSemaphoreCreateInfo semaphoreCI{};
+	semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCI.pNext = &typeCI;
+	check(vkCreateSemaphore(device, &semaphoreCI, nullptr, &semaphore));
+	return semaphore;
+}
+
 VkCommandBuffer CreateInfo::allocateCommandBuffer(VkDevice device, VkCommandPool commandPool)
 {
 	VkCommandBuffer commandBuffer;
@@ -55,27 +82,6 @@ VkCommandPool CreateInfo::createCommandPool(VkDevice device, uint32_t queueFamil
 	return commandPool;
 }
 
-void CreateInfo::performOneTimeAction(VkDevice device, VkQueue queue, VkCommandPool commandPool, const std::function<void(VkCommandBuffer)>& action)
-{
-	VkCommandBuffer commandBuffer = allocateCommandBuffer(device, commandPool);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	action(commandBuffer);
-
-	vkEndCommandBuffer(commandBuffer);
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	check(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-	check(vkQueueWaitIdle(queue)); // device lost error is so weird.
-}
-
 VkRenderPass CreateInfo::createRenderPass(VkDevice device, const VkAttachmentDescription2* pAttachments, uint32_t attachmentCount, const VkSubpassDescription2* pSubpass, uint32_t subpassCount, const VkSubpassDependency2* pDependency, uint32_t dependencyCount)
 {
 	VkRenderPass renderPass;
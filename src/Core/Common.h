@@ -3,6 +3,7 @@
 #include <string>
 #include <source_location>
 #include <functional>
+#include <span>
 
 #include <vulkan/vulkan.h>
 #include <volk.h>
@@ -38,23 +39,26 @@ inline bool operator!=(const VkExtent2D& lhs, const VkExtent2D& rhs) {
 	return lhs.width != rhs.width || lhs.height != rhs.height;
 };
 
+class Device;
+
+/**
+ * @brief Destroys the pipeline and its layouts once frames in flight are done with them.
+*/
+void releasePipeline(Device& device, std::span<const VkDescriptorSetLayout> setLayouts, VkPipelineLayout layout, VkPipeline pipeline);
+
 template<uint32_t SetCount>
 struct PipelineInfo
 {
 	std::array<VkDescriptorSetLayout, SetCount> setLayouts;
-	VkDescriptorPool pool;
 	VkPipelineLayout layout;
 	VkPipeline pipeline;
 
-	void clear(VkDevice device)
+	void clear(Device& device)
 	{
-		for (const auto& layout : setLayouts)
-		{
-			vkDestroyDescriptorSetLayout(device, layout, nullptr);
-		}
-		vkDestroyDescriptorPool(device, pool, nullptr);
-		vkDestroyPipelineLayout(device, layout, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
+		releasePipeline(device, setLayouts, layout, pipeline);
+		setLayouts = {};
+		layout = VK_NULL_HANDLE;
+		pipeline = VK_NULL_HANDLE;
 	}
 };
 
@@ -62,10 +66,10 @@ struct PipelineInfo
 namespace CreateInfo {
 	VkFence createFence(VkDevice device, VkFenceCreateFlags flags);
 	VkSemaphore createBinarySemaphore(VkDevice device);
+	VkSemaphore createTimelineSemaphore(VkDevice device, uint64_t initialValue = 0);
 	VkCommandBuffer allocateCommandBuffer(VkDevice device, VkCommandPool commandPool);
 
 	VkCommandPool createCommandPool(VkDevice device, uint32_t queueFamily, uint32_t flags = 0);
-	void performOneTimeAction(VkDevice device, VkQueue queue, VkCommandPool commandPool, const std::function<void(VkCommandBuffer)>& action);
 
 	VkRenderPass createRenderPass(VkDevice device, const VkAttachmentDescription2* pAttachments, uint32_t attachmentCount, const VkSubpassDescription2* pSubpass, uint32_t subpassCount, const VkSubpassDependency2* pDependency, uint32_t dependencyCount);
 
@@ -150,9 +154,15 @@ inline void setName<VkPipelineLayout>(VkDevice device, VkPipelineLayout queue, c
 	Detail::setName(device, VK_OBJECT_TYPE_PIPELINE_LAYOUT, queue, name);
 }
 
+template<>
+inline void setName<VkBuffer>(VkDevice device, VkBuffer queue, const std::string& name)
+{
+	Detail::setName(device, VK_OBJECT_TYPE_BUFFER, queue, name);
+}
+
 // Misc
-template<typename T>
-constexpr size_t SizeInBytes(const std::vector<T>& vector)
+template<typename T, typename Allocator>
+constexpr size_t SizeInBytes(const std::vector<T, Allocator>& vector)
 {
 	return vector.size() * sizeof(T);
 }
\ No newline at end of file
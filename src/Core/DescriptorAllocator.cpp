@@ -0,0 +1,149 @@
+#include "DescriptorAllocator.h"
+#include "ObjectRegistry.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <volk.h>
+
+size_t DescriptorAllocator::KeyHash::operator()(const Key& key) const
+{
+	size_t result = key.size();
+	for (const auto word : key)
+	{
+		hash_combine(result, word);
+	}
+	return result;
+}
+
+void DescriptorAllocator::init(VkDevice device, ObjectRegistry& registry, const std::string& name, uint32_t initialSetsPerPool, uint32_t maxSetsPerPool)
+{
+	device_ = device;
+	registry_ = &registry;
+	name_ = name;
+	initialSetsPerPool_ = std::max(initialSetsPerPool, 1u);
+	maxSetsPerPool_ = std::max(maxSetsPerPool, initialSetsPerPool_);
+}
+
+void DescriptorAllocator::deinit()
+{
+	std::scoped_lock lock(mutex_);
+	for (const auto& [key, pools] : pools_)
+	{
+		pools.list.forEach([&](VkDescriptorPool pool) {
+			vkDestroyDescriptorPool(device_, pool, nullptr);
+		});
+	}
+	pools_.clear();
+	poolCount_ = 0;
+	setCount_ = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	VkDescriptorSet set;
+	allocate(layout, 1, &set);
+	return set;
+}
+
+void DescriptorAllocator::allocate(VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* pSets)
+{
+	std::scoped_lock lock(mutex_);
+	auto& pools = getPools(layout);
+
+	std::vector<VkDescriptorSetLayout> layouts(count, layout);
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorSetCount = count;
+	allocateInfo.pSetLayouts = layouts.data();
+
+	const bool allocated = pools.list.allocate([&](VkDescriptorPool pool) {
+		allocateInfo.descriptorPool = pool;
+		const VkResult result = vkAllocateDescriptorSets(device_, &allocateInfo, pSets);
+		check(result == VK_SUCCESS || result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL, "Failed to allocate descriptor sets.");
+		return result == VK_SUCCESS;
+	});
+	if (allocated)
+	{
+		setCount_ += count;
+		return;
+	}
+
+	// A fresh pool always fits, unless count alone is more than a pool holds.
+	pools.setsPerPool = std::max(pools.setsPerPool, count);
+	allocateInfo.descriptorPool = createPool(pools);
+	check(vkAllocateDescriptorSets(device_, &allocateInfo, pSets));
+	setCount_ += count;
+}
+
+void DescriptorAllocator::reset()
+{
+	std::scoped_lock lock(mutex_);
+	for (auto& [key, pools] : pools_)
+	{
+		pools.list.forEach([&](VkDescriptorPool pool) {
+			check(vkResetDescriptorPool(device_, pool, 0));
+		});
+		pools.list.reset();
+	}
+	setCount_ = 0;
+}
+
+DescriptorAllocator::Stats DescriptorAllocator::getStats() const
+{
+	std::scoped_lock lock(mutex_);
+	return { poolCount_, setCount_ };
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	deinit();
+}
+
+DescriptorAllocator::Pools& DescriptorAllocator::getPools(VkDescriptorSetLayout layout)
+{
+	VkDescriptorPoolCreateFlags flags;
+	auto sizes = registry_->getPoolSizes(layout, &flags);
+	std::sort(sizes.begin(), sizes.end(), [](const VkDescriptorPoolSize& a, const VkDescriptorPoolSize& b) { return a.type < b.type; });
+
+	// Pools are shared by whatever needs the same descriptors, not by layout handle.
+	Key key{ flags };
+	for (const auto& size : sizes)
+	{
+		key.insert(key.end(), { static_cast<uint32_t>(size.type), size.descriptorCount });
+	}
+
+	auto [it, inserted] = pools_.try_emplace(std::move(key));
+	if (inserted)
+	{
+		it->second.sizes = std::move(sizes);
+		it->second.flags = flags;
+		it->second.setsPerPool = initialSetsPerPool_;
+	}
+	return it->second;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(Pools& pools)
+{
+	std::vector<VkDescriptorPoolSize> poolSizes = pools.sizes;
+	for (auto& size : poolSizes)
+	{
+		size.descriptorCount *= pools.setsPerPool;
+	}
+
+	VkDescriptorPoolCreateInfo poolCI{};
+	poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCI.flags = pools.flags;
+	poolCI.maxSets = pools.setsPerPool;
+	poolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCI.pPoolSizes = poolSizes.data();
+	VkDescriptorPool pool;
+	check(vkCreateDescriptorPool(device_, &poolCI, nullptr, &pool));
+	setName(device_, pool, fmt::format("{} Pool {}", name_, poolCount_));
+	poolCount_++;
+
+	pools.list.add(pool, pools.setsPerPool);
+	// Whoever ran out once is likely to again, the next pool is bigger.
+	pools.setsPerPool = std::min(maxSetsPerPool_, pools.setsPerPool + pools.setsPerPool / 2 + 1);
+	return pool;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Common/PoolList.h"
+
+class ObjectRegistry;
+
+/**
+ * @brief Hands out descriptor sets from a growing list of pools. Layouts that need the same descriptors share pools,
+ * sizes come from the registry so any layout it owns can be allocated without sizing anything upfront.
+ * A bigger pool is only created once every pool has run out, and the biggest is used first after a reset. Sets are never freed one by one,
+ * reset() gives every set back at once, which is what a per-frame allocator does once its frame has retired. Thread safe.
+*/
+class DescriptorAllocator
+{
+public:
+	/**
+	 * @param name Prefix of the debug names of the pools.
+	*/
+	void init(VkDevice device, ObjectRegistry& registry, const std::string& name, uint32_t initialSetsPerPool = 8, uint32_t maxSetsPerPool = 512);
+	void deinit();
+
+	/**
+	 * @param layout Must come from the registry and have no variable count binding.
+	*/
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+	void allocate(VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* pSets);
+
+	/**
+	 * @brief Every set allocated so far becomes invalid. Nothing using them may still be pending on the GPU.
+	*/
+	void reset();
+
+	struct Stats
+	{
+		uint32_t pools;
+		uint32_t sets; // Allocated since the last reset.
+	};
+	Stats getStats() const;
+
+	~DescriptorAllocator();
+private:
+	using Key = std::vector<uint32_t>;
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Pools
+	{
+		std::vector<VkDescriptorPoolSize> sizes; // For one set.
+		VkDescriptorPoolCreateFlags flags;
+		PoolList<VkDescriptorPool> list;
+		uint32_t setsPerPool;
+	};
+	Pools& getPools(VkDescriptorSetLayout layout);
+	VkDescriptorPool createPool(Pools& pools);
+
+	VkDevice device_{};
+	ObjectRegistry* registry_{};
+	std::string name_;
+	uint32_t initialSetsPerPool_ = 0;
+	uint32_t maxSetsPerPool_ = 0;
+
+	mutable std::mutex mutex_;
+	std::unordered_map<Key, Pools, KeyHash> pools_;
+	uint32_t poolCount_ = 0;
+	uint32_t setCount_ = 0;
+};
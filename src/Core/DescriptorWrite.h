@@ -2,50 +2,65 @@
 
 #include <volk.h>
 #include <vector>
-#include <list>
 #include <map>
 #include <string>
 
+#include "../Common/LinearArena.h"
+
 enum class BufferType
 {
 	Uniform,
 	DynamicUniform,
-	Storage
+	Storage,
+	DynamicStorage
 };
 
 enum class ImageType
 {
-	CombinedSampler
+	CombinedSampler,
+	Storage // Without a sampler, in the General layout.
 };
 
 class DescriptorWrite
 {
 public:
+	/**
+	 * @brief Writes recorded during a frame can pass the frame arena to keep off the heap.
+	*/
+	DescriptorWrite(LinearArena* arena = nullptr);
+
 	void add(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, BufferType type, uint32_t count, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
 	void add(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, ImageType type, uint32_t count, VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout);
 	void write(VkDevice device);
 private:
-	std::list<VkDescriptorBufferInfo> bufferInfos; // to prevent invalidation :)
-	std::list<VkDescriptorImageInfo> imageInfos;
-	std::vector<VkWriteDescriptorSet> writes;
+	ArenaVector<VkDescriptorBufferInfo> bufferInfos;
+	ArenaVector<VkDescriptorImageInfo> imageInfos;
+	ArenaVector<VkWriteDescriptorSet> writes;
+	// Index into bufferInfos or imageInfos per write. Pointers are only taken in write(), as the vectors may grow until then.
+	ArenaVector<size_t> infoIndices;
 };
 
+class Device;
+
 class DescriptorCreator
 {
 public:
 	void add(const std::string& name, uint32_t binding, VkDescriptorType type, uint32_t count, VkShaderStageFlags stages, VkDescriptorBindingFlags flags = 0);
 
-	VkDescriptorSetLayout createLayout(const std::string& name, VkDevice device, VkDescriptorSetLayoutCreateFlags flags = 0);
-	VkDescriptorPool createPool(const std::string& name, VkDevice device, uint32_t multiplesOf = 1u, VkDescriptorPoolCreateFlags flags = 0);
+	/**
+	 * @brief Identical layouts are shared through the device registry, release them with Device::registry.release.
+	*/
+	VkDescriptorSetLayout createLayout(const std::string& name, Device& device, VkDescriptorSetLayoutCreateFlags flags = 0);
 	VkPipelineLayout createPipelineLayout(VkDevice device, const VkDescriptorSetLayout* pLayouts, uint32_t layoutCount, VkPushConstantRange* range = nullptr);
 	VkPipelineLayout createPipelineLayout(VkDevice device, const std::ranges::range auto& layouts, VkPushConstantRange* range = nullptr)
 	{
 		return createPipelineLayout(device, layouts.data(), static_cast<uint32_t>(layouts.size()), range);
 	}
-	void allocateSets(const std::string& name, VkDevice device, uint32_t count, VkDescriptorSet* pSets);
-	void allocateVariableSets(const std::string& name, VkDevice device, uint32_t count, VkDescriptorSet* pSets, uint32_t variableCount);
+	/**
+	 * @brief Sets of a layout made by createLayout, from the device's persistent descriptor allocator.
+	*/
+	void allocateSets(const std::string& name, Device& device, uint32_t count, VkDescriptorSet* pSets);
 private:
 	std::map<std::string, std::pair<std::vector<VkDescriptorSetLayoutBinding>, std::vector<VkDescriptorBindingFlags>>> pipelineBindings;
 	std::map<std::string, VkDescriptorSetLayout> createdLayouts;
-	std::map<std::string, VkDescriptorPool> createdPools;
 };
\ No newline at end of file
@@ -1,15 +1,23 @@
 #include "Device.h"
 
 #include <vector>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 
 #include <GLFW/glfw3.h>
 #include <VkBootstrap.h>
 #include <spdlog/spdlog.h>
+#include <fmt/format.h>
 #include <volk.h>
 #include "Common.h"
+#include "../Common/Bench.h"
 
-void Device::init(void* window)
+void Device::init(void* window, uint32_t framesInFlight)
 {
+	check(framesInFlight >= 1 && framesInFlight <= maxFramesInFlight, "Frames in flight must be between 1 and 4!");
+	framesInFlight_ = framesInFlight;
+
 	auto glfwWindow = static_cast<GLFWwindow*>(window);
 	check(volkInitialize());
 
@@ -82,15 +90,26 @@ void Device::init(void* window)
 		descriptorIndexing.descriptorBindingVariableDescriptorCount = VK_TRUE;
 		descriptorIndexing.pNext = &bufferDeviceAddress;
 
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphore{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+		timelineSemaphore.timelineSemaphore = VK_TRUE;
+		// GPU timestamps are reset from the CPU before a frame slot is recorded again.
+		VkPhysicalDeviceHostQueryResetFeatures hostQueryReset{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES };
+		hostQueryReset.hostQueryReset = VK_TRUE;
+
 		VkPhysicalDeviceFeatures features{};
 		features.samplerAnisotropy = VK_TRUE;
 		features.independentBlend = VK_TRUE;
 		features.multiDrawIndirect = VK_TRUE;
+		// Compute shaders leave the format out of storage images, so one pipeline serves every HDR precision.
+		features.shaderStorageImageReadWithoutFormat = VK_TRUE;
+		features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
 
 		vkb::PhysicalDeviceSelector physicalDeviceSelector{ temporaryInstance };
 		auto physicalDeviceSelectorResult = physicalDeviceSelector
 			.set_surface(surface)
 			.add_required_extension_features(descriptorIndexing)
+			.add_required_extension_features(timelineSemaphore)
+			.add_required_extension_features(hostQueryReset)
 			.add_required_extensions({
 				VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
 				VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
@@ -106,6 +125,14 @@ void Device::init(void* window)
 			std::abort();
 		}
 		temporaryPhysicalDevice = physicalDeviceSelectorResult.value();
+
+		// Optional, pipeline variants are linked from prebuilt parts when available and compiled whole otherwise.
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibrary{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT };
+		graphicsPipelineLibrary.graphicsPipelineLibrary = VK_TRUE;
+		graphicsPipelineLibrary_ =
+			temporaryPhysicalDevice.enable_extension_if_present(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+			temporaryPhysicalDevice.enable_extension_if_present(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+			temporaryPhysicalDevice.enable_extension_features_if_present(graphicsPipelineLibrary);
 	}
 
 	physicalDevice = temporaryPhysicalDevice.physical_device;
@@ -122,6 +149,8 @@ void Device::init(void* window)
 	}
 	device = temporaryDevice;
 	volkLoadDevice(device);
+	registry.init(device);
+	descriptors.init(device, registry, "Persistent");
 
 	{
 		auto graphicsQueueResult = temporaryDevice.get_queue(vkb::QueueType::graphics);
@@ -134,7 +163,8 @@ void Device::init(void* window)
 			);
 			std::abort();
 		}
-		graphicsQueue = { graphicsQueueResult.value(), graphicsQueueIndexResult.value() };
+		graphicsQueue.queue = graphicsQueueResult.value();
+		graphicsQueue.family = graphicsQueueIndexResult.value();
 	}
 	{
 		auto transferQueueResult = temporaryDevice.get_dedicated_queue(vkb::QueueType::transfer);
@@ -147,7 +177,21 @@ void Device::init(void* window)
 			);
 			std::abort();
 		}
-		transferQueue = { transferQueueResult.value(), transferQueueIndexResult.value() };
+		transferQueue.queue = transferQueueResult.value();
+		transferQueue.family = transferQueueIndexResult.value();
+	}
+	{
+		auto computeQueueResult = temporaryDevice.get_queue(vkb::QueueType::compute);
+		auto computeQueueIndexResult = temporaryDevice.get_queue_index(vkb::QueueType::compute);
+		const bool separate = computeQueueResult && computeQueueIndexResult;
+		computeQueue.queue = separate ? computeQueueResult.value() : graphicsQueue.queue;
+		computeQueue.family = separate ? computeQueueIndexResult.value() : graphicsQueue.family;
+		SPDLOG_INFO("Compute queue: {}.", computeQueue.queue != graphicsQueue.queue ? "separate" : "shared with graphics");
+		sharedFamilies_ = { graphicsQueue.family, computeQueue.family };
+	}
+	for (Queue* queue : getQueues())
+	{
+		queue->timeline = CreateInfo::createTimelineSemaphore(device);
 	}
 
 	{
@@ -192,25 +236,51 @@ void Device::init(void* window)
 		allocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 		check(vmaCreateAllocator(&allocatorCreateInfo, &allocator));
 	}
+	transients.init(device, allocator, getMaxFramesInFlight());
 
 	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+	graphicsPipelineLibraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
 	VkPhysicalDeviceProperties2 properties{};
 	Connect(properties, indexingProperties);
+	if (graphicsPipelineLibrary_)
+	{
+		Connect(properties, graphicsPipelineLibraryProperties);
+	}
 
 	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
 	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
 
 	deviceProperties = properties.properties;
 
+	SPDLOG_INFO("Graphics pipeline library: {}.", !graphicsPipelineLibrary_ ? "unsupported" :
+		graphicsPipelineLibraryProperties.graphicsPipelineLibraryFastLinking ? "fast linking" : "supported, slow linking");
+
 	graphicsPool = CreateInfo::createCommandPool(device, graphicsQueue.family);
 	transferPool = CreateInfo::createCommandPool(device, transferQueue.family);
+	computePool = CreateInfo::createCommandPool(device, computeQueue.family);
+
+	createPipelineCache();
 }
 
 void Device::deinit()
 {
+	// Everything submitted has completed.
+	deletionQueue_.flush();
+
+	savePipelineCache();
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
 	vkDestroyCommandPool(device, graphicsPool, nullptr);
 	vkDestroyCommandPool(device, transferPool, nullptr);
+	vkDestroyCommandPool(device, computePool, nullptr);
+	for (const Queue* queue : getQueues())
+	{
+		vkDestroySemaphore(device, queue->timeline, nullptr);
+	}
 
+	descriptors.deinit();
+	registry.deinit();
+	transients.deinit();
 	vmaDestroyAllocator(allocator);
 
 	vkDestroyDevice(device, nullptr);
@@ -219,44 +289,320 @@ void Device::deinit()
 	vkDestroyInstance(instance, nullptr);
 }
 
-uint32_t Device::getMaxFramesInFlight() const
+void Device::beginFrame(uint32_t frame)
 {
-	return 2;
+	transients.beginFrame(frame);
+
+	// The frame recorded framesInFlight ago used this frame's resources and has been waited on, as has everything before it.
+	const uint64_t begun = ++framesBegun_;
+	framesCompleted_ = begun > framesInFlight_ ? begun - framesInFlight_ : 0;
+	collect();
 }
 
-VkFormat Device::getSurfaceFormat() const
+void Device::release(std::function<void()> destroy)
 {
-	return VK_FORMAT_R8G8B8A8_SRGB;
+	Retirement retirement{ framesBegun_.load() };
+	const auto queues = getQueues();
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		retirement.submitted[i] = queues[i]->submitted.load();
+	}
+	deletionQueue_.push(retirement, std::move(destroy));
 }
 
-VkFormat Device::getDepthFormat() const
+void Device::releaseAfter(Ticket ticket, std::function<void()> destroy)
 {
-	if (depthFormat_ != VK_FORMAT_UNDEFINED)
-		return depthFormat_;
-
-	const auto formats = {
-			VK_FORMAT_D32_SFLOAT_S8_UINT,
-			VK_FORMAT_D32_SFLOAT,
-			VK_FORMAT_D24_UNORM_S8_UINT, 
-			VK_FORMAT_D16_UNORM_S8_UINT, 
-			VK_FORMAT_D16_UNORM
-	};
-	for (const auto& format : formats)
+	Retirement retirement{};
+	const auto queues = getQueues();
+	for (size_t i = 0; i < queues.size(); i++)
 	{
-		VkFormatProperties properties;
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+		if (queues[i] == ticket.queue)
+		{
+			retirement.submitted[i] = ticket.value;
+		}
+	}
+	deletionQueue_.push(retirement, std::move(destroy));
+}
 
-		if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+Device::Ticket Device::submit(Queue& queue, VkCommandBuffer commandBuffer, std::span<const Ticket> waits,
+	std::span<const VkSemaphoreSubmitInfo> semaphoreWaits, std::span<const VkSemaphoreSubmitInfo> semaphoreSignals)
+{
+	// Fixed storage, a frame's submission allocates nothing.
+	constexpr size_t maxSemaphores = 8;
+	std::array<VkSemaphoreSubmitInfo, maxSemaphores> waitInfos{};
+	std::array<VkSemaphoreSubmitInfo, maxSemaphores> signalInfos{};
+	uint32_t waitCount = 0;
+	uint32_t signalCount = 0;
+
+	check(waits.size() + semaphoreWaits.size() <= maxSemaphores && semaphoreSignals.size() < maxSemaphores, "Too many semaphores in one submission!");
+	for (const auto& ticket : waits)
+	{
+		if (!ticket.queue || ticket.value == 0)
 		{
-			depthFormat_ = format;
-			return depthFormat_;
+			continue;
 		}
+		auto& info = waitInfos[waitCount++];
+		info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		info.semaphore = ticket.queue->timeline;
+		info.value = ticket.value;
+		info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	}
+	for (const auto& info : semaphoreWaits)
+	{
+		waitInfos[waitCount++] = info;
+	}
+	for (const auto& info : semaphoreSignals)
+	{
+		signalInfos[signalCount++] = info;
+	}
+
+	VkCommandBufferSubmitInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+	commandBufferInfo.commandBuffer = commandBuffer;
+	const uint32_t commandBufferCount = commandBuffer ? 1 : 0;
+
+	std::lock_guard lock(submitMutex_);
+	const Ticket ticket{ &queue, ++queue.submitted };
+	auto& timelineInfo = signalInfos[signalCount++];
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.semaphore = queue.timeline;
+	timelineInfo.value = ticket.value;
+	timelineInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+	VkSubmitInfo2 submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+	submitInfo.waitSemaphoreInfoCount = waitCount;
+	submitInfo.pWaitSemaphoreInfos = waitInfos.data();
+	submitInfo.commandBufferInfoCount = commandBufferCount;
+	submitInfo.pCommandBufferInfos = &commandBufferInfo;
+	submitInfo.signalSemaphoreInfoCount = signalCount;
+	submitInfo.pSignalSemaphoreInfos = signalInfos.data();
+	check(vkQueueSubmit2(queue.queue, 1, &submitInfo, VK_NULL_HANDLE));
+	return ticket;
+}
+
+Device::Ticket Device::submitOneTime(Queue& queue, const std::function<void(VkCommandBuffer)>& action, std::span<const Ticket> waits)
+{
+	const VkCommandPool pool = &queue == &graphicsQueue ? graphicsPool : &queue == &transferQueue ? transferPool : computePool;
+
+	collect();
+	VkCommandBuffer commandBuffer;
+	{
+		// Command pools are not thread safe either.
+		std::lock_guard lock(submitMutex_);
+		commandBuffer = CreateInfo::allocateCommandBuffer(device, pool);
 	}
-	check(false, "Failed to select depth format!");
-	__assume(false);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	check(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+	action(commandBuffer);
+	check(vkEndCommandBuffer(commandBuffer));
+
+	const Ticket ticket = submit(queue, commandBuffer, waits);
+	releaseAfter(ticket, [this, pool, commandBuffer]() {
+		std::lock_guard lock(submitMutex_);
+		vkFreeCommandBuffers(device, pool, 1, &commandBuffer);
+	});
+	return ticket;
 }
 
-void Device::performGeneralTask(const std::function<void(VkCommandBuffer)>& action)
+bool Device::isComplete(Ticket ticket) const
 {
-	CreateInfo::performOneTimeAction(device, graphicsQueue.queue, graphicsPool, action);
+	if (!ticket.queue)
+	{
+		return true;
+	}
+	uint64_t value;
+	check(vkGetSemaphoreCounterValue(device, ticket.queue->timeline, &value));
+	return value >= ticket.value;
+}
+
+void Device::wait(Ticket ticket) const
+{
+	if (!ticket.queue)
+	{
+		return;
+	}
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &ticket.queue->timeline;
+	waitInfo.pValues = &ticket.value;
+	check(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+}
+
+std::array<Device::Ticket, 2> Device::getAsyncTickets() const
+{
+	return { Ticket{ &transferQueue, transferQueue.submitted.load() }, Ticket{ &computeQueue, computeQueue.submitted.load() } };
+}
+
+void Device::shareAcrossQueues(VkImageCreateInfo& imageCI) const
+{
+	if (sharedFamilies_[0] == sharedFamilies_[1])
+	{
+		return;
+	}
+	imageCI.sharingMode = VK_SHARING_MODE_CONCURRENT;
+	imageCI.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilies_.size());
+	imageCI.pQueueFamilyIndices = sharedFamilies_.data();
+}
+
+std::vector<uint32_t> Device::getSharedFamilies() const
+{
+	if (sharedFamilies_[0] == sharedFamilies_[1])
+	{
+		return {};
+	}
+	return { sharedFamilies_.begin(), sharedFamilies_.end() };
+}
+
+std::array<Device::Queue*, 3> Device::getQueues()
+{
+	return { &graphicsQueue, &transferQueue, &computeQueue };
+}
+
+void Device::collect()
+{
+	// Whoever comes second leaves it to the next call.
+	std::unique_lock lock(collectMutex_, std::try_to_lock);
+	if (!lock)
+	{
+		return;
+	}
+
+	const auto queues = getQueues();
+	std::array<uint64_t, 3> completed{};
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		check(vkGetSemaphoreCounterValue(device, queues[i]->timeline, &completed[i]));
+	}
+	const uint64_t framesCompleted = framesCompleted_.load();
+
+	deletionQueue_.collect([&](const Retirement& retirement) {
+		if (retirement.frame > framesCompleted)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < completed.size(); i++)
+		{
+			if (retirement.submitted[i] > completed[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+Device::Ticket Device::performGeneralTask(const std::function<void(VkCommandBuffer)>& action)
+{
+	return submitOneTime(graphicsQueue, action);
+}
+
+VkResult Device::createGraphicsPipelines(uint32_t count, const VkGraphicsPipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines)
+{
+	auto s = Bench::record();
+	const VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, count, pCreateInfos, nullptr, pPipelines);
+	auto e = Bench::record();
+
+	pipelineCount_ += count;
+	pipelineMicroseconds_ += static_cast<uint64_t>(Bench::diff<double, std::micro>(s, e));
+	return result;
+}
+
+VkResult Device::createComputePipelines(uint32_t count, const VkComputePipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines)
+{
+	auto s = Bench::record();
+	const VkResult result = vkCreateComputePipelines(device, pipelineCache, count, pCreateInfos, nullptr, pPipelines);
+	auto e = Bench::record();
+
+	pipelineCount_ += count;
+	pipelineMicroseconds_ += static_cast<uint64_t>(Bench::diff<double, std::micro>(s, e));
+	return result;
+}
+
+bool Device::supportsGraphicsPipelineLibrary() const
+{
+	return graphicsPipelineLibrary_;
+}
+
+bool Device::supportsFormat(VkFormat format, VkFormatFeatureFlags2 features) const
+{
+	VkFormatProperties3 properties3{ VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3 };
+	VkFormatProperties2 properties{ VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2 };
+	Connect(properties, properties3);
+	vkGetPhysicalDeviceFormatProperties2(physicalDevice, format, &properties);
+	return (properties3.optimalTilingFeatures & features) == features;
+}
+
+Device::PipelineStats Device::getPipelineStats() const
+{
+	return { pipelineCount_.load(), static_cast<float>(pipelineMicroseconds_.load()) / 1000.f, pipelineCacheWarm_ };
+}
+
+void Device::createPipelineCache()
+{
+	// Caches are only valid for the exact driver that produced them.
+	pipelineCachePath_ = fmt::format("pipeline_cache_{:04x}_{:04x}_{:x}.bin", deviceProperties.vendorID, deviceProperties.deviceID, deviceProperties.driverVersion);
+
+	std::vector<char> data;
+	if (std::ifstream file(pipelineCachePath_, std::ios::ate | std::ios::binary); file.is_open())
+	{
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+	}
+
+	// The driver checks this too, but a foreign blob is simply dropped here instead of relying on it.
+	VkPipelineCacheHeaderVersionOne header{};
+	if (data.size() >= sizeof(header))
+	{
+		std::memcpy(&header, data.data(), sizeof(header));
+	}
+	const bool valid = data.size() >= sizeof(header) &&
+		header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header.vendorID == deviceProperties.vendorID &&
+		header.deviceID == deviceProperties.deviceID &&
+		std::memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	if (!valid)
+	{
+		data.clear();
+	}
+	pipelineCacheWarm_ = !data.empty();
+
+	VkPipelineCacheCreateInfo pipelineCacheCI{};
+	pipelineCacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCI.initialDataSize = data.size();
+	pipelineCacheCI.pInitialData = data.data();
+	check(vkCreatePipelineCache(device, &pipelineCacheCI, nullptr, &pipelineCache));
+
+	SPDLOG_INFO("Pipeline cache {}: {} ({} bytes).", pipelineCacheWarm_ ? "loaded" : "cold", pipelineCachePath_, data.size());
+}
+
+void Device::savePipelineCache()
+{
+	size_t size = 0;
+	check(vkGetPipelineCacheData(device, pipelineCache, &size, nullptr));
+	std::vector<char> data(size);
+	check(vkGetPipelineCacheData(device, pipelineCache, &size, data.data()));
+
+	// Written aside first, so a crash halfway never leaves a truncated cache behind.
+	const std::string temporaryPath = pipelineCachePath_ + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			SPDLOG_WARN("Could not write pipeline cache to {}.", temporaryPath);
+			return;
+		}
+		file.write(data.data(), size);
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, pipelineCachePath_, error);
+	if (error)
+	{
+		SPDLOG_WARN("Could not write pipeline cache to {}: {}.", pipelineCachePath_, error.message());
+	}
 }
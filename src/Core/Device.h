@@ -2,7 +2,18 @@
 
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
+#include <array>
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ObjectRegistry.h"
+#include "DescriptorAllocator.h"
+#include "TransientPool.h"
+#include "../Common/DeletionQueue.h"
 
 /**
  * @brief Class to reference back for query state, allocation and deallocation.
@@ -14,11 +25,26 @@ public:
 	{
 		VkQueue queue;
 		uint32_t family;
+		// Every submission to the queue signals the next value. One per queue, as submissions to different queues may complete out of order.
+		VkSemaphore timeline;
+		std::atomic<uint64_t> submitted = 0; // Value of the last submission.
+	};
+
+	/**
+	 * @brief A submission, complete once its queue's timeline reaches value. A default ticket is always complete.
+	*/
+	struct Ticket
+	{
+		const Queue* queue = nullptr;
+		uint64_t value = 0;
 	};
 
 	Device() = default;
 
-	void init(void* window);
+	/**
+	 * @param framesInFlight Frames the CPU may record ahead of the GPU, 1 to 4. Every per-frame ring is sized from it, so it is fixed for the device's lifetime.
+	*/
+	void init(void* window, uint32_t framesInFlight = 2);
 	void deinit();
 	
 	VkInstance instance{};
@@ -34,17 +60,131 @@ public:
 	VkCommandPool transferPool{};
 	Queue transferQueue{};
 
+	// A queue of its own when the device has a compute family without graphics, the graphics queue otherwise.
+	VkCommandPool computePool{};
+	Queue computeQueue{};
+
 	VkPhysicalDeviceProperties deviceProperties{};
 	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+	VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT graphicsPipelineLibraryProperties{};
+
+	// Seeded from disk in init and written back in deinit.
+	VkPipelineCache pipelineCache{};
+
+	// Shader modules and set layouts shared by content.
+	ObjectRegistry registry;
+	// Sets that live as long as their owner. They are not freed one by one, per-frame sets use an allocator that is reset.
+	DescriptorAllocator descriptors;
+	// Memory of render targets that are recreated on resize.
+	TransientPool transients;
+	/**
+	 * @brief Call once the frame's last submission has completed. Destroys what the GPU is done with.
+	*/
+	void beginFrame(uint32_t frame);
+
+	/**
+	 * @brief Any thread, without locking. Runs destroy once the frame being recorded and everything submitted so far have
+	 * completed, so objects can be let go of while frames in flight or one-time work still use them.
+	 * Work recorded but not yet submitted is not covered, release what it uses after submitting it.
+	*/
+	void release(std::function<void()> destroy);
+	/**
+	 * @brief Runs destroy once ticket has completed, for what nothing but that submission uses.
+	*/
+	void releaseAfter(Ticket ticket, std::function<void()> destroy);
+
+	/**
+	 * @brief Submits commandBuffer once the work of waits has completed, signalling the queue's timeline.
+	 * Without a command buffer the submission only joins waits into the queue: later submissions to it wait on them too.
+	 * @param semaphoreWaits, semaphoreSignals Other semaphores, such as the swapchain's binary ones.
+	*/
+	Ticket submit(Queue& queue, VkCommandBuffer commandBuffer, std::span<const Ticket> waits = {},
+		std::span<const VkSemaphoreSubmitInfo> semaphoreWaits = {}, std::span<const VkSemaphoreSubmitInfo> semaphoreSignals = {});
+	/**
+	 * @brief Records action and submits it without waiting on the CPU, the GPU waits on waits. Its command buffer is freed once the ticket completes.
+	 * What the commands read must be released after this returns.
+	*/
+	Ticket submitOneTime(Queue& queue, const std::function<void(VkCommandBuffer)>& action, std::span<const Ticket> waits = {});
+	bool isComplete(Ticket ticket) const;
+	void wait(Ticket ticket) const;
+	/**
+	 * @return The latest work on the transfer and compute queues. A frame waits on these before reading what they wrote.
+	*/
+	std::array<Ticket, 2> getAsyncTickets() const;
+	/**
+	 * @brief Makes an image usable by the graphics and compute queues alike, without ownership transfers.
+	 * Nothing changes when both are the same family. imageCI refers to the device's family list, keep the device alive.
+	*/
+	void shareAcrossQueues(VkImageCreateInfo& imageCI) const;
+	/**
+	 * @return The same for buffers, the family indices to create them with. Empty when both are the same family.
+	*/
+	std::vector<uint32_t> getSharedFamilies() const;
 
 	uint32_t getMaxFramesInFlight() const;
+	static constexpr uint32_t maxFramesInFlight = 4;
 	VkFormat getSurfaceFormat() const;
 	VkFormat getDepthFormat() const;
 
 	
-	void performGeneralTask(const std::function<void(VkCommandBuffer)>&);
+	Ticket performGeneralTask(const std::function<void(VkCommandBuffer)>&);
+
+	/**
+	 * @brief vkCreateGraphicsPipelines through the pipeline cache. Time spent is added to getPipelineStats().
+	*/
+	VkResult createGraphicsPipelines(uint32_t count, const VkGraphicsPipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines);
+	VkResult createComputePipelines(uint32_t count, const VkComputePipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines);
+
+	struct PipelineStats
+	{
+		uint32_t count;
+		float milliseconds;
+		bool warmCache; // A matching cache was found on disk.
+	};
+	PipelineStats getPipelineStats() const;
+
+	/**
+	 * @brief VK_EXT_graphics_pipeline_library is enabled, pipelines can be linked from separately compiled parts.
+	*/
+	bool supportsGraphicsPipelineLibrary() const;
+	/**
+	 * @return Images of format with optimal tiling support every one of features.
+	*/
+	bool supportsFormat(VkFormat format, VkFormatFeatureFlags2 features) const;
 
 private:
+	void createPipelineCache();
+	void savePipelineCache();
+
+	std::string pipelineCachePath_;
+	bool pipelineCacheWarm_ = false;
+	bool graphicsPipelineLibrary_ = false;
+	std::atomic<uint32_t> pipelineCount_ = 0;
+	std::atomic<uint64_t> pipelineMicroseconds_ = 0;
+
+	std::array<Queue*, 3> getQueues();
+	/**
+	 * @brief Runs the releases the GPU is done with.
+	*/
+	void collect();
+
+	// Guards queue submission, which has to happen in the order of the values handed out, and the one-time command pools.
+	std::mutex submitMutex_;
+
+	// What may still use a released object.
+	struct Retirement
+	{
+		uint64_t frame; // Being recorded when released, 0 before the first.
+		std::array<uint64_t, 3> submitted; // Per queue, in getQueues() order.
+	};
+	DeletionQueue<Retirement> deletionQueue_;
+	std::mutex collectMutex_; // One consumer at a time.
+	std::atomic<uint64_t> framesBegun_ = 0;
+	std::atomic<uint64_t> framesCompleted_ = 0;
+
+	std::array<uint32_t, 2> sharedFamilies_{}; // Graphics and compute.
+
 	// Use this to cache search results.
 	mutable VkFormat depthFormat_ = VK_FORMAT_UNDEFINED;
+	uint32_t framesInFlight_ = 2;
 };
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/**
+ * @brief A descriptor used by a shader, reflected at build time.
+*/
+struct ShaderResource
+{
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType type;
+};
+
+/**
+ * @brief SPIR-V compiled into the executable together with its reflection, see tools/ShaderEmbed.cpp.
+ * Every shader in shaders/ gets a generated header, e.g. PBR.vert is Shaders::PBR_vert in "Shaders/PBR.vert.h".
+*/
+struct EmbeddedShader
+{
+	std::string_view name;
+	VkShaderStageFlagBits stage;
+	std::span<const uint32_t> code;
+	std::span<const ShaderResource> resources;
+	uint32_t pushConstantSize;
+};
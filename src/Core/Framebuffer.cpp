@@ -16,7 +16,7 @@ void Framebuffer::addDepthAttachment(VkImageView image)
 	depthAttachment_ = image;
 }
 
-void Framebuffer::beginRendering(VkCommandBuffer commandBuffer, const std::vector<FramebufferOption>& options)
+void Framebuffer::beginRendering(VkCommandBuffer commandBuffer, const std::vector<FramebufferOption>& options, VkRenderingFlags flags)
 {
 	std::vector<VkRenderingAttachmentInfo> colorAttachments{};
 	VkRenderingAttachmentInfo depthAttachment{};
@@ -31,6 +31,7 @@ void Framebuffer::beginRendering(VkCommandBuffer commandBuffer, const std::vecto
 
 	VkRenderingInfo renderInfo{};
 	renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	renderInfo.flags = flags;
 	renderInfo.renderArea.offset = { 0, 0 };
 	renderInfo.renderArea.extent = framebufferExtent_;
 	renderInfo.layerCount = 1;
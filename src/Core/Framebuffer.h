@@ -26,7 +26,7 @@ public:
 	Framebuffer(VkExtent2D extent);
 	void addColorAttachment(VkImageView image);
 	void addDepthAttachment(VkImageView image);
-	void beginRendering(VkCommandBuffer commandBuffer, const std::vector<FramebufferOption>& options);
+	void beginRendering(VkCommandBuffer commandBuffer, const std::vector<FramebufferOption>& options, VkRenderingFlags flags = 0);
 	void endRendering(VkCommandBuffer commandBuffer);
 private:
 	std::vector<VkImageView> colorAttachements_{};
@@ -0,0 +1,95 @@
+#include "GpuTimer.h"
+#include "Device.h"
+#include "Common.h"
+
+#include <volk.h>
+
+GpuTimer::GpuTimer(Device& device, uint32_t framesInFlight, uint32_t scopeCount):
+	device_(device), scopeCount_(scopeCount), results_(scopeCount * 4), intervals_(scopeCount)
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device_.physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device_.physicalDevice, &familyCount, families.data());
+	supported_ =
+		families[device_.graphicsQueue.family].timestampValidBits != 0 &&
+		families[device_.computeQueue.family].timestampValidBits != 0;
+	period_ = static_cast<double>(device_.deviceProperties.limits.timestampPeriod) / 1e6;
+	if (!supported_)
+	{
+		return;
+	}
+
+	VkQueryPoolCreateInfo poolCI{};
+	poolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolCI.queryCount = scopeCount_ * 2;
+	pools_.resize(framesInFlight);
+	for (auto& pool : pools_)
+	{
+		check(vkCreateQueryPool(device_.device, &poolCI, nullptr, &pool));
+		// Queries have to be reset before they are first written.
+		vkResetQueryPool(device_.device, pool, 0, poolCI.queryCount);
+	}
+}
+
+bool GpuTimer::isSupported() const
+{
+	return supported_;
+}
+
+void GpuTimer::beginFrame(uint32_t frame)
+{
+	frame_ = frame;
+	if (!supported_)
+	{
+		return;
+	}
+
+	// Scopes the frame skipped stay unavailable, which is not an error.
+	const uint32_t queryCount = scopeCount_ * 2;
+	const VkResult result = vkGetQueryPoolResults(device_.device, pools_[frame_], 0, queryCount,
+		results_.size() * sizeof(uint64_t), results_.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	check(result == VK_SUCCESS || result == VK_NOT_READY, "Failed to read timestamps!");
+
+	for (uint32_t scope = 0; scope < scopeCount_; scope++)
+	{
+		const uint64_t* begin = &results_[scope * 4];
+		const uint64_t* end = &results_[scope * 4 + 2];
+		intervals_[scope].reset();
+		if (begin[1] && end[1])
+		{
+			intervals_[scope] = Interval{ static_cast<double>(begin[0]) * period_, static_cast<double>(end[0]) * period_ };
+		}
+	}
+	vkResetQueryPool(device_.device, pools_[frame_], 0, queryCount);
+}
+
+void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+	if (supported_)
+	{
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, pools_[frame_], scope * 2);
+	}
+}
+
+void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+	if (supported_)
+	{
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, pools_[frame_], scope * 2 + 1);
+	}
+}
+
+std::optional<Interval> GpuTimer::get(uint32_t scope) const
+{
+	return intervals_[scope];
+}
+
+GpuTimer::~GpuTimer()
+{
+	for (const auto& pool : pools_)
+	{
+		vkDestroyQueryPool(device_.device, pool, nullptr);
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "../Common/Overlap.h"
+
+class Device;
+
+/**
+ * @brief GPU timestamps around scopes of a frame, such as passes, on the graphics or the compute queue.
+ * One query pool per frame in flight, read back once the frame comes around again, so nothing waits on the GPU.
+ * Timestamps of different queues are compared as if they shared a clock. Vulkan does not promise that,
+ * though desktop drivers count both in the same device time domain.
+*/
+class GpuTimer
+{
+public:
+	GpuTimer(Device& device, uint32_t framesInFlight, uint32_t scopeCount);
+
+	/**
+	 * @brief Timestamps are valid on the graphics and compute queues. Without, get() has nothing.
+	*/
+	bool isSupported() const;
+
+	/**
+	 * @brief Reads back what the frame's pool recorded when it was last used, then resets it for the frame.
+	 * Everything recorded with the frame before, on any queue, must have completed.
+	*/
+	void beginFrame(uint32_t frame);
+	void begin(VkCommandBuffer commandBuffer, uint32_t scope);
+	void end(VkCommandBuffer commandBuffer, uint32_t scope);
+
+	/**
+	 * @return In milliseconds on the device's clock, from the last read back. Empty if the scope was not recorded.
+	*/
+	std::optional<Interval> get(uint32_t scope) const;
+
+	~GpuTimer();
+private:
+	Device& device_;
+	const uint32_t scopeCount_;
+	bool supported_ = false;
+	double period_ = 0.0; // Milliseconds per tick.
+
+	std::vector<VkQueryPool> pools_; // Per frame in flight, a begin and an end per scope.
+	uint32_t frame_ = 0;
+
+	// Value and availability per query.
+	std::vector<uint64_t> results_;
+	std::vector<std::optional<Interval>> intervals_;
+};
@@ -8,7 +8,8 @@
 #include <cassert>
 
 Image::Image(Device& device, const VkImageCreateInfo& imageInfo): 
-    device_(device), format_(imageInfo.format), width(imageInfo.extent.width), height(imageInfo.extent.height), mipLevels(imageInfo.mipLevels), arrayLevels(imageInfo.arrayLayers)
+    device_(device), format_(imageInfo.format), width(imageInfo.extent.width), height(imageInfo.extent.height), mipLevels(imageInfo.mipLevels), arrayLevels(imageInfo.arrayLayers),
+    states_(imageInfo.mipLevels, imageInfo.arrayLayers)
 {
 	VmaAllocationCreateInfo allocCI{};
 	allocCI.usage = VMA_MEMORY_USAGE_AUTO;
@@ -16,6 +17,14 @@ Image::Image(Device& device, const VkImageCreateInfo& imageInfo):
 	check(vmaCreateImage(device_.allocator, &imageInfo, &allocCI, &image_, &allocation_, nullptr));
 }
 
+Image::Image(Device& device, const VkImageCreateInfo& imageInfo, VmaAllocation memory, VkDeviceSize offset):
+    device_(device), format_(imageInfo.format), width(imageInfo.extent.width), height(imageInfo.extent.height), mipLevels(imageInfo.mipLevels), arrayLevels(imageInfo.arrayLayers),
+    states_(imageInfo.mipLevels, imageInfo.arrayLayers)
+{
+	check(vkCreateImage(device_.device, &imageInfo, nullptr, &image_));
+	check(vmaBindImageMemory2(device_.allocator, memory, offset, image_, nullptr));
+}
+
 void Image::attachImageView(VkImageAspectFlags flags)
 {
 	assert(image_ && "Image is not initialised!");
@@ -144,32 +153,20 @@ uint32_t Image::calculateMaxMiplevels(int width, int height)
     return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
 }
 
-void Image::generateMipmaps(VkImage image, int width, int height, uint32_t mipLevels, VkCommandBuffer commandBuffer)
+void Image::generateMipmaps(VkImage image, int width, int height, uint32_t mipLevels, VkCommandBuffer commandBuffer, uint32_t layerCount)
 {
-    VkImageMemoryBarrier2 barrier2{};
-    barrier2.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    barrier2.image = image;
-    barrier2.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier2.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier2.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier2.subresourceRange.baseArrayLayer = 0;
-    barrier2.subresourceRange.layerCount = 1;
-    barrier2.subresourceRange.levelCount = 1;
-
-    VkDependencyInfo dependencyInfo{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
-    dependencyInfo.imageMemoryBarrierCount = 1;
-    dependencyInfo.pImageMemoryBarriers = &barrier2;
+    const auto mipRange = [&](uint32_t mip) {
+        return VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, layerCount };
+    };
 
+    // The source of a blit and the previous source leaving for the shader share one barrier.
+    BarrierBatch barriers;
     for (uint32_t i = 1; i < mipLevels; i++) {
-        barrier2.subresourceRange.baseMipLevel = i - 1;
-        barrier2.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier2.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier2.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-        barrier2.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-        barrier2.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        barrier2.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-
-        vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+        barriers.transition(image, mipRange(i - 1), ImageUsage::TransferDestination, ImageUsage::TransferSource);
+        if (i > 1) {
+            barriers.transition(image, mipRange(i - 2), ImageUsage::TransferSource, ImageUsage::Sampled);
+        }
+        barriers.flush(commandBuffer);
 
         VkImageBlit2 blit{};
         blit.sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2;
@@ -178,13 +175,13 @@ void Image::generateMipmaps(VkImage image, int width, int height, uint32_t mipLe
         blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         blit.srcSubresource.mipLevel = i - 1;
         blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 1;
+        blit.srcSubresource.layerCount = layerCount;
         blit.dstOffsets[0] = { 0, 0, 0 };
         blit.dstOffsets[1] = { width > 1 ? width / 2 : 1, height > 1 ? height / 2 : 1, 1 };
         blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         blit.dstSubresource.mipLevel = i;
         blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = 1;
+        blit.dstSubresource.layerCount = layerCount;
 
         VkBlitImageInfo2 blitInfo{};
         blitInfo.sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2;
@@ -198,233 +195,41 @@ void Image::generateMipmaps(VkImage image, int width, int height, uint32_t mipLe
 
         vkCmdBlitImage2(commandBuffer, &blitInfo);
 
-        barrier2.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier2.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-        barrier2.srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-        barrier2.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-        barrier2.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        barrier2.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-
-        vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
         if (width > 1) width /= 2;
         if (height > 1) height /= 2;
     }
 
-    barrier2.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier2.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier2.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-    barrier2.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-    barrier2.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-    barrier2.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-    barrier2.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-
-    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
-}
-
-void Image::generateCubemapMipmaps(VkImage image, int width, uint32_t mipLevels, VkCommandBuffer commandBuffer)
-{
-    VkImageMemoryBarrier2 barrier2{};
-    barrier2.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    barrier2.image = image;
-    barrier2.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier2.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier2.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier2.subresourceRange.baseArrayLayer = 0;
-    barrier2.subresourceRange.layerCount = 6;
-    barrier2.subresourceRange.levelCount = 1;
-
-    VkDependencyInfo dependencyInfo{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
-    dependencyInfo.imageMemoryBarrierCount = 1;
-    dependencyInfo.pImageMemoryBarriers = &barrier2;
-
-    for (uint32_t i = 1; i < mipLevels; i++) {
-        barrier2.subresourceRange.baseMipLevel = i - 1;
-        barrier2.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier2.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier2.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-        barrier2.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-        barrier2.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        barrier2.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-
-        vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
-
-        VkImageBlit2 blit{};
-        blit.sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2;
-        blit.srcOffsets[0] = { 0, 0, 0 };
-        blit.srcOffsets[1] = { width, width, 1 };
-        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.srcSubresource.mipLevel = i - 1;
-        blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 6;
-        blit.dstOffsets[0] = { 0, 0, 0 };
-        blit.dstOffsets[1] = { width > 1 ? width / 2 : 1, width > 1 ? width / 2 : 1, 1 };
-        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.dstSubresource.mipLevel = i;
-        blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = 6;
-
-        VkBlitImageInfo2 blitInfo{};
-        blitInfo.sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2;
-        blitInfo.dstImage = image;
-        blitInfo.srcImage = image;
-        blitInfo.srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        blitInfo.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        blitInfo.regionCount = 1;
-        blitInfo.pRegions = &blit;
-        blitInfo.filter = VK_FILTER_LINEAR;
-
-        vkCmdBlitImage2(commandBuffer, &blitInfo);
-
-        barrier2.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier2.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-        barrier2.srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-        barrier2.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-        barrier2.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-        barrier2.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-
-        vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
-        if (width > 1) width /= 2;
+    if (mipLevels > 1) {
+        barriers.transition(image, mipRange(mipLevels - 2), ImageUsage::TransferSource, ImageUsage::Sampled);
     }
-
-    barrier2.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier2.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier2.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-    barrier2.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-    barrier2.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-    barrier2.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-    barrier2.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-
-    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+    barriers.transition(image, mipRange(mipLevels - 1), ImageUsage::TransferDestination, ImageUsage::Sampled);
+    barriers.flush(commandBuffer);
 }
 
 void Image::generateMaxMipmaps(VkCommandBuffer commandBuffer)
 {
-    generateMipmaps(image_, int(width), int(height), mipLevels, commandBuffer);
-}
-
-void Image::generateMaxCubeMipmaps(VkCommandBuffer commandBuffer)
-{
-    generateCubemapMipmaps(image_, int(width), mipLevels, commandBuffer);
-}
-
-void Image::UndefinedToColorAttachment(VkCommandBuffer commandBuffer) const
-{
-    VkImageMemoryBarrier2 imageBarrier{};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-    imageBarrier.srcQueueFamilyIndex = 0;
-    imageBarrier.dstQueueFamilyIndex = 0;
-    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    imageBarrier.image = image_;
-    imageBarrier.subresourceRange = getFullRange();
-
-    VkDependencyInfo dependency{};
-    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-    dependency.imageMemoryBarrierCount = 1;
-    dependency.pImageMemoryBarriers = &imageBarrier;
-
-    vkCmdPipelineBarrier2KHR(commandBuffer, &dependency);
-}
-
-void Image::UndefinedToTransferDestination(VkCommandBuffer commandBuffer) const
-{
-    VkImageMemoryBarrier2 imageBarrier{};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-    imageBarrier.srcQueueFamilyIndex = 0;
-    imageBarrier.dstQueueFamilyIndex = 0;
-    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    imageBarrier.image = image_;
-    imageBarrier.subresourceRange = getFullRange();
-
-    VkDependencyInfo dependency{};
-    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-    dependency.imageMemoryBarrierCount = 1;
-    dependency.pImageMemoryBarriers = &imageBarrier;
-
-    vkCmdPipelineBarrier2KHR(commandBuffer, &dependency);
-}
-
-void Image::ColorAttachmentToTransferDestination(VkCommandBuffer commandBuffer) const
-{
-    VkImageMemoryBarrier2 imageBarrier{};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-    imageBarrier.srcQueueFamilyIndex = 0;
-    imageBarrier.dstQueueFamilyIndex = 0;
-    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    imageBarrier.image = image_;
-    imageBarrier.subresourceRange = getFullRange();
-
-    VkDependencyInfo depedency{};
-    depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-    depedency.imageMemoryBarrierCount = 1;
-    depedency.pImageMemoryBarriers = &imageBarrier;
-
-    vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+    generateMipmaps(image_, int(width), int(height), mipLevels, commandBuffer, arrayLevels);
+    states_.set(0, mipLevels, 0, arrayLevels, getImageState(ImageUsage::Sampled));
 }
 
-void Image::ColorAttachmentToShaderReadOptimal(VkCommandBuffer commandBuffer) const
+void Image::transition(VkCommandBuffer commandBuffer, ImageUsage usage)
 {
-    VkImageMemoryBarrier2 imageBarrier{};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-    imageBarrier.srcQueueFamilyIndex = 0;
-    imageBarrier.dstQueueFamilyIndex = 0;
-    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageBarrier.image = image_;
-    imageBarrier.subresourceRange = getFullRange();
-
-    VkDependencyInfo depedency{};
-    depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-    depedency.imageMemoryBarrierCount = 1;
-    depedency.pImageMemoryBarriers = &imageBarrier;
-
-    vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+    BarrierBatch barriers;
+    barriers.transition(*this, usage);
+    barriers.flush(commandBuffer);
 }
 
-void Image::ShaderReadOptimalToColorAttachment(VkCommandBuffer commandBuffer) const
+SubresourceStates<ImageState>& Image::getStates()
 {
-    VkImageMemoryBarrier2 imageBarrier{};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    imageBarrier.srcAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-    imageBarrier.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    imageBarrier.srcQueueFamilyIndex = 0;
-    imageBarrier.dstQueueFamilyIndex = 0;
-    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    imageBarrier.image = image_;
-    imageBarrier.subresourceRange = getFullRange();
-
-    VkDependencyInfo depedency{};
-    depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-    depedency.imageMemoryBarrierCount = 1;
-    depedency.pImageMemoryBarriers = &imageBarrier;
-
-    vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+    return states_;
 }
 
 Image::~Image()
 {
-	vkDestroySampler(device_.device, sampler_, nullptr);
-	vkDestroyImageView(device_.device, imageView_, nullptr);
-	vmaDestroyImage(device_.allocator, image_, allocation_);
+	// Frames in flight and submitted work may still read it.
+	device_.release([device = device_.device, allocator = device_.allocator, image = image_, imageView = imageView_, sampler = sampler_, allocation = allocation_]() {
+		vkDestroySampler(device, sampler, nullptr);
+		vkDestroyImageView(device, imageView, nullptr);
+		vmaDestroyImage(allocator, image, allocation);
+	});
 }
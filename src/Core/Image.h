@@ -3,6 +3,9 @@
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 
+#include "Transition.h"
+#include "../Common/SubresourceStates.h"
+
 class Device;
 /**
  * @brief Bundle of image, image view, allocation, and sampler.
@@ -11,6 +14,10 @@ class Image
 {
 public:
 	Image(Device& device, const VkImageCreateInfo& imageInfo);
+	/**
+	 * @brief Bound at offset of memory owned by someone else, which outlives the image. Other images may alias it.
+	*/
+	Image(Device& device, const VkImageCreateInfo& imageInfo, VmaAllocation memory, VkDeviceSize offset);
 
 	void attachImageView(VkImageAspectFlags flags);
 	void attachImageView(const VkImageSubresourceRange& range);
@@ -30,35 +37,29 @@ public:
 
 	static uint32_t calculateMaxMiplevels(int width, int height);
 	/**
-	 * @brief Requires image to be in transfer destination.
+	 * @brief Requires every level to be in transfer destination, leaves them sampled. Untracked, for images that are not an Image.
 	*/
-	static void generateMipmaps(VkImage image, int width, int height, uint32_t mipLevels, VkCommandBuffer commandBuffer);
+	static void generateMipmaps(VkImage image, int width, int height, uint32_t mipLevels, VkCommandBuffer commandBuffer, uint32_t layerCount = 1);
 
 	/**
-	 * @brief Requires image to be in transfer destination
+	 * @brief generateMipmaps over every level and layer, a cubemap's faces are done together.
 	*/
-	static void generateCubemapMipmaps(VkImage image, int width, uint32_t mipLevels, VkCommandBuffer commandBuffer);
-
 	void generateMaxMipmaps(VkCommandBuffer commandBuffer);
-	void generateMaxCubeMipmaps(VkCommandBuffer commandBuffer);
 
-	// Transition function
-	void UndefinedToColorAttachment(VkCommandBuffer commandBuffer) const;
-	//void UndefinedToDepthStencilAttachment(VkCommandBuffer commandBuffer);
-	void UndefinedToTransferDestination(VkCommandBuffer commandBuffer) const;
-	void ColorAttachmentToTransferDestination(VkCommandBuffer commandBuffer) const;
-	//void TransferDestinationToPresentable(VkCommandBuffer commandBuffer);
-	//void TransferDestinationToShaderReadOptimal(VkCommandBuffer commandBuffer);
-	void ColorAttachmentToShaderReadOptimal(VkCommandBuffer commandBuffer) const;
-	//void ColorAttachmentToTransferSource(VkCommandBuffer commandBuffer);
-	//void ColorAttachmentToPresentable(VkCommandBuffer commandBuffer);
-	void ShaderReadOptimalToColorAttachment(VkCommandBuffer commandBuffer) const;
+	/**
+	 * @brief Moves every subresource to usage with one barrier per run of equal state. Use a BarrierBatch to share it with other images.
+	*/
+	void transition(VkCommandBuffer commandBuffer, ImageUsage usage);
+	/**
+	 * @brief Layout and last access per mip level and layer, as of the last recorded transition.
+	*/
+	SubresourceStates<ImageState>& getStates();
 
 	~Image();
 private:
 	VkImage image_{};
 	VkImageView imageView_{};
-	VmaAllocation allocation_{};
+	VmaAllocation allocation_{}; // Null when the memory is not the image's own.
 	VkSampler sampler_{};
 
 	VkFormat format_{};
@@ -66,6 +67,8 @@ private:
 	uint32_t mipLevels;
 	uint32_t arrayLevels;
 
+	SubresourceStates<ImageState> states_;
+
 	// For cleanup
 	Device& device_;
 };
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "ObjectRegistry.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <numeric>
+#include <spdlog/spdlog.h>
+#include <volk.h>
+
+size_t ObjectRegistry::KeyHash::operator()(const Key& key) const
+{
+	size_t result = key.size();
+	for (const auto word : key)
+	{
+		hash_combine(result, word);
+	}
+	return result;
+}
+
+void ObjectRegistry::init(VkDevice device)
+{
+	device_ = device;
+}
+
+void ObjectRegistry::deinit()
+{
+	std::scoped_lock lock(mutex_);
+	if (!modules_.keys.empty() || !setLayouts_.keys.empty())
+	{
+		SPDLOG_WARN("{} shader modules and {} set layouts were never released.", modules_.keys.size(), setLayouts_.keys.size());
+	}
+	for (const auto& [module, key] : modules_.keys)
+	{
+		vkDestroyShaderModule(device_, module, nullptr);
+	}
+	for (const auto& [layout, key] : setLayouts_.keys)
+	{
+		vkDestroyDescriptorSetLayout(device_, layout, nullptr);
+	}
+	modules_ = {};
+	setLayouts_ = {};
+}
+
+VkShaderModule ObjectRegistry::acquireShaderModule(std::span<const uint32_t> code)
+{
+	Key key(code.begin(), code.end());
+
+	std::scoped_lock lock(mutex_);
+	if (auto module = find(modules_, key))
+	{
+		return module;
+	}
+
+	VkShaderModuleCreateInfo moduleCI{};
+	moduleCI.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleCI.codeSize = code.size_bytes();
+	moduleCI.pCode = code.data();
+	VkShaderModule module;
+	check(vkCreateShaderModule(device_, &moduleCI, nullptr, &module), "Failed to create shader module!");
+	insert(modules_, std::move(key), module);
+	return module;
+}
+
+void ObjectRegistry::release(VkShaderModule module)
+{
+	std::scoped_lock lock(mutex_);
+	if (drop(modules_, module))
+	{
+		vkDestroyShaderModule(device_, module, nullptr);
+	}
+}
+
+VkDescriptorSetLayout ObjectRegistry::acquireSetLayout(std::span<const VkDescriptorSetLayoutBinding> bindings, std::span<const VkDescriptorBindingFlags> bindingFlags, VkDescriptorSetLayoutCreateFlags flags)
+{
+	check(bindingFlags.empty() || bindingFlags.size() == bindings.size(), "Binding flags must be given for every binding.");
+
+	// Binding order does not matter to Vulkan, so it does not matter to the key either.
+	std::vector<size_t> order(bindings.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bindings[a].binding < bindings[b].binding; });
+
+	Key key{ flags };
+	for (const auto i : order)
+	{
+		const auto& binding = bindings[i];
+		check(binding.pImmutableSamplers == nullptr, "Immutable samplers are not supported by the registry.");
+		key.insert(key.end(), {
+			binding.binding,
+			static_cast<uint32_t>(binding.descriptorType),
+			binding.descriptorCount,
+			binding.stageFlags,
+			bindingFlags.empty() ? 0u : bindingFlags[i]
+		});
+	}
+
+	std::scoped_lock lock(mutex_);
+	if (auto layout = find(setLayouts_, key))
+	{
+		return layout;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo setLayoutCIFlags{};
+	setLayoutCIFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	setLayoutCIFlags.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	setLayoutCIFlags.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo setLayoutCI{};
+	setLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutCI.pNext = bindingFlags.empty() ? nullptr : &setLayoutCIFlags;
+	setLayoutCI.flags = flags;
+	setLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+	setLayoutCI.pBindings = bindings.data();
+	VkDescriptorSetLayout layout;
+	check(vkCreateDescriptorSetLayout(device_, &setLayoutCI, nullptr, &layout));
+	insert(setLayouts_, std::move(key), layout);
+	return layout;
+}
+
+void ObjectRegistry::release(VkDescriptorSetLayout layout)
+{
+	std::scoped_lock lock(mutex_);
+	if (drop(setLayouts_, layout))
+	{
+		vkDestroyDescriptorSetLayout(device_, layout, nullptr);
+	}
+}
+
+std::vector<VkDescriptorPoolSize> ObjectRegistry::getPoolSizes(VkDescriptorSetLayout layout, VkDescriptorPoolCreateFlags* poolFlags) const
+{
+	std::scoped_lock lock(mutex_);
+	const auto keyIt = setLayouts_.keys.find(layout);
+	check(keyIt != setLayouts_.keys.end(), "Asked for the pool sizes of a set layout the registry does not own.");
+	const auto& key = keyIt->second;
+
+	// The key is the layout flags followed by binding, type, count, stages and binding flags for each binding.
+	std::vector<VkDescriptorPoolSize> sizes;
+	for (size_t i = 1; i + 4 < key.size(); i += 5)
+	{
+		const auto type = static_cast<VkDescriptorType>(key[i + 1]);
+		check(!(key[i + 4] & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT), "Variable count bindings have no fixed pool size.");
+		auto it = std::find_if(sizes.begin(), sizes.end(), [&](const VkDescriptorPoolSize& size) { return size.type == type; });
+		if (it == sizes.end())
+		{
+			sizes.push_back({ type, 0 });
+			it = sizes.end() - 1;
+		}
+		it->descriptorCount += key[i + 2];
+	}
+
+	if (poolFlags)
+	{
+		*poolFlags = (key[0] & VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT) ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+	}
+	return sizes;
+}
+
+ObjectRegistry::Stats ObjectRegistry::getStats() const
+{
+	std::scoped_lock lock(mutex_);
+	return { static_cast<uint32_t>(modules_.keys.size()), static_cast<uint32_t>(setLayouts_.keys.size()), reused_ };
+}
+
+template<typename Handle>
+Handle ObjectRegistry::find(Table<Handle>& table, const Key& key)
+{
+	if (auto it = table.entries.find(key); it != table.entries.end())
+	{
+		it->second.references++;
+		reused_++;
+		return it->second.handle;
+	}
+	return VK_NULL_HANDLE;
+}
+
+template<typename Handle>
+void ObjectRegistry::insert(Table<Handle>& table, Key&& key, Handle handle)
+{
+	table.keys.emplace(handle, key);
+	table.entries.emplace(std::move(key), Entry<Handle>{ handle, 1 });
+}
+
+template<typename Handle>
+bool ObjectRegistry::drop(Table<Handle>& table, Handle handle)
+{
+	if (handle == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+	const auto keyIt = table.keys.find(handle);
+	check(keyIt != table.keys.end(), "Released an object the registry does not own.");
+
+	const auto entryIt = table.entries.find(keyIt->second);
+	if (--entryIt->second.references > 0)
+	{
+		return false;
+	}
+	table.entries.erase(entryIt);
+	table.keys.erase(keyIt);
+	return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Shares shader modules and descriptor set layouts across the device. Objects are looked up by their contents
+ * (SPIR-V words, or flags and bindings), so asking twice for the same thing returns the same handle with one more reference.
+ * Every acquire is paired with a release, the object is destroyed when the last reference goes. Thread safe.
+*/
+class ObjectRegistry
+{
+public:
+	void init(VkDevice device);
+	/**
+	 * @brief Destroys whatever is still referenced and reports it.
+	*/
+	void deinit();
+
+	VkShaderModule acquireShaderModule(std::span<const uint32_t> code);
+	void release(VkShaderModule module);
+
+	/**
+	 * @param bindingFlags Empty, or one per binding.
+	*/
+	VkDescriptorSetLayout acquireSetLayout(std::span<const VkDescriptorSetLayoutBinding> bindings, std::span<const VkDescriptorBindingFlags> bindingFlags = {}, VkDescriptorSetLayoutCreateFlags flags = 0);
+	void release(VkDescriptorSetLayout layout);
+	/**
+	 * @brief Descriptors of each type one set of the layout holds, read back from its bindings.
+	 * @param poolFlags If not null, receives the flags a pool needs to allocate the layout.
+	*/
+	std::vector<VkDescriptorPoolSize> getPoolSizes(VkDescriptorSetLayout layout, VkDescriptorPoolCreateFlags* poolFlags = nullptr) const;
+
+	struct Stats
+	{
+		uint32_t shaderModules;
+		uint32_t setLayouts;
+		uint32_t reused; // Acquires served by an existing object.
+	};
+	Stats getStats() const;
+
+private:
+	using Key = std::vector<uint32_t>;
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	template<typename Handle>
+	struct Entry
+	{
+		Handle handle;
+		uint32_t references;
+	};
+
+	template<typename Handle>
+	struct Table
+	{
+		std::unordered_map<Key, Entry<Handle>, KeyHash> entries;
+		std::unordered_map<Handle, Key> keys;
+	};
+
+	// Returns the handle with its reference count bumped, or VK_NULL_HANDLE if it has to be created by the caller.
+	template<typename Handle>
+	Handle find(Table<Handle>& table, const Key& key);
+	template<typename Handle>
+	void insert(Table<Handle>& table, Key&& key, Handle handle);
+	// True when the last reference went away.
+	template<typename Handle>
+	bool drop(Table<Handle>& table, Handle handle);
+
+	VkDevice device_{};
+	mutable std::mutex mutex_;
+	Table<VkShaderModule> modules_;
+	Table<VkDescriptorSetLayout> setLayouts_;
+	uint32_t reused_ = 0;
+};
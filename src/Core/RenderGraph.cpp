@@ -0,0 +1,338 @@
+#include "RenderGraph.h"
+#include "Device.h"
+#include "Image.h"
+#include "Common.h"
+#include "../Common/MemoryAliasing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <spdlog/spdlog.h>
+#include <volk.h>
+
+namespace {
+	VkImageCreateInfo imageCI(const RenderGraph::ImageDesc& desc)
+	{
+		return CreateInfo::Image2DCI(desc.extent, desc.mipLevels, desc.format, desc.usage);
+	}
+
+	VkImageAspectFlags aspectOf(const RenderGraph::ImageDesc& desc)
+	{
+		return desc.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+
+	constexpr float toMiB(VkDeviceSize size)
+	{
+		return float(size) / (1024.f * 1024.f);
+	}
+}
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph& graph, uint32_t pass) : graph_(graph), pass_(pass)
+{
+}
+
+void RenderGraph::PassBuilder::read(Resource resource, ImageUsage usage)
+{
+	graph_.passes_[pass_].accesses.push_back({ resource, usage, false });
+}
+
+void RenderGraph::PassBuilder::write(Resource resource, ImageUsage usage)
+{
+	graph_.passes_[pass_].accesses.push_back({ resource, usage, true });
+}
+
+RenderGraph::RenderGraph(Device& device) : device_(device)
+{
+}
+
+RenderGraph::Resource RenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+{
+	ImageResource resource{};
+	resource.name = name;
+	resource.desc = desc;
+	resources_.push_back(std::move(resource));
+	compiled_ = false;
+	return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importImage(const std::string& name)
+{
+	ImageResource resource{};
+	resource.name = name;
+	resource.imported = true;
+	resources_.push_back(std::move(resource));
+	compiled_ = false;
+	return static_cast<Resource>(resources_.size() - 1);
+}
+
+void RenderGraph::setDesc(Resource resource, const ImageDesc& desc)
+{
+	auto& image = resources_[resource];
+	assert(!image.imported && "Imported images have no description.");
+	if (image.desc != desc)
+	{
+		image.desc = desc;
+		dirty_ = true;
+	}
+}
+
+void RenderGraph::addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, std::function<void(VkCommandBuffer)> record)
+{
+	passes_.push_back({ name, {}, std::move(record) });
+	PassBuilder builder(*this, static_cast<uint32_t>(passes_.size() - 1));
+	setup(builder);
+	compiled_ = false;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+	if (!compiled_)
+	{
+		compile();
+	}
+	if (dirty_)
+	{
+		retire();
+		allocate();
+		dirty_ = false;
+	}
+
+	for (uint32_t i = 0; i < passes_.size(); i++)
+	{
+		const auto& pass = passes_[i];
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		for (const auto& access : pass.accesses)
+		{
+			auto& resource = resources_[access.resource];
+			if (!resource.imported && resource.firstPass == i)
+			{
+				beginLifetime(resource);
+			}
+		}
+		for (const auto& access : pass.accesses)
+		{
+			const auto& resource = resources_[access.resource];
+			if (!resource.imported)
+			{
+				barriers_.transition(*resource.image, access.usage);
+			}
+		}
+		barriers_.flush(commandBuffer);
+
+		VkDebugUtilsLabelEXT label{};
+		label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+		label.pLabelName = pass.name.c_str();
+		vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+		pass.record(commandBuffer);
+		vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+	}
+}
+
+Image& RenderGraph::getImage(Resource resource) const
+{
+	assert(resources_[resource].image && "Image is not allocated, it is imported or no pass uses it.");
+	return *resources_[resource].image;
+}
+
+std::span<const VkImageView> RenderGraph::getMipViews(Resource resource) const
+{
+	return resources_[resource].mipViews;
+}
+
+RenderGraph::Stats RenderGraph::getStats() const
+{
+	const auto culled = std::count_if(passes_.begin(), passes_.end(), [](const Pass& pass) { return pass.culled; });
+	return { static_cast<uint32_t>(passes_.size()), static_cast<uint32_t>(culled), heapSize_, unaliasedSize_ };
+}
+
+RenderGraph::~RenderGraph()
+{
+	retire();
+}
+
+void RenderGraph::compile()
+{
+	// Walk back from what is visible outside the graph, a pass lives if something needed comes out of it.
+	std::vector<bool> needed(resources_.size());
+	for (size_t i = 0; i < resources_.size(); i++)
+	{
+		needed[i] = resources_[i].imported;
+	}
+	for (auto pass = passes_.rbegin(); pass != passes_.rend(); pass++)
+	{
+		pass->culled = std::none_of(pass->accesses.begin(), pass->accesses.end(), [&](const Access& access) {
+			return access.write && needed[access.resource];
+		});
+		if (pass->culled)
+		{
+			SPDLOG_INFO("Render graph culled pass {}, nothing uses what it writes.", pass->name);
+			continue;
+		}
+		// Earlier writers of what this writes stay too, the pass may build on their contents.
+		for (const auto& access : pass->accesses)
+		{
+			needed[access.resource] = true;
+		}
+	}
+
+	for (auto& resource : resources_)
+	{
+		resource.firstPass = UINT32_MAX;
+		resource.lastPass = 0;
+	}
+	for (uint32_t i = 0; i < passes_.size(); i++)
+	{
+		if (passes_[i].culled)
+		{
+			continue;
+		}
+		for (const auto& access : passes_[i].accesses)
+		{
+			auto& resource = resources_[access.resource];
+			resource.firstPass = std::min(resource.firstPass, i);
+			resource.lastPass = std::max(resource.lastPass, i);
+		}
+	}
+
+	compiled_ = true;
+	dirty_ = true;
+}
+
+void RenderGraph::allocate()
+{
+	std::vector<Resource> transients;
+	for (Resource i = 0; i < resources_.size(); i++)
+	{
+		if (!resources_[i].imported && resources_[i].firstPass != UINT32_MAX)
+		{
+			transients.push_back(i);
+		}
+	}
+	if (transients.empty())
+	{
+		heapSize_ = 0;
+		unaliasedSize_ = 0;
+		return;
+	}
+
+	// Sizes without creating anything, the heap has to exist before the images are bound to it.
+	std::vector<AliasRequest> requests;
+	uint32_t memoryTypeBits = ~0u;
+	VkDeviceSize alignment = 1;
+	unaliasedSize_ = 0;
+	for (const auto index : transients)
+	{
+		const auto& resource = resources_[index];
+		const VkImageCreateInfo createInfo = imageCI(resource.desc);
+		VkDeviceImageMemoryRequirements info{};
+		info.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+		info.pCreateInfo = &createInfo;
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		vkGetDeviceImageMemoryRequirements(device_.device, &info, &requirements);
+
+		const auto& memory = requirements.memoryRequirements;
+		requests.push_back({ memory.size, memory.alignment, resource.firstPass, resource.lastPass });
+		memoryTypeBits &= memory.memoryTypeBits;
+		alignment = std::max(alignment, memory.alignment);
+		unaliasedSize_ += memory.size;
+	}
+	check(memoryTypeBits != 0, "Transient images have no memory type in common.");
+
+	const AliasPlacement placement = placeAliased(requests);
+	heapSize_ = placement.size;
+
+	// From the pool, so resizing back and forth reuses heaps instead of allocating one per size.
+	VkMemoryRequirements heapRequirements{};
+	heapRequirements.size = placement.size;
+	heapRequirements.alignment = alignment;
+	heapRequirements.memoryTypeBits = memoryTypeBits;
+	heap_ = device_.transients.acquire(heapRequirements);
+
+	for (size_t i = 0; i < transients.size(); i++)
+	{
+		auto& resource = resources_[transients[i]];
+		resource.image = std::make_unique<Image>(device_, imageCI(resource.desc), heap_, placement.offsets[i]);
+		resource.image->attachImageView(resource.image->getFullRange(aspectOf(resource.desc)));
+		setName(device_.device, resource.image->get(), resource.name);
+
+		if (resource.desc.mipViews)
+		{
+			resource.mipViews.resize(resource.desc.mipLevels);
+			for (uint32_t mip = 0; mip < resource.desc.mipLevels; mip++)
+			{
+				VkImageViewCreateInfo imageViewCI{};
+				imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				imageViewCI.image = resource.image->get();
+				imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				imageViewCI.format = resource.desc.format;
+				imageViewCI.subresourceRange = { aspectOf(resource.desc), mip, 1, 0, 1 };
+				check(vkCreateImageView(device_.device, &imageViewCI, nullptr, &resource.mipViews[mip]));
+			}
+		}
+
+		// Whatever last touched this memory, in this frame if anything did before it, else in the previous one.
+		size_t before = i;
+		size_t wrapped = i;
+		bool found = false;
+		for (size_t j = 0; j < transients.size(); j++)
+		{
+			if (!placement.overlapsInMemory(requests, i, j))
+			{
+				continue;
+			}
+			if (requests[j].lastUse < requests[i].firstUse && (!found || requests[j].lastUse > requests[before].lastUse))
+			{
+				before = j;
+				found = true;
+			}
+			if (requests[j].lastUse > requests[wrapped].lastUse)
+			{
+				wrapped = j;
+			}
+		}
+		resource.predecessor = transients[found ? before : wrapped];
+	}
+
+	const auto stats = getStats();
+	SPDLOG_DEBUG("Render graph: {} of {} passes live, {} transient images in {:.1f} MiB, {:.1f} MiB without aliasing.",
+		stats.passes - stats.culledPasses, stats.passes, transients.size(), toMiB(heapSize_), toMiB(unaliasedSize_));
+}
+
+void RenderGraph::retire()
+{
+	device_.transients.release(heap_);
+	heap_ = VK_NULL_HANDLE;
+
+	for (auto& resource : resources_)
+	{
+		resource.image.reset();
+		if (!resource.mipViews.empty())
+		{
+			device_.release([device = device_.device, views = std::move(resource.mipViews)]() {
+				for (const auto view : views)
+				{
+					vkDestroyImageView(device, view, nullptr);
+				}
+			});
+			resource.mipViews.clear();
+		}
+	}
+}
+
+void RenderGraph::beginLifetime(ImageResource& resource)
+{
+	// The contents are not kept, but whoever used the memory last has to be done with it.
+	const auto& previous = resources_[resource.predecessor].image->getStates();
+	auto& states = resource.image->getStates();
+	ImageState state{};
+	previous.forEachRun(0, previous.getMipLevels(), 0, previous.getArrayLayers(),
+		[&](uint32_t, uint32_t, uint32_t, uint32_t, const ImageState& last) {
+			state.stages |= last.stages;
+			state.access |= last.access;
+		});
+	states.set(0, states.getMipLevels(), 0, states.getArrayLayers(), state);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Transition.h"
+
+class Device;
+class Image;
+
+/**
+ * @brief The passes of a frame and the images they use. Passes declare what they read and write, the graph drops passes
+ * nothing visible depends on, moves images to what each pass declared in one barrier per pass, and gives transient images
+ * memory from one heap, where images that are never alive in the same pass share memory. Heaps come from the device's TransientPool.
+ * Built once, executed every frame. Transients are reallocated when a description changes, the old ones are released to the device.
+*/
+class RenderGraph
+{
+public:
+	using Resource = uint32_t;
+
+	struct ImageDesc
+	{
+		VkExtent2D extent;
+		VkFormat format;
+		VkImageUsageFlags usage;
+		uint32_t mipLevels = 1;
+		bool mipViews = false; // A view of each mip level besides the full one.
+
+		bool operator==(const ImageDesc&) const = default;
+	};
+
+	class PassBuilder
+	{
+	public:
+		void read(Resource resource, ImageUsage usage);
+		void write(Resource resource, ImageUsage usage);
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, uint32_t pass);
+
+		RenderGraph& graph_;
+		const uint32_t pass_;
+	};
+
+	RenderGraph(Device& device);
+
+	Resource createImage(const std::string& name, const ImageDesc& desc);
+	/**
+	 * @brief An image owned elsewhere, such as the swapchain's. It is neither allocated nor transitioned,
+	 * and a pass writing it is never culled.
+	*/
+	Resource importImage(const std::string& name);
+	void setDesc(Resource resource, const ImageDesc& desc);
+
+	/**
+	 * @param record Called from execute with the frame's command buffer, after the pass's barriers.
+	*/
+	void addPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, std::function<void(VkCommandBuffer)> record);
+
+	/**
+	 * @brief Records every pass that is not culled, in the order they were added, into the frame's command buffer.
+	*/
+	void execute(VkCommandBuffer commandBuffer);
+
+	/**
+	 * @brief Only valid while the graph executes, the image may be replaced by the next execute.
+	*/
+	Image& getImage(Resource resource) const;
+	std::span<const VkImageView> getMipViews(Resource resource) const;
+
+	struct Stats
+	{
+		uint32_t passes;
+		uint32_t culledPasses;
+		VkDeviceSize heapSize;
+		VkDeviceSize unaliasedSize; // What the transients would take with memory of their own.
+	};
+	Stats getStats() const;
+
+	~RenderGraph();
+private:
+	struct Access
+	{
+		Resource resource;
+		ImageUsage usage;
+		bool write;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<Access> accesses;
+		std::function<void(VkCommandBuffer)> record;
+		bool culled = false;
+	};
+
+	struct ImageResource
+	{
+		std::string name;
+		ImageDesc desc{};
+		bool imported = false;
+
+		// Passes, inclusive. Meaningless for unused resources.
+		uint32_t firstPass = UINT32_MAX;
+		uint32_t lastPass = 0;
+		// Last to use the memory before this, which may be in the previous frame, or the image itself.
+		Resource predecessor = 0;
+
+		std::unique_ptr<Image> image;
+		std::vector<VkImageView> mipViews;
+	};
+
+	void compile();
+	void allocate();
+	/**
+	 * @brief Lets go of the transients, the device and the pool hold them back until frames in flight are done with them.
+	*/
+	void retire();
+	void beginLifetime(ImageResource& resource);
+
+	Device& device_;
+
+	std::vector<Pass> passes_;
+	std::vector<ImageResource> resources_;
+
+	bool compiled_ = false; // Culling and lifetimes, redone when a pass is added.
+	bool dirty_ = true; // Allocation, redone when a description changes.
+
+	VmaAllocation heap_{};
+	VkDeviceSize heapSize_ = 0;
+	VkDeviceSize unaliasedSize_ = 0;
+
+	BarrierBatch barriers_;
+};
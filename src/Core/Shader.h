@@ -1,36 +1,43 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
-#include <spirv_reflect.hpp>
-#include <string>
+#include <span>
 #include <vector>
 #include <map>
 #include <unordered_map>
 
-VkShaderModule loadShader(VkDevice device, const std::string& path);
+#include "EmbeddedShader.h"
+
+class Device;
+
+/**
+ * @brief The module is shared through the device registry, give it back with Device::registry.release.
+*/
+VkShaderModule loadShader(Device& device, const EmbeddedShader& shader);
 
 enum class BindingOption
 {
 	Dynamic
 };
 
+/**
+ * @brief Builds layouts and modules from the reflection tables generated at build time.
+*/
 class ShaderReflect
 {
 public:
-	void add(const std::string& path, VkShaderStageFlagBits stage, const std::map<std::pair<uint32_t, uint32_t>, BindingOption>& options = {});
+	void add(const EmbeddedShader& shader, const std::map<std::pair<uint32_t, uint32_t>, BindingOption>& options = {});
 
-	std::vector <std::pair<VkShaderStageFlagBits,VkShaderModule>> retrieveShaderModule(VkDevice device);
-	std::vector<VkDescriptorSetLayout> retrieveDescriptorSetLayout(VkDevice device);
-	VkDescriptorPool retrieveDescriptorPool(VkDevice device, uint32_t multipleOf = 1);
-	std::vector<VkDescriptorSet> retrieveSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout, uint32_t count = 1);
+	// Modules and set layouts come from the device registry and are released through it. Sets come from Device::descriptors.
+	std::vector <std::pair<VkShaderStageFlagBits,VkShaderModule>> retrieveShaderModule(Device& device);
+	std::vector<VkDescriptorSetLayout> retrieveDescriptorSetLayout(Device& device);
 	VkPipelineLayout retrievePipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout>& layouts) const;
 
 	static std::vector<VkPipelineShaderStageCreateInfo> getStages(const std::vector <std::pair<VkShaderStageFlagBits, VkShaderModule>>& modules);
-	static void deleteModules(VkDevice device, const std::vector <std::pair<VkShaderStageFlagBits, VkShaderModule>>& modules);
+	static void deleteModules(Device& device, const std::vector <std::pair<VkShaderStageFlagBits, VkShaderModule>>& modules);
 private:
-	std::vector <std::pair<VkShaderStageFlagBits, std::vector<char>> > codes;
+	std::vector <std::pair<VkShaderStageFlagBits, std::span<const uint32_t>> > codes;
 	std::unordered_map<uint32_t, std::unordered_map<uint32_t, std::pair<VkShaderStageFlags, VkDescriptorType>>> shaderUsage; // set, binding
-	std::unordered_map<VkDescriptorType, uint32_t> descriptorCount;
 	size_t pushConstantSize = 0; // there can only be one.
 	VkShaderStageFlags pushConstantFlag = 0;
 };
\ No newline at end of file
@@ -7,7 +7,8 @@
 #include "Transition.h"
 #include "Device.h"
 
-Swapchain::Swapchain(Device& device, VkFormat depthFormat): device_(device), depthFormat(depthFormat)
+Swapchain::Swapchain(Device& device, VkFormat depthFormat, VkPresentModeKHR presentMode):
+	device_(device), depthFormat(depthFormat), requestedPresentMode_(presentMode)
 {
 	graphics_ = device_.graphicsQueue.queue;
 	framesInFlight_ = device_.getMaxFramesInFlight();
@@ -23,8 +24,8 @@ Swapchain::Swapchain(Device& device, VkFormat depthFormat): device_(device), dep
 		FrameResource resource{};
 		resource.acquire = CreateInfo::createBinarySemaphore(device_.device);
 		resource.present = CreateInfo::createBinarySemaphore(device_.device);
-		resource.fence = CreateInfo::createFence(device_.device, VK_FENCE_CREATE_SIGNALED_BIT);
 		resource.commandBuffer = CreateInfo::allocateCommandBuffer(device_.device, commandPool_);
+		resource.splitCommandBuffer = CreateInfo::allocateCommandBuffer(device_.device, commandPool_);
 		frameResources_.emplace_back(resource);
 	}
 
@@ -33,31 +34,39 @@ Swapchain::Swapchain(Device& device, VkFormat depthFormat): device_(device), dep
 
 void Swapchain::Refresh()
 {
-	if (swapchain_)
-	{
-		vkDeviceWaitIdle(device_.device);
-	}
-
 	vkb::SwapchainBuilder swapchainBuilder(device_.physicalDevice, device_.device, device_.surface);
 	auto swapchainResult = swapchainBuilder
 		.set_desired_format({ .format = VK_FORMAT_R8G8B8A8_SRGB, .colorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR })
-		.set_desired_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)
+		.set_desired_present_mode(requestedPresentMode_)
 		.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
 		.set_old_swapchain(swapchain_)
 		.build();
 	
 	check(swapchainResult);
 
-	vkDestroySwapchainKHR(device_.device, swapchain_, nullptr);
+	// Frames in flight may still render into or present the old images, they go once those frames have retired.
+	if (swapchain_)
+	{
+		device_.release([&device = device_, swapchain = swapchain_, imageViews = std::move(imageViews_),
+			depthImage = depthImage_, depthImageView = depthImageView_, depthAllocation = depthAllocation_]() {
+			for (const auto& imageView : imageViews)
+			{
+				vkDestroyImageView(device.device, imageView, nullptr);
+			}
+			vkDestroyImageView(device.device, depthImageView, nullptr);
+			vkDestroyImage(device.device, depthImage, nullptr);
+			device.transients.release(depthAllocation);
+			vkDestroySwapchainKHR(device.device, swapchain, nullptr);
+		});
+	}
 
 	vkb::Swapchain& swapchain = swapchainResult.value();
 	imageFormat = swapchain.image_format;
 	colorSpace = swapchain.color_space;
 	presentMode = swapchain.present_mode;
-
-	for (const auto& imageView : imageViews_)
+	if (presentMode != requestedPresentMode_)
 	{
-		vkDestroyImageView(device_.device, imageView, nullptr);
+		SPDLOG_WARN("Requested present mode {} is unsupported, using {}.", static_cast<int>(requestedPresentMode_), static_cast<int>(presentMode));
 	}
 
 	swapchain_ = swapchain.swapchain;
@@ -68,30 +77,32 @@ void Swapchain::Refresh()
 	surfaceExtent_ = swapchain.extent;
 
 	// Setup depth images if requested.
+	depthImage_ = VK_NULL_HANDLE;
+	depthImageView_ = VK_NULL_HANDLE;
+	depthAllocation_ = VK_NULL_HANDLE;
 	if (depthFormat != VK_FORMAT_UNDEFINED)
 	{
-		if (depthImage_)
-		{
-			vkDestroyImageView(device_.device, depthImageView_, nullptr);
-			vmaDestroyImage(device_.allocator, depthImage_, depthAllocation_);
-		}
-
 		VkImageCreateInfo imageCI{};
 		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageCI.imageType = VK_IMAGE_TYPE_2D;
 		imageCI.extent = { surfaceExtent_.width, surfaceExtent_.height, 1 };
 		imageCI.format = depthFormat;
 		imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		// The final pass samples it for the grid, where the format allows.
+		if (device_.supportsFormat(depthFormat, VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_BIT))
+		{
+			imageCI.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
 		imageCI.mipLevels = 1;
 		imageCI.arrayLayers = 1;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 
-		VmaAllocationCreateInfo allocationCI{};
-		allocationCI.usage = VMA_MEMORY_USAGE_AUTO;
-		
-		check(vmaCreateImage(device_.allocator, &imageCI, &allocationCI, &depthImage_, &depthAllocation_, nullptr));
+		// Pooled, a resize within the same size bucket or back to an earlier size allocates nothing.
+		depthAllocation_ = device_.transients.acquire(imageCI);
+		check(vkCreateImage(device_.device, &imageCI, nullptr, &depthImage_));
+		check(vmaBindImageMemory(device_.allocator, depthAllocation_, depthImage_));
 
 		VkImageViewCreateInfo imageViewCI{};
 		imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -101,64 +112,100 @@ void Swapchain::Refresh()
 		imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
 		check(vkCreateImageView(device_.device, &imageViewCI, nullptr, &depthImageView_));
 
-		CreateInfo::performOneTimeAction(device_.device, device_.graphicsQueue.queue, device_.graphicsPool, [&](VkCommandBuffer commandBuffer) {
-			Transition::UndefinedToDepthStencilAttachment(depthImage_, commandBuffer);
-		});
+		// Moved to its layout by the next frame's command buffer rather than a submission of its own.
+		depthUndefined_ = true;
 	}
 }
 
-VkCommandBuffer Swapchain::acquire(int width, int height)
+VkCommandBuffer Swapchain::acquire(int width, int height, Bench::TimePoint inputTime)
 {
-	if (width != surfaceExtent_.width || height != surfaceExtent_.height)
+	if (refreshRequested_ || width != surfaceExtent_.width || height != surfaceExtent_.height)
 	{
+		refreshRequested_ = false;
 		Refresh();
 	}
 
-	const auto& resource = frameResources_[currentFrame_];
-	vkWaitForFences(device_.device, 1, &resource.fence, VK_TRUE, UINT64_MAX);
+	auto& resource = frameResources_[currentFrame_];
+	const auto waitStart = Bench::record();
+	device_.wait(resource.rendered);
+	const auto waitEnd = Bench::record();
+	device_.beginFrame(currentFrame_);
 	
+	const auto acquireStart = Bench::record();
 	VkResult result = vkAcquireNextImageKHR(device_.device, swapchain_, UINT64_MAX, resource.acquire, nullptr, &imageIndex_);
-	while (true)
+	while (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
-		if (result != VK_ERROR_OUT_OF_DATE_KHR)
-		{
-			check(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failed to acquire swapchain image!");
-			break;
-		}
+		// A failed acquire leaves the semaphore unsignaled, so it is reused on the new swapchain.
 		Refresh();
 		SPDLOG_INFO("Recreated swapchain at acquire!");
-	} 
-	vkResetFences(device_.device, 1, &resource.fence);
+		result = vkAcquireNextImageKHR(device_.device, swapchain_, UINT64_MAX, resource.acquire, nullptr, &imageIndex_);
+	}
+	check(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failed to acquire swapchain image!");
+	const auto acquireEnd = Bench::record();
+
+	timings_.frameWaitMs = Bench::diff<float>(waitStart, waitEnd);
+	timings_.acquireMs = Bench::diff<float>(acquireStart, acquireEnd);
+	if (resource.inputTime != Bench::TimePoint{})
+	{
+		timings_.latencyMs = Bench::diff<float>(resource.inputTime, waitEnd);
+	}
+	resource.inputTime = inputTime;
 
 	check(vkResetCommandBuffer(resource.commandBuffer, 0));
+	resource.split = false;
 
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 	check(vkBeginCommandBuffer(resource.commandBuffer, &beginInfo));
 
+	if (depthUndefined_)
+	{
+		Transition::UndefinedToDepthStencilAttachment(depthImage_, resource.commandBuffer, depthFormat);
+		depthUndefined_ = false;
+	}
+
 	return resource.commandBuffer;
 }
 
-void Swapchain::present()
+std::pair<Device::Ticket, VkCommandBuffer> Swapchain::split()
 {
-	const auto& resource = frameResources_[currentFrame_];
+	auto& resource = frameResources_[currentFrame_];
+	check(!resource.split, "The frame is already split!");
 
 	check(vkEndCommandBuffer(resource.commandBuffer));
+	// Only uploads are waited on, what the compute queue does meanwhile may depend on this.
+	const auto asyncWork = device_.getAsyncTickets();
+	const Device::Ticket ticket = device_.submit(device_.graphicsQueue, resource.commandBuffer, { &asyncWork[0], 1 });
 
-	VkSubmitInfo submitInfo{};
-	VkSemaphore wait[] = { resource.acquire };
-	VkPipelineStageFlags waitAt[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = wait;
-	submitInfo.pWaitDstStageMask = waitAt;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &resource.commandBuffer;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &resource.present;
+	check(vkResetCommandBuffer(resource.splitCommandBuffer, 0));
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	check(vkBeginCommandBuffer(resource.splitCommandBuffer, &beginInfo));
+	resource.split = true;
+	return { ticket, resource.splitCommandBuffer };
+}
 
-	check(vkQueueSubmit(graphics_, 1, &submitInfo, resource.fence));
+void Swapchain::present()
+{
+	auto& resource = frameResources_[currentFrame_];
+	const VkCommandBuffer commandBuffer = resource.split ? resource.splitCommandBuffer : resource.commandBuffer;
+
+	check(vkEndCommandBuffer(commandBuffer));
+
+	// Presentation only takes binary semaphores.
+	VkSemaphoreSubmitInfo acquired{};
+	acquired.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	acquired.semaphore = resource.acquire;
+	acquired.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkSemaphoreSubmitInfo presentable{};
+	presentable.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	presentable.semaphore = resource.present;
+	presentable.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+	const auto asyncWork = device_.getAsyncTickets();
+	resource.rendered = device_.submit(device_.graphicsQueue, commandBuffer, asyncWork, { &acquired, 1 }, { &presentable, 1 });
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -192,6 +239,11 @@ VkImageView Swapchain::getCurrentImageView() const
 	return imageViews_[imageIndex_];
 }
 
+VkImage Swapchain::getDepthImage() const
+{
+	return depthImage_;
+}
+
 VkImageView Swapchain::getDepthImageView() const
 {
 	return depthImageView_;
@@ -207,15 +259,35 @@ VkFormat Swapchain::getFormat() const
 	return imageFormat;
 }
 
+void Swapchain::setPresentMode(VkPresentModeKHR presentMode)
+{
+	if (presentMode == requestedPresentMode_)
+	{
+		return;
+	}
+	requestedPresentMode_ = presentMode;
+	refreshRequested_ = true;
+}
+
+VkPresentModeKHR Swapchain::getPresentMode() const
+{
+	return presentMode;
+}
+
+Swapchain::Timings Swapchain::getTimings() const
+{
+	return timings_;
+}
+
 
 Swapchain::~Swapchain()
 {
 	vkDestroyImageView(device_.device, depthImageView_, nullptr);
-	vmaDestroyImage(device_.allocator, depthImage_, depthAllocation_);
+	vkDestroyImage(device_.device, depthImage_, nullptr);
+	device_.transients.release(depthAllocation_);
 	//
 	for (const auto& resource : frameResources_)
 	{
-		vkDestroyFence(device_.device, resource.fence, nullptr);
 		vkDestroySemaphore(device_.device, resource.acquire, nullptr);
 		vkDestroySemaphore(device_.device, resource.present, nullptr);
 	}
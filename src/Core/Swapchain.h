@@ -5,8 +5,10 @@
 
 #include <vector>
 #include <array>
+#include <utility>
 
-class Device;
+#include "../Common/Bench.h"
+#include "Device.h"
 
 /**
  * @brief Swapchain abstraction.
@@ -17,25 +19,56 @@ public:
 	/**
 	 * @brief Setup swapchain and its dependencies.
 	*/
-	Swapchain(Device& device, VkFormat depthFormat = VK_FORMAT_UNDEFINED);
+	Swapchain(Device& device, VkFormat depthFormat = VK_FORMAT_UNDEFINED, VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR);
 
 	/**
 	 * @brief Acquire an image and updates the internal image index.
+	 * @param inputTime When the input the frame reacts to was sampled, for the latency estimate.
 	 * @return A command buffer that has begin recording.
 	*/
-	VkCommandBuffer acquire(int width, int height);
+	VkCommandBuffer acquire(int width, int height, Bench::TimePoint inputTime = Bench::record());
 
 	/**
-	 * @brief Submits the frame command buffer and presents the corresponding image index
+	 * @brief Submits the frame command buffer, or its second half once split, and presents the corresponding image index.
+	 * The submission waits on the latest transfer and compute work, so what it uploaded or computed is ready.
 	*/
 	void present();
+	/**
+	 * @brief Submits what the frame recorded so far, without the acquired image or compute work, and continues the frame
+	 * in another command buffer that present submits. At most once per frame.
+	 * @return The submission, for work on other queues that depends on it, and the command buffer to record the rest into.
+	*/
+	std::pair<Device::Ticket, VkCommandBuffer> split();
 
 	VkImage getCurrentImage() const;
 	VkImageView getCurrentImageView() const;
+	VkImage getDepthImage() const;
 	VkImageView getDepthImageView() const;
 	VkExtent2D getExtent() const;
 	VkFormat getFormat() const;
 
+	/**
+	 * @brief Takes effect at the next acquire, which recreates the swapchain. Falls back to FIFO when the surface lacks the mode.
+	*/
+	void setPresentMode(VkPresentModeKHR presentMode);
+	/**
+	 * @return The mode in use, which may differ from the one requested.
+	*/
+	VkPresentModeKHR getPresentMode() const;
+
+	struct Timings
+	{
+		float frameWaitMs; // CPU blocked on the frame's last submission, the GPU is the bottleneck when this is high.
+		float acquireMs; // CPU blocked in vkAcquireNextImageKHR, the presentation engine is when this is high.
+		// From input to the GPU finishing the frame that used it, taken when the frame is next waited on so an upper bound
+		// of that. Presentation adds up to a refresh interval on top for MAILBOX and more for a full FIFO queue.
+		float latencyMs;
+	};
+	/**
+	 * @return Of the most recent acquire.
+	*/
+	Timings getTimings() const;
+
 	~Swapchain();
 private:
 	VkSwapchainKHR swapchain_{};
@@ -44,15 +77,22 @@ private:
 	VkFormat imageFormat;
 	VkColorSpaceKHR colorSpace;
 	VkPresentModeKHR presentMode;
+	VkPresentModeKHR requestedPresentMode_;
+	bool refreshRequested_ = false;
 
 	// If requesting for depth image, set this to desired depth format
 	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
 	VkImage depthImage_{};
 	VkImageView depthImageView_{};
 	VmaAllocation depthAllocation_{};
+	bool depthUndefined_ = false; // Created since the last acquire.
 
 	uint32_t imageIndex_ = 0;
 
+	/**
+	 * @brief Builds a new swapchain from the old one without waiting for the GPU. The old one, its views and depth image
+	 * are released to the device once the frames that may use them have retired.
+	*/
 	void Refresh();
 
 	VkFormat surfaceFormat_{};
@@ -60,9 +100,12 @@ private:
 
 	struct FrameResource {
 		VkCommandBuffer commandBuffer;
+		VkCommandBuffer splitCommandBuffer; // The rest of the frame once split.
+		bool split;
 		VkSemaphore acquire;
 		VkSemaphore present;
-		VkFence fence;
+		Device::Ticket rendered; // Waited on before the resource is recorded again.
+		Bench::TimePoint inputTime; // Of the last frame recorded with this resource, unset until then.
 	};
 	uint32_t framesInFlight_; // Ask from device.
 	std::vector<FrameResource> frameResources_;
@@ -70,6 +113,8 @@ private:
 	VkCommandPool commandPool_{};
 	VkQueue graphics_{};
 
+	Timings timings_{};
+
 	// Stored for easier recreation of swapchain.
 	Device& device_;
 };
\ No newline at end of file
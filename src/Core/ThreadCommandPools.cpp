@@ -0,0 +1,75 @@
+#include "ThreadCommandPools.h"
+#include "Device.h"
+#include "Common.h"
+
+#include <BS_thread_pool.hpp>
+
+ThreadCommandPools::ThreadCommandPools(Device& device, uint32_t threadCount, uint32_t framesInFlight): device_(device)
+{
+	pools_.resize(framesInFlight);
+	for (auto& frame : pools_)
+	{
+		frame.resize(threadCount + 1);
+		for (auto& thread : frame)
+		{
+			thread.pool = CreateInfo::createCommandPool(device_.device, device_.graphicsQueue.family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			thread.used = 0;
+		}
+	}
+}
+
+void ThreadCommandPools::reset(uint32_t frame)
+{
+	for (auto& thread : pools_[frame])
+	{
+		check(vkResetCommandPool(device_.device, thread.pool, 0));
+		thread.used = 0;
+	}
+}
+
+VkCommandBuffer ThreadCommandPools::begin(uint32_t frame, const VkCommandBufferInheritanceRenderingInfo* rendering)
+{
+	// Workers are numbered from 0, the main thread has no index.
+	const auto workerIndex = BS::this_thread::get_index();
+	auto& thread = pools_[frame][workerIndex ? *workerIndex + 1 : 0];
+
+	if (thread.used == thread.buffers.size())
+	{
+		VkCommandBuffer commandBuffer;
+		VkCommandBufferAllocateInfo allocateInfo{};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocateInfo.commandPool = thread.pool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocateInfo.commandBufferCount = 1;
+		check(vkAllocateCommandBuffers(device_.device, &allocateInfo, &commandBuffer));
+		thread.buffers.push_back(commandBuffer);
+	}
+	VkCommandBuffer commandBuffer = thread.buffers[thread.used++];
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext = rendering;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (rendering)
+	{
+		beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	}
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	check(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+	return commandBuffer;
+}
+
+ThreadCommandPools::~ThreadCommandPools()
+{
+	for (const auto& frame : pools_)
+	{
+		for (const auto& thread : frame)
+		{
+			vkDestroyCommandPool(device_.device, thread.pool, nullptr);
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+class Device;
+
+/**
+ * @brief One graphics command pool per worker thread and frame in flight, handing out secondary command buffers.
+*/
+class ThreadCommandPools
+{
+public:
+	/**
+	 * @param threadCount Number of worker threads. An extra pool is kept for the calling (main) thread.
+	*/
+	ThreadCommandPools(Device& device, uint32_t threadCount, uint32_t framesInFlight);
+
+	/**
+	 * @brief Resets every pool of the frame. The frame's fence must have been waited on.
+	*/
+	void reset(uint32_t frame);
+
+	/**
+	 * @brief Begins a secondary command buffer from the calling thread's pool.
+	 * @param rendering If not null, the buffer continues a dynamic rendering scope with these formats.
+	*/
+	VkCommandBuffer begin(uint32_t frame, const VkCommandBufferInheritanceRenderingInfo* rendering = nullptr);
+
+	~ThreadCommandPools();
+private:
+	struct ThreadPool
+	{
+		VkCommandPool pool;
+		std::vector<VkCommandBuffer> buffers;
+		uint32_t used;
+	};
+	// Index [frame][thread]
+	std::vector<std::vector<ThreadPool>> pools_;
+
+	Device& device_;
+};
@@ -0,0 +1,143 @@
+#include "TransientPool.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <bit>
+#include <volk.h>
+
+namespace {
+	// Four buckets per power of two, but never finer than minimum. A window dragged by a few pixels stays in its bucket.
+	template<typename T>
+	T roundUpToBucket(T size, T minimum)
+	{
+		if (size <= minimum)
+		{
+			return minimum;
+		}
+		const T step = std::max(minimum, T(std::bit_floor(size) / 4));
+		return (size + step - 1) / step * step;
+	}
+
+	VkMemoryRequirements getRequirements(VkDevice device, const VkImageCreateInfo& imageInfo)
+	{
+		VkDeviceImageMemoryRequirements info{};
+		info.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+		info.pCreateInfo = &imageInfo;
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		vkGetDeviceImageMemoryRequirements(device, &info, &requirements);
+		return requirements.memoryRequirements;
+	}
+}
+
+size_t TransientPool::KeyHash::operator()(const Key& key) const
+{
+	size_t result = 0;
+	hash_combine(result, static_cast<uint32_t>(key.format));
+	hash_combine(result, key.usage);
+	hash_combine(result, key.mipLevels);
+	hash_combine(result, key.arrayLayers);
+	hash_combine(result, key.memoryTypeBits);
+	hash_combine(result, key.alignment);
+	return result;
+}
+
+void TransientPool::init(VkDevice device, VmaAllocator allocator, uint32_t framesInFlight, uint32_t maxUnusedFrames)
+{
+	device_ = device;
+	allocator_ = allocator;
+	cache_ = std::make_unique<BlockCache<Key, VmaAllocation, KeyHash>>(framesInFlight, maxUnusedFrames);
+}
+
+void TransientPool::deinit()
+{
+	if (!cache_)
+	{
+		return;
+	}
+	cache_->clear([&](VmaAllocation memory) {
+		vmaFreeMemory(allocator_, memory);
+		owned_.erase(memory);
+	});
+	// Whatever is still acquired has an owner that outlived the device, free it anyway.
+	for (const auto& [memory, owned] : owned_)
+	{
+		vmaFreeMemory(allocator_, memory);
+	}
+	owned_.clear();
+	cache_.reset();
+	bytes_ = 0;
+}
+
+VmaAllocation TransientPool::acquire(const VkImageCreateInfo& imageInfo)
+{
+	constexpr uint32_t minimumExtent = 64;
+	VkImageCreateInfo bucketInfo = imageInfo;
+	bucketInfo.extent.width = roundUpToBucket(imageInfo.extent.width, minimumExtent);
+	bucketInfo.extent.height = roundUpToBucket(imageInfo.extent.height, minimumExtent);
+
+	const VkMemoryRequirements requirements = getRequirements(device_, imageInfo);
+	const VkMemoryRequirements bucketRequirements = getRequirements(device_, bucketInfo);
+	const Key key{ imageInfo.format, imageInfo.usage, imageInfo.mipLevels, imageInfo.arrayLayers, requirements.memoryTypeBits, requirements.alignment };
+	return acquire(key, requirements.size, std::max(requirements.size, bucketRequirements.size));
+}
+
+VmaAllocation TransientPool::acquire(const VkMemoryRequirements& requirements)
+{
+	constexpr VkDeviceSize minimumSize = 1ull << 20;
+	const Key key{ VK_FORMAT_UNDEFINED, 0, 0, 0, requirements.memoryTypeBits, requirements.alignment };
+	return acquire(key, requirements.size, roundUpToBucket(requirements.size, minimumSize));
+}
+
+void TransientPool::release(VmaAllocation memory)
+{
+	if (!memory)
+	{
+		return;
+	}
+	const auto& owned = owned_.at(memory);
+	cache_->release(owned.key, owned.size, memory);
+}
+
+void TransientPool::beginFrame(uint32_t frame)
+{
+	cache_->beginFrame(frame, [&](VmaAllocation memory) {
+		bytes_ -= owned_.at(memory).size;
+		owned_.erase(memory);
+		vmaFreeMemory(allocator_, memory);
+	});
+}
+
+TransientPool::Stats TransientPool::getStats() const
+{
+	return { allocations_, reused_, static_cast<uint32_t>(cache_ ? cache_->getFreeCount() : 0), bytes_ };
+}
+
+TransientPool::~TransientPool()
+{
+	deinit();
+}
+
+VmaAllocation TransientPool::acquire(const Key& key, VkDeviceSize size, VkDeviceSize bucketSize)
+{
+	if (const auto memory = cache_->acquire(key, size))
+	{
+		reused_++;
+		return *memory;
+	}
+
+	VkMemoryRequirements requirements{};
+	requirements.size = bucketSize;
+	requirements.alignment = key.alignment;
+	requirements.memoryTypeBits = key.memoryTypeBits;
+	VmaAllocationCreateInfo allocCI{};
+	allocCI.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	VmaAllocation memory;
+	check(vmaAllocateMemory(allocator_, &requirements, &allocCI, &memory, nullptr));
+	vmaSetAllocationName(allocator_, memory, "Transient");
+	owned_.emplace(memory, Owned{ key, bucketSize });
+	allocations_++;
+	bytes_ += bucketSize;
+	return memory;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "../Common/BlockCache.h"
+
+/**
+ * @brief Device memory for render targets that come and go with the window size. Memory is sized for a bucket of extents
+ * rather than the exact one, and released memory is kept for the next request of the same format, usage and bucket,
+ * so resizing a window reuses what earlier sizes left behind instead of allocating every frame.
+ * Memory unused for maxUnusedFrames frames is freed. Images are created by the caller and bound to what this hands out.
+*/
+class TransientPool
+{
+public:
+	void init(VkDevice device, VmaAllocator allocator, uint32_t framesInFlight, uint32_t maxUnusedFrames = 120);
+	void deinit();
+
+	/**
+	 * @return Memory for an image created with imageInfo, bind it at offset 0.
+	*/
+	VmaAllocation acquire(const VkImageCreateInfo& imageInfo);
+	/**
+	 * @brief For memory shared by several images, such as an aliasing heap.
+	*/
+	VmaAllocation acquire(const VkMemoryRequirements& requirements);
+	/**
+	 * @brief Images bound to memory may still be in use by frames in flight, it is handed out again once they have retired.
+	*/
+	void release(VmaAllocation memory);
+
+	/**
+	 * @brief Call once the frame's fence has been waited on.
+	*/
+	void beginFrame(uint32_t frame);
+
+	struct Stats
+	{
+		uint32_t allocations; // From VMA, over the pool's lifetime.
+		uint32_t reused;
+		uint32_t free; // Kept, ready to be handed out.
+		VkDeviceSize bytes; // Held by the pool, in use or not.
+	};
+	Stats getStats() const;
+
+	~TransientPool();
+private:
+	struct Key
+	{
+		VkFormat format; // Undefined for shared memory.
+		VkImageUsageFlags usage;
+		uint32_t mipLevels;
+		uint32_t arrayLayers;
+		uint32_t memoryTypeBits;
+		VkDeviceSize alignment;
+
+		bool operator==(const Key&) const = default;
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+	struct Owned
+	{
+		Key key;
+		VkDeviceSize size;
+	};
+
+	/**
+	 * @param size What the request needs.
+	 * @param bucketSize What is allocated when nothing is free, at least size.
+	*/
+	VmaAllocation acquire(const Key& key, VkDeviceSize size, VkDeviceSize bucketSize);
+
+	VkDevice device_{};
+	VmaAllocator allocator_{};
+
+	std::unique_ptr<BlockCache<Key, VmaAllocation, KeyHash>> cache_;
+	std::unordered_map<VmaAllocation, Owned> owned_;
+	uint32_t allocations_ = 0;
+	uint32_t reused_ = 0;
+	VkDeviceSize bytes_ = 0;
+};
@@ -1,250 +1,212 @@
 #include "Transition.h"
+#include "Image.h"
 
 #include <volk.h>
 
-void Transition::UndefinedToColorAttachment(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
+namespace {
+	constexpr VkAccessFlags2 writeAccess =
+		VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_TRANSFER_WRITE_BIT |
+		VK_ACCESS_2_SHADER_WRITE_BIT |
+		VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+	constexpr VkImageSubresourceRange colorRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	void transitionOnce(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range, ImageUsage from, ImageUsage to)
+	{
+		BarrierBatch batch;
+		batch.transition(image, range, from, to);
+		batch.flush(commandBuffer);
+	}
+}
+
+VkImageAspectFlags getDepthAspect(VkFormat format)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
-	imageBarrier.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange = range;
+	switch (format)
+	{
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	case VK_FORMAT_S8_UINT:
+		return VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	}
+}
 
-	VkDependencyInfo dependency{};
-	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	dependency.imageMemoryBarrierCount = 1;
-	dependency.pImageMemoryBarriers = &imageBarrier;
+ImageState getImageState(ImageUsage usage)
+{
+	switch (usage)
+	{
+	case ImageUsage::Undefined:
+		return {};
+	case ImageUsage::ColorAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT };
+	case ImageUsage::DepthStencilAttachment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+	case ImageUsage::Sampled:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT };
+	case ImageUsage::ComputeSampled:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT };
+	case ImageUsage::Storage:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+	case ImageUsage::TransferSource:
+		return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT };
+	case ImageUsage::TransferDestination:
+		return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT };
+	case ImageUsage::Present:
+		return { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE };
+	}
+	return {};
+}
 
-	vkCmdPipelineBarrier2KHR(commandBuffer, &dependency);
+void BarrierBatch::transition(Image& image, ImageUsage usage)
+{
+	const auto aspect = usage == ImageUsage::DepthStencilAttachment ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	transition(image, image.getFullRange(aspect), usage);
 }
 
-void Transition::UndefinedToDepthStencilAttachment(VkImage image, VkCommandBuffer commandBuffer)
+void BarrierBatch::transition(Image& image, const VkImageSubresourceRange& range, ImageUsage usage)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
-	imageBarrier.dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-	imageBarrier.subresourceRange.baseMipLevel = 0;
-	imageBarrier.subresourceRange.baseArrayLayer = 0;
-	imageBarrier.subresourceRange.levelCount = 1;
-	imageBarrier.subresourceRange.layerCount = 1;
+	const ImageState to = getImageState(usage);
+	auto& states = image.getStates();
+	const uint32_t levelCount = range.levelCount == VK_REMAINING_MIP_LEVELS ? states.getMipLevels() - range.baseMipLevel : range.levelCount;
+	const uint32_t layerCount = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? states.getArrayLayers() - range.baseArrayLayer : range.layerCount;
+
+	states.forEachRun(range.baseMipLevel, levelCount, range.baseArrayLayer, layerCount,
+		[&](uint32_t baseMip, uint32_t mips, uint32_t baseLayer, uint32_t layers, const ImageState& from) {
+			add(image.get(), { range.aspectMask, baseMip, mips, baseLayer, layers }, from, to);
+		});
+	states.set(range.baseMipLevel, levelCount, range.baseArrayLayer, layerCount, to);
+}
 
-	VkDependencyInfo dependency{};
-	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	dependency.imageMemoryBarrierCount = 1;
-	dependency.pImageMemoryBarriers = &imageBarrier;
+void BarrierBatch::transition(VkImage image, const VkImageSubresourceRange& range, ImageUsage from, ImageUsage to)
+{
+	add(image, range, getImageState(from), getImageState(to));
+}
 
-	vkCmdPipelineBarrier2KHR(commandBuffer, &dependency);
+void BarrierBatch::handOver(Image& image)
+{
+	auto& states = image.getStates();
+	std::vector<std::pair<VkImageSubresourceRange, ImageState>> runs;
+	states.forEachRun(0, states.getMipLevels(), 0, states.getArrayLayers(),
+		[&](uint32_t baseMip, uint32_t mips, uint32_t baseLayer, uint32_t layers, const ImageState& state) {
+			// Stages of the other queue mean nothing here, the next barrier chains with the semaphore wait instead.
+			runs.push_back({ { 0, baseMip, mips, baseLayer, layers }, { state.layout, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE } });
+		});
+	for (const auto& [range, state] : runs)
+	{
+		states.set(range.baseMipLevel, range.levelCount, range.baseArrayLayer, range.layerCount, state);
+	}
 }
 
-void Transition::UndefinedToTransferDestination(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
+void BarrierBatch::memory(VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
-	imageBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;	
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange = range;
+	VkMemoryBarrier2 memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	memoryBarrier.srcStageMask = srcStages;
+	memoryBarrier.srcAccessMask = srcAccess;
+	memoryBarrier.dstStageMask = dstStages;
+	memoryBarrier.dstAccessMask = dstAccess;
+	memoryBarriers_.push_back(memoryBarrier);
+}
+
+void BarrierBatch::flush(VkCommandBuffer commandBuffer)
+{
+	if (empty())
+	{
+		return;
+	}
 
 	VkDependencyInfo dependency{};
 	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	dependency.imageMemoryBarrierCount = 1;
-	dependency.pImageMemoryBarriers = &imageBarrier;
+	dependency.memoryBarrierCount = static_cast<uint32_t>(memoryBarriers_.size());
+	dependency.pMemoryBarriers = memoryBarriers_.data();
+	dependency.imageMemoryBarrierCount = static_cast<uint32_t>(barriers_.size());
+	dependency.pImageMemoryBarriers = barriers_.data();
+	vkCmdPipelineBarrier2(commandBuffer, &dependency);
+	barriers_.clear();
+	memoryBarriers_.clear();
+}
 
-	vkCmdPipelineBarrier2KHR(commandBuffer, &dependency);
+bool BarrierBatch::empty() const
+{
+	return barriers_.empty() && memoryBarriers_.empty();
 }
 
-void Transition::ColorAttachmentToTransferDestination(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
+void BarrierBatch::add(VkImage image, const VkImageSubresourceRange& range, const ImageState& from, const ImageState& to)
 {
+	// Reads after reads in the same layout need nothing, anything after a write does.
+	if (from == to && !(from.access & writeAccess))
+	{
+		return;
+	}
+
 	VkImageMemoryBarrier2 imageBarrier{};
 	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-	imageBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageBarrier.srcStageMask = from.stages;
+	imageBarrier.srcAccessMask = from.access & writeAccess; // Only writes have to be made available.
+	imageBarrier.dstStageMask = to.stages;
+	imageBarrier.dstAccessMask = to.access;
+	imageBarrier.oldLayout = from.layout;
+	imageBarrier.newLayout = to.layout;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	imageBarrier.image = image;
-	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	imageBarrier.subresourceRange = range;
+	barriers_.push_back(imageBarrier);
+}
 
-	VkDependencyInfo depedency{};
-	depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	depedency.imageMemoryBarrierCount = 1;
-	depedency.pImageMemoryBarriers = &imageBarrier;
+void Transition::UndefinedToColorAttachment(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
+{
+	transitionOnce(image, commandBuffer, range, ImageUsage::Undefined, ImageUsage::ColorAttachment);
+}
 
-	vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+void Transition::UndefinedToDepthStencilAttachment(VkImage image, VkCommandBuffer commandBuffer, VkFormat format)
+{
+	transitionOnce(image, commandBuffer, { getDepthAspect(format), 0, 1, 0, 1 }, ImageUsage::Undefined, ImageUsage::DepthStencilAttachment);
 }
 
-void Transition::TransferDestinationToPresentable(VkImage image, VkCommandBuffer commandBuffer)
+void Transition::UndefinedToTransferDestination(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-	imageBarrier.dstAccessMask = VK_ACCESS_NONE;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imageBarrier.subresourceRange.baseMipLevel = 0;
-	imageBarrier.subresourceRange.baseArrayLayer = 0;
-	imageBarrier.subresourceRange.levelCount = 1;
-	imageBarrier.subresourceRange.layerCount = 1;
+	transitionOnce(image, commandBuffer, range, ImageUsage::Undefined, ImageUsage::TransferDestination);
+}
 
-	VkDependencyInfo depedency{};
-	depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	depedency.imageMemoryBarrierCount = 1;
-	depedency.pImageMemoryBarriers = &imageBarrier;
+void Transition::ColorAttachmentToTransferDestination(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
+{
+	transitionOnce(image, commandBuffer, range, ImageUsage::ColorAttachment, ImageUsage::TransferDestination);
+}
 
-	vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+void Transition::TransferDestinationToPresentable(VkImage image, VkCommandBuffer commandBuffer)
+{
+	transitionOnce(image, commandBuffer, colorRange, ImageUsage::TransferDestination, ImageUsage::Present);
 }
 
 void Transition::TransferDestinationToShaderReadOptimal(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-	imageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT; // at fragment
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange = range;
-
-	VkDependencyInfo depedency{};
-	depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	depedency.imageMemoryBarrierCount = 1;
-	depedency.pImageMemoryBarriers = &imageBarrier;
-
-	vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+	transitionOnce(image, commandBuffer, range, ImageUsage::TransferDestination, ImageUsage::Sampled);
 }
 
 void Transition::ColorAttachmentToShaderReadOptimal(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-	imageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange = range;
-
-	VkDependencyInfo depedency{};
-	depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	depedency.imageMemoryBarrierCount = 1;
-	depedency.pImageMemoryBarriers = &imageBarrier;
-
-	vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+	transitionOnce(image, commandBuffer, range, ImageUsage::ColorAttachment, ImageUsage::Sampled);
 }
 
 void Transition::ColorAttachmentToTransferSource(VkImage image, VkCommandBuffer commandBuffer)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-	imageBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imageBarrier.subresourceRange.baseMipLevel = 0;
-	imageBarrier.subresourceRange.baseArrayLayer = 0;
-	imageBarrier.subresourceRange.levelCount = 1;
-	imageBarrier.subresourceRange.layerCount = 1;
-
-	VkDependencyInfo depedency{};
-	depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	depedency.imageMemoryBarrierCount = 1;
-	depedency.pImageMemoryBarriers = &imageBarrier;
-
-	vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+	transitionOnce(image, commandBuffer, colorRange, ImageUsage::ColorAttachment, ImageUsage::TransferSource);
 }
 
 void Transition::ColorAttachmentToPresentable(VkImage image, VkCommandBuffer commandBuffer)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-	imageBarrier.dstAccessMask = VK_ACCESS_NONE;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imageBarrier.subresourceRange.baseMipLevel = 0;
-	imageBarrier.subresourceRange.baseArrayLayer = 0;
-	imageBarrier.subresourceRange.levelCount = 1;
-	imageBarrier.subresourceRange.layerCount = 1;
-
-	VkDependencyInfo depedency{};
-	depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	depedency.imageMemoryBarrierCount = 1;
-	depedency.pImageMemoryBarriers = &imageBarrier;
-
-	vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+	transitionOnce(image, commandBuffer, colorRange, ImageUsage::ColorAttachment, ImageUsage::Present);
 }
 
 void Transition::ShaderReadOptimalToColorAttachment(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range)
 {
-	VkImageMemoryBarrier2 imageBarrier{};
-	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	imageBarrier.srcAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-	imageBarrier.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	imageBarrier.srcQueueFamilyIndex = 0;
-	imageBarrier.dstQueueFamilyIndex = 0;
-	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	imageBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	imageBarrier.image = image;
-	imageBarrier.subresourceRange = range;
-
-	VkDependencyInfo depedency{};
-	depedency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	depedency.imageMemoryBarrierCount = 1;
-	depedency.pImageMemoryBarriers = &imageBarrier;
-
-	vkCmdPipelineBarrier2KHR(commandBuffer, &depedency);
+	transitionOnce(image, commandBuffer, range, ImageUsage::Sampled, ImageUsage::ColorAttachment);
 }
@@ -1,11 +1,82 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <vector>
 
+class Image;
+
+/**
+ * @brief What a subresource is used for next. Each maps to a layout and the stages and accesses of that use.
+*/
+enum class ImageUsage
+{
+	Undefined,
+	ColorAttachment,
+	DepthStencilAttachment,
+	Sampled, // In the fragment shader.
+	ComputeSampled, // In a compute shader.
+	Storage, // Read and written by a compute shader.
+	TransferSource,
+	TransferDestination,
+	Present
+};
+
+struct ImageState
+{
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+
+	bool operator==(const ImageState&) const = default;
+};
+
+ImageState getImageState(ImageUsage usage);
+
+/**
+ * @return The aspects a barrier on an image of this depth format covers, the stencil only when the format has one.
+*/
+VkImageAspectFlags getDepthAspect(VkFormat format);
+
+/**
+ * @brief Collects the image barriers of a pass and records them with one vkCmdPipelineBarrier2.
+ * Transitions of an Image start from the state the image tracks per subresource, which is updated when the transition is added.
+ * Record a batch's command buffer in the order it executes relative to others touching the same images.
+*/
+class BarrierBatch
+{
+public:
+	void transition(Image& image, ImageUsage usage);
+	void transition(Image& image, const VkImageSubresourceRange& range, ImageUsage usage);
+	/**
+	 * @brief For images that are not tracked, such as the swapchain's.
+	*/
+	void transition(VkImage image, const VkImageSubresourceRange& range, ImageUsage from, ImageUsage to);
+	/**
+	 * @brief For an image about to be used on another queue, after a semaphore wait on the queue that last used it.
+	 * The wait already orders and makes available what came before, so the next transition only has to change the layout.
+	*/
+	static void handOver(Image& image);
+	/**
+	 * @brief For what is not an image, such as a buffer one dispatch writes and the next reads.
+	*/
+	void memory(VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess);
+
+	void flush(VkCommandBuffer commandBuffer);
+	bool empty() const;
+private:
+	void add(VkImage image, const VkImageSubresourceRange& range, const ImageState& from, const ImageState& to);
+
+	std::vector<VkImageMemoryBarrier2> barriers_;
+	std::vector<VkMemoryBarrier2> memoryBarriers_;
+};
+
+/**
+ * @brief Single transitions of untracked images.
+*/
 namespace Transition
 {
 	void UndefinedToColorAttachment(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range);
-	void UndefinedToDepthStencilAttachment(VkImage image, VkCommandBuffer commandBuffer);
+	void UndefinedToDepthStencilAttachment(VkImage image, VkCommandBuffer commandBuffer, VkFormat format);
 	void UndefinedToTransferDestination(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range);
 	void ColorAttachmentToTransferDestination(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range);
 	void TransferDestinationToPresentable(VkImage image, VkCommandBuffer commandBuffer);
@@ -14,4 +85,4 @@ namespace Transition
 	void ColorAttachmentToTransferSource(VkImage image, VkCommandBuffer commandBuffer);
 	void ColorAttachmentToPresentable(VkImage image, VkCommandBuffer commandBuffer);
 	void ShaderReadOptimalToColorAttachment(VkImage image, VkCommandBuffer commandBuffer, const VkImageSubresourceRange& range);
-}
\ No newline at end of file
+}
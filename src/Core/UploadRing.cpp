@@ -0,0 +1,94 @@
+#include "UploadRing.h"
+#include "Device.h"
+#include "Buffer.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace {
+	VkDeviceSize alignUp(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		return (size + alignment - 1) / alignment * alignment;
+	}
+}
+
+UploadRing::UploadRing(Device& device, VkDeviceSize frameSize, VkBufferUsageFlags usage, uint32_t framesInFlight):
+	device_(device), usage_(usage), framesInFlight_(framesInFlight)
+{
+	const auto& limits = device_.deviceProperties.limits;
+	// Indirect commands only need 4 bytes, uniform and storage offsets are at most 256 on any device.
+	alignment_ = std::max({ limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, VkDeviceSize(16) });
+	frameSize_ = alignUp(frameSize, alignment_);
+	createBuffer();
+}
+
+void UploadRing::beginFrame(uint32_t frame, VkDeviceSize requiredSize)
+{
+	if (requiredSize > frameSize_)
+	{
+		// Frames in flight may still read the old buffer, the device destroys it once they have retired.
+		buffer_.reset();
+		frameSize_ = alignUp(std::max(frameSize_ * 2, requiredSize), alignment_);
+		createBuffer();
+		generation_++;
+		spdlog::info("Upload ring grown to {} bytes per frame.", frameSize_);
+	}
+
+	head_ = frame * frameSize_;
+	end_ = head_ + frameSize_;
+}
+
+VkDeviceSize UploadRing::allocate(VkDeviceSize size)
+{
+	const VkDeviceSize offset = head_;
+	head_ += getAlignedSize(size);
+	check(head_ <= end_, "Upload ring allocation exceeds the size given to beginFrame!");
+	return offset;
+}
+
+void UploadRing::write(VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	buffer_->upload(data, size, offset);
+}
+
+VkDeviceSize UploadRing::upload(const void* data, VkDeviceSize size)
+{
+	const VkDeviceSize offset = allocate(size);
+	write(offset, data, size);
+	return offset;
+}
+
+VkDeviceSize UploadRing::getAlignedSize(VkDeviceSize size) const
+{
+	return alignUp(std::max(size, VkDeviceSize(1)), alignment_);
+}
+
+VkBuffer UploadRing::getBuffer() const
+{
+	return *buffer_;
+}
+
+VkDeviceSize UploadRing::getFrameSize() const
+{
+	return frameSize_;
+}
+
+uint32_t UploadRing::getGeneration() const
+{
+	return generation_;
+}
+
+UploadRing::~UploadRing() = default;
+
+void UploadRing::createBuffer()
+{
+	// Dynamic descriptors cover a whole frame's size from wherever their offset lands, so one frame of slack is kept past the last region.
+	const VkDeviceSize size = frameSize_ * (framesInFlight_ + 1);
+	buffer_ = std::make_unique<Buffer>(device_, size, usage_, VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+	setName(device_.device, VkBuffer(*buffer_), "Upload Ring");
+}
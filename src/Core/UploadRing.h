@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+class Device;
+class Buffer;
+
+/**
+ * @brief Persistently mapped buffer with one region per frame in flight. Per-frame data is bump allocated from the current
+ * frame's region and bound with dynamic offsets, so a frame never overwrites what an earlier frame may still be reading.
+*/
+class UploadRing
+{
+public:
+	UploadRing(Device& device, VkDeviceSize frameSize, VkBufferUsageFlags usage, uint32_t framesInFlight);
+
+	/**
+	 * @brief Rewinds the frame's region. The frame's fence must have been waited on.
+	 * If requiredSize does not fit, the buffer is replaced by a bigger one and the generation goes up.
+	 * @param requiredSize Sum of getAlignedSize() of everything the frame is going to allocate.
+	*/
+	void beginFrame(uint32_t frame, VkDeviceSize requiredSize);
+
+	/**
+	 * @return Offset from the start of the buffer, aligned for uniform, storage and indirect use.
+	*/
+	VkDeviceSize allocate(VkDeviceSize size);
+	void write(VkDeviceSize offset, const void* data, VkDeviceSize size);
+	VkDeviceSize upload(const void* data, VkDeviceSize size);
+
+	VkDeviceSize getAlignedSize(VkDeviceSize size) const;
+	VkBuffer getBuffer() const;
+	/**
+	 * @brief Largest range a single frame can use, which is what dynamic storage descriptors should cover.
+	*/
+	VkDeviceSize getFrameSize() const;
+	/**
+	 * @brief Changes whenever the buffer is replaced, descriptors pointing at the old one have to be rewritten.
+	*/
+	uint32_t getGeneration() const;
+
+	~UploadRing();
+private:
+	void createBuffer();
+
+	Device& device_;
+	const VkBufferUsageFlags usage_;
+	const uint32_t framesInFlight_;
+	VkDeviceSize alignment_;
+	VkDeviceSize frameSize_;
+
+	std::unique_ptr<Buffer> buffer_;
+
+	VkDeviceSize head_ = 0;
+	VkDeviceSize end_ = 0;
+	uint32_t generation_ = 0;
+};
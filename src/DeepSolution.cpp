@@ -1,11 +1,49 @@
 ﻿#include "Application.h"
 
 #include <vector>
+#include <string_view>
+#include <cstdlib>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 
-int main()
+namespace {
+	VkPresentModeKHR parsePresentMode(std::string_view name)
+	{
+		if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+		if (name == "fifo_relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+		if (name != "mailbox")
+		{
+			SPDLOG_WARN("Unknown present mode {}, using mailbox.", name);
+		}
+		return VK_PRESENT_MODE_MAILBOX_KHR;
+	}
+
+	HdrPrecision parseHdrPrecision(std::string_view name)
+	{
+		if (name == "full") return HdrPrecision::Full;
+		if (name == "packed") return HdrPrecision::Packed;
+		if (name != "half")
+		{
+			SPDLOG_WARN("Unknown HDR precision {}, using half.", name);
+		}
+		return HdrPrecision::Half;
+	}
+}
+
+/**
+ * Options:
+ *   --frames-in-flight N    Frames recorded ahead of the GPU, 1 to 4. Defaults to 2.
+ *   --present-mode MODE     fifo, fifo_relaxed, mailbox or immediate. Defaults to mailbox, also changeable at runtime.
+ *   --async-compute         Blur bloom on the compute queue, a frame late. Off by default, also changeable at runtime.
+ *   --hdr-precision P       full, half or packed: RGBA32F, RGBA16F or B10G11R11 HDR, bloom and lighting maps.
+ *                           Defaults to half, also changeable at runtime.
+ *   --depth-prepass         Draw opaque geometry depth only first, so the colour pass shades each pixel once.
+ *                           Off by default, also changeable at runtime.
+*/
+int main(int argc, char** argv)
 {
 	auto console_sink = std::make_shared<spdlog::sinks::wincolor_stdout_sink_mt>();
 	console_sink->set_level(spdlog::level::warn);
@@ -19,6 +57,40 @@ int main()
 	logger->flush_on(spdlog::level::err);
 	spdlog::register_logger(logger);
 
-	Application app(1920, 1080);
+	uint32_t framesInFlight = 2;
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	bool asyncCompute = false;
+	bool depthPrepass = false;
+	HdrPrecision hdrPrecision = HdrPrecision::Half;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string_view option = argv[i];
+		if (option == "--async-compute")
+		{
+			asyncCompute = true;
+		}
+		else if (option == "--depth-prepass")
+		{
+			depthPrepass = true;
+		}
+		else if (i + 1 == argc)
+		{
+			break;
+		}
+		else if (option == "--frames-in-flight")
+		{
+			framesInFlight = static_cast<uint32_t>(std::clamp(std::atoi(argv[++i]), 1, 4));
+		}
+		else if (option == "--present-mode")
+		{
+			presentMode = parsePresentMode(argv[++i]);
+		}
+		else if (option == "--hdr-precision")
+		{
+			hdrPrecision = parseHdrPrecision(argv[++i]);
+		}
+	}
+
+	Application app(1920, 1080, framesInFlight, presentMode, asyncCompute, hdrPrecision, depthPrepass);
 	app.run();
 }
@@ -1,280 +1,185 @@
 #include "Bloom.h"
 #include "../Core/Image.h"
+#include "../Core/Buffer.h"
 #include "../Core/Device.h"
 #include "../Core/Transition.h"
 #include "../Core/Shader.h"
+#include <algorithm>
 #include <array>
 #include "../Core/DescriptorWrite.h"
-#include "../Core/Framebuffer.h"
+#include "Shaders/BloomDownsample.comp.h"
+#include "Shaders/BloomUpsample.comp.h"
+#include "Shaders/BloomDownsampleSinglePass.comp.h"
+#include "Shaders/BloomUpsampleFused.comp.h"
+
+namespace {
+	// 8 by 8 invocations per group, one per texel.
+	void dispatch(VkCommandBuffer commandBuffer, VkExtent2D extent)
+	{
+		vkCmdDispatch(commandBuffer, (extent.width + 7) / 8, (extent.height + 7) / 8, 1);
+	}
+
+	VkExtent2D extentGivenMiplevel(VkExtent2D extent, uint32_t mipLevel)
+	{
+		return { std::max(extent.width >> mipLevel, 1u), std::max(extent.height >> mipLevel, 1u) };
+	}
+
+	// In texture coordinates, the same at every level.
+	constexpr float filterRadius = 0.005f;
+}
 
 Bloom::Bloom(Device& device): device_(device)
 {
-	{
+	const auto createComputePipeline = [&](const EmbeddedShader& shader, BloomComputePipeline& computePipeline) {
 		ShaderReflect reflect;
-		reflect.add("Shaders/BRDF.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		reflect.add("Shaders/BloomDownsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		reflect.add(shader);
 
-		bloomDownsamplePipeline_.descLayout = reflect.retrieveDescriptorSetLayout(device_.device)[0];
-		bloomDownsamplePipeline_.pool = reflect.retrieveDescriptorPool(device_.device, maxDownsamples * device_.getMaxFramesInFlight());
-		bloomDownsamplePipeline_.layout = reflect.retrievePipelineLayout(device_.device, { bloomDownsamplePipeline_.descLayout });
-		auto bloomStages = reflect.retrieveShaderModule(device_.device);
-		bloomDownsamplePipeline_.pipeline = [&]() {
-			VkPipeline pipeline;
+		computePipeline.descLayout = reflect.retrieveDescriptorSetLayout(device_)[0];
+		computePipeline.layout = reflect.retrievePipelineLayout(device_.device, { computePipeline.descLayout });
+		auto bloomStages = reflect.retrieveShaderModule(device_);
 
-			const auto stages = ShaderReflect::getStages(bloomStages);
+		VkComputePipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+		pipelineCreateInfo.stage = ShaderReflect::getStages(bloomStages)[0];
+		pipelineCreateInfo.layout = computePipeline.layout;
+		check(device_.createComputePipelines(1, &pipelineCreateInfo, &computePipeline.pipeline));
 
-			auto vertexInputState = CreateInfo::VertexInputState(nullptr, 0, nullptr, 0);
+		ShaderReflect::deleteModules(device_, bloomStages);
+	};
+	createComputePipeline(Shaders::BloomDownsample_comp, bloomDownsamplePipeline_);
+	createComputePipeline(Shaders::BloomUpsample_comp, bloomUpsamplePipeline_);
+	createComputePipeline(Shaders::BloomDownsampleSinglePass_comp, singlePassDownsamplePipeline_);
+	createComputePipeline(Shaders::BloomUpsampleFused_comp, fusedUpsamplePipeline_);
 
-			auto inputAssemblyState = CreateInfo::InputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+	VkSamplerCreateInfo samplerCI = CreateInfo::SamplerCI(maxMipLevels, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, device_.deviceProperties.limits.maxSamplerAnisotropy);
+	check(vkCreateSampler(device_.device, &samplerCI, nullptr, &bloomSampler_));
 
-			auto viewportState = CreateInfo::ViewportState();
+	for (auto& target : targets_)
+	{
+		target.counter = std::make_unique<Buffer>(device_, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			0, VMA_MEMORY_USAGE_AUTO, device_.getSharedFamilies());
+	}
+}
 
-			auto rasterizationState = CreateInfo::RasterizationState(
-				false,
-				VK_CULL_MODE_BACK_BIT,
-				VK_FRONT_FACE_COUNTER_CLOCKWISE
-			);
+void Bloom::resize(VkExtent2D extent, VkFormat format)
+{
+	// We start with one miplevel.
+	const VkExtent2D bloomExtent = { std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u) };
+	mipLevels_ = getMipLevels(bloomExtent.width, bloomExtent.height, minMipExtent, maxMipLevels);
+	if (!getDownsampleTiles(bloomExtent.width, bloomExtent.height).fitsLastGroup())
+	{
+		// Beyond 8K the single pass downsample stops at what the workgroups write themselves.
+		mipLevels_ = std::min(mipLevels_, 1 + DownsampleTiles::levelsPerGroup);
+	}
+	VkImageCreateInfo imageCI = CreateInfo::Image2DCI(bloomExtent, mipLevels_, format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+	// Written on the graphics queue by prefilter and on the compute queue by blur.
+	device_.shareAcrossQueues(imageCI);
 
-			auto multisampleState = CreateInfo::MultisampleState();
+	for (auto& target : targets_)
+	{
+		release(target);
+
+		target.memory = device_.transients.acquire(imageCI);
+		target.image = std::make_unique<Image>(device_, imageCI, target.memory, 0);
+		target.image->attachImageView(target.image->getFullRange());
+		setName(device_.device, target.image->get(), "Bloom");
+
+		VkImageViewCreateInfo imageViewCI{};
+		imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		imageViewCI.image = target.image->get();
+		imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCI.format = format;
+		target.mipViews.resize(mipLevels_);
+		for (uint32_t mip = 0; mip < mipLevels_; mip++)
+		{
+			imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 };
+			check(vkCreateImageView(device_.device, &imageViewCI, nullptr, &target.mipViews[mip]));
+		}
+		if (mipLevels_ > 1)
+		{
+			imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels_ - 1, 0, 1 };
+			check(vkCreateImageView(device_.device, &imageViewCI, nullptr, &target.lowerView));
+		}
+		target.queue = nullptr;
+	}
+}
 
-			auto depthStencilState = CreateInfo::NoDepthState();
+void Bloom::setSinglePass(bool singlePass)
+{
+	singlePass_ = singlePass;
+}
 
-			auto attachment = CreateInfo::NoBlend();
-			auto colorBlendState = CreateInfo::ColorBlendState(&attachment, 1);
+bool Bloom::getSinglePass() const
+{
+	return singlePass_;
+}
 
-			std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-			auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
+void Bloom::prefilter(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, Image& hdr, uint32_t target, const Device::Queue& queue)
+{
+	Image& mips = use(target, queue);
+	const auto& mipViews = targets_[target].mipViews;
 
-			VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
-			auto rendering = CreateInfo::Rendering(&format, 1, VK_FORMAT_UNDEFINED);
+	// Written fresh every frame, the sets of frames still in flight keep pointing at what they were recorded with.
+	const VkDescriptorSet set = frameDescriptors.allocate(bloomDownsamplePipeline_.descLayout);
+	DescriptorWrite writer;
+	writer.add(set, 0, 0, ImageType::CombinedSampler, 1, bloomSampler_, hdr.getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	writer.add(set, 1, 0, ImageType::Storage, 1, VK_NULL_HANDLE, mipViews[0], VK_IMAGE_LAYOUT_GENERAL);
+	writer.write(device_.device);
 
-			VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-			pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
-			pipelineCreateInfo.pStages = stages.data();
-			pipelineCreateInfo.pVertexInputState = &vertexInputState;
-			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-			pipelineCreateInfo.pTessellationState = nullptr;
-			pipelineCreateInfo.pViewportState = &viewportState;
-			pipelineCreateInfo.pRasterizationState = &rasterizationState;
-			pipelineCreateInfo.pMultisampleState = &multisampleState;
-			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-			pipelineCreateInfo.pColorBlendState = &colorBlendState;
-			pipelineCreateInfo.pDynamicState = &dynamicState;
-			pipelineCreateInfo.layout = bloomDownsamplePipeline_.layout;
+	VkDebugUtilsLabelEXT label{};
+	label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+	label.pLabelName = "Prefilter";
+	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
 
-			Connect(pipelineCreateInfo, rendering);
+	BarrierBatch barriers;
+	barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, ImageUsage::Storage);
+	barriers.flush(commandBuffer);
 
-			check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
-			return pipeline;
-		}();
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomDownsamplePipeline_.layout, 0, 1, &set, 0, nullptr);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomDownsamplePipeline_.pipeline);
+	dispatch(commandBuffer, mips.getExtent());
 
-		ShaderReflect::deleteModules(device_.device, bloomStages);
+	vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+}
 
-		bloomDownsamplePipeline_.sets = reflect.retrieveSet(device_.device, bloomDownsamplePipeline_.pool, bloomDownsamplePipeline_.descLayout, maxDownsamples);
+void Bloom::blur(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, uint32_t target, const Device::Queue& queue)
+{
+	use(target, queue);
+	if (mipLevels_ < 2)
+	{
+		// Nothing below the first level.
+		return;
 	}
+	if (singlePass_)
 	{
-		ShaderReflect reflect;
-		reflect.add("Shaders/BRDF.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		reflect.add("Shaders/BloomUpsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-
-		bloomUpsamplePipeline_.descLayout = reflect.retrieveDescriptorSetLayout(device_.device)[0];
-		bloomUpsamplePipeline_.pool = reflect.retrieveDescriptorPool(device_.device, maxDownsamples * device_.getMaxFramesInFlight());
-		bloomUpsamplePipeline_.layout = reflect.retrievePipelineLayout(device_.device, { bloomUpsamplePipeline_.descLayout });
-		auto bloomStages = reflect.retrieveShaderModule(device_.device);
-		bloomUpsamplePipeline_.pipeline = [&]() {
-			VkPipeline pipeline;
-
-			const auto stages = ShaderReflect::getStages(bloomStages);
-
-			auto vertexInputState = CreateInfo::VertexInputState(nullptr, 0, nullptr, 0);
-
-			auto inputAssemblyState = CreateInfo::InputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-
-			auto viewportState = CreateInfo::ViewportState();
-
-			auto rasterizationState = CreateInfo::RasterizationState(
-				false,
-				VK_CULL_MODE_NONE,
-				VK_FRONT_FACE_COUNTER_CLOCKWISE
-			);
-
-			auto multisampleState = CreateInfo::MultisampleState();
-
-			auto depthStencilState = CreateInfo::NoDepthState();
-
-			auto attachment = CreateInfo::ColorBlendAttachment();
-			attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-			attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
-			attachment.colorBlendOp = VK_BLEND_OP_ADD;
-			attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-			attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-			attachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-			auto colorBlendState = CreateInfo::ColorBlendState(&attachment, 1);
-
-			std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-			auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
-
-			VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
-			auto rendering = CreateInfo::Rendering(&format, 1, VK_FORMAT_UNDEFINED);
-
-			VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-			pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
-			pipelineCreateInfo.pStages = stages.data();
-			pipelineCreateInfo.pVertexInputState = &vertexInputState;
-			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-			pipelineCreateInfo.pTessellationState = nullptr;
-			pipelineCreateInfo.pViewportState = &viewportState;
-			pipelineCreateInfo.pRasterizationState = &rasterizationState;
-			pipelineCreateInfo.pMultisampleState = &multisampleState;
-			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-			pipelineCreateInfo.pColorBlendState = &colorBlendState;
-			pipelineCreateInfo.pDynamicState = &dynamicState;
-			pipelineCreateInfo.layout = bloomUpsamplePipeline_.layout;
-
-			Connect(pipelineCreateInfo, rendering);
-
-			check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
-			return pipeline;
-			}();
-
-		ShaderReflect::deleteModules(device_.device, bloomStages);
-
-		bloomUpsamplePipeline_.sets = reflect.retrieveSet(device_.device, bloomUpsamplePipeline_.pool, bloomUpsamplePipeline_.descLayout, maxDownsamples);
+		blurSinglePass(commandBuffer, frameDescriptors, targets_[target]);
 	}
+	else
 	{
-		ShaderReflect reflect;
-		reflect.add("Shaders/BRDF.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		reflect.add("Shaders/BloomComposite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-
-		bloomCompositePipeline_.descLayout = reflect.retrieveDescriptorSetLayout(device_.device)[0];
-		bloomCompositePipeline_.pool = reflect.retrieveDescriptorPool(device_.device, maxDownsamples * device_.getMaxFramesInFlight());
-		bloomCompositePipeline_.layout = reflect.retrievePipelineLayout(device_.device, { bloomCompositePipeline_.descLayout });
-		auto bloomStages = reflect.retrieveShaderModule(device_.device);
-		bloomCompositePipeline_.pipeline = [&]() {
-			VkPipeline pipeline;
-
-			const auto stages = ShaderReflect::getStages(bloomStages);
-
-			auto vertexInputState = CreateInfo::VertexInputState(nullptr, 0, nullptr, 0);
-
-			auto inputAssemblyState = CreateInfo::InputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-
-			auto viewportState = CreateInfo::ViewportState();
-
-			auto rasterizationState = CreateInfo::RasterizationState(
-				false,
-				VK_CULL_MODE_NONE,
-				VK_FRONT_FACE_COUNTER_CLOCKWISE
-			);
-
-			auto multisampleState = CreateInfo::MultisampleState();
-
-			auto depthStencilState = CreateInfo::NoDepthState();
-
-			auto attachment = CreateInfo::NoBlend();
-
-			auto colorBlendState = CreateInfo::ColorBlendState(&attachment, 1);
-
-			std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-			auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
-
-			VkFormat format = device_.getSurfaceFormat();
-			auto rendering = CreateInfo::Rendering(&format, 1, VK_FORMAT_UNDEFINED);
-
-			VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-			pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
-			pipelineCreateInfo.pStages = stages.data();
-			pipelineCreateInfo.pVertexInputState = &vertexInputState;
-			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-			pipelineCreateInfo.pTessellationState = nullptr;
-			pipelineCreateInfo.pViewportState = &viewportState;
-			pipelineCreateInfo.pRasterizationState = &rasterizationState;
-			pipelineCreateInfo.pMultisampleState = &multisampleState;
-			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-			pipelineCreateInfo.pColorBlendState = &colorBlendState;
-			pipelineCreateInfo.pDynamicState = &dynamicState;
-			pipelineCreateInfo.layout = bloomCompositePipeline_.layout;
-
-			Connect(pipelineCreateInfo, rendering);
-
-			check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
-			return pipeline;
-		}();
-
-		ShaderReflect::deleteModules(device_.device, bloomStages);
-
-		bloomCompositePipeline_.set = reflect.retrieveSet(device_.device, bloomCompositePipeline_.pool, bloomCompositePipeline_.descLayout)[0];
-
+		blurPerLevel(commandBuffer, frameDescriptors, targets_[target]);
 	}
-	
-	bloomImageViews_.resize(maxDownsamples);
-
-	VkSamplerCreateInfo samplerCI = CreateInfo::SamplerCI(maxDownsamples, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, device_.deviceProperties.limits.maxSamplerAnisotropy);
-	check(vkCreateSampler(device_.device, &samplerCI, nullptr, &bloomSampler_));
 }
 
-void Bloom::doBloom(VkCommandBuffer commandBuffer, VkExtent2D extent, VkImage image, VkImageView colorView, VkImageView swapchainView)
+void Bloom::blurPerLevel(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, Target& target)
 {
-	// We start with one miplevel.
-	const auto bloomExtent = VkExtent2D{ extent.width / 2, extent.height / 2 };
-
-	if (!bloomImage_ || bloomImage_->getExtent() != bloomExtent)
+	Image& mips = *target.image;
+	const auto& mipViews = target.mipViews;
+	const VkExtent2D bloomExtent = mips.getExtent();
+
+	// Level i + 1 is downsampled from i, and i is upsampled onto from i + 1.
+	std::array<VkDescriptorSet, maxMipLevels - 1> downsampleSets;
+	std::array<VkDescriptorSet, maxMipLevels - 1> upsampleSets;
+	frameDescriptors.allocate(bloomDownsamplePipeline_.descLayout, mipLevels_ - 1, downsampleSets.data());
+	frameDescriptors.allocate(bloomUpsamplePipeline_.descLayout, mipLevels_ - 1, upsampleSets.data());
+
+	DescriptorWrite writer;
+	for (uint32_t i = 0; i < mipLevels_ - 1; i++)
 	{
-		for (const auto& imageView : bloomImageViews_)
-		{
-			vkDestroyImageView(device_.device, imageView, nullptr);
-			// bloomImageViewsRecycle_.push_back(std::make_pair(imageView, device_.getMaxFramesInFlight()));
-		}
-
-		VkImageCreateInfo imageCI = CreateInfo::Image2DCI(bloomExtent, maxDownsamples, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
-		bloomImage_ = std::make_unique<Image>(device_, imageCI);
-		bloomImage_->attachImageView({ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-		VkSamplerCreateInfo samplerCI = CreateInfo::SamplerCI(maxDownsamples, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, device_.deviceProperties.limits.maxSamplerAnisotropy);
-		bloomImage_->attachSampler(samplerCI);
-
-		setName(device_.device, bloomImage_->get(), "Bloom Image");
-		for (uint32_t i = 0; i < maxDownsamples; i++)
-		{
-			VkImageView imageView;
-			VkImageViewCreateInfo imageViewCI{};
-			imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			imageViewCI.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-			imageViewCI.image = bloomImage_->get();
-			imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
-			check(vkCreateImageView(device_.device, &imageViewCI, nullptr, &imageView));
-			bloomImageViews_[i] = imageView;
-		}
-
-		DescriptorWrite writer;
-		for (uint32_t i = 0; i < bloomDownsamplePipeline_.sets.size(); i++)
-		{
-			writer.add(bloomDownsamplePipeline_.sets[i], 0, 0, ImageType::CombinedSampler, 1,
-				bloomSampler_, i == 0 ? colorView : bloomImageViews_[i - 1], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);	
-		}
-		for (uint32_t i = 0; i < maxDownsamples; i++)
-		{
-			writer.add(bloomUpsamplePipeline_.sets[i], 0, 0, ImageType::CombinedSampler, 1,
-				bloomSampler_, bloomImageViews_[maxDownsamples - 1 - i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		}
-		writer.add(bloomCompositePipeline_.set, 0, 0, ImageType::CombinedSampler, 1,
-			bloomSampler_, colorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		writer.add(bloomCompositePipeline_.set, 1, 0, ImageType::CombinedSampler, 1,
-			bloomImage_->getSampler(), bloomImage_->getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		writer.write(device_.device);
-		bloomImage_->UndefinedToColorAttachment(commandBuffer);
+		writer.add(downsampleSets[i], 0, 0, ImageType::CombinedSampler, 1, bloomSampler_, mipViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		writer.add(downsampleSets[i], 1, 0, ImageType::Storage, 1, VK_NULL_HANDLE, mipViews[i + 1], VK_IMAGE_LAYOUT_GENERAL);
+		writer.add(upsampleSets[i], 0, 0, ImageType::CombinedSampler, 1, bloomSampler_, mipViews[i + 1], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		writer.add(upsampleSets[i], 1, 0, ImageType::Storage, 1, VK_NULL_HANDLE, mipViews[i], VK_IMAGE_LAYOUT_GENERAL);
 	}
-
-	const auto extentGivenMiplevel = [](VkExtent2D extent, uint32_t mipLevel) {
-		for (uint32_t i = mipLevel; i > 0; i--)
-		{
-			extent.width /= 2;
-			extent.height /= 2;
-		}
-		return extent;
-	};
+	writer.write(device_.device);
 
 	// Downsampling
 	VkDebugUtilsLabelEXT label{};
@@ -282,121 +187,157 @@ void Bloom::doBloom(VkCommandBuffer commandBuffer, VkExtent2D extent, VkImage im
 	label.pLabelName = "Downsampling";
 	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
 
-	Transition::ColorAttachmentToShaderReadOptimal(image, commandBuffer, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-	for (size_t i = 0; i < maxDownsamples; i++)
+	BarrierBatch barriers;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomDownsamplePipeline_.pipeline);
+	for (uint32_t i = 1; i < mipLevels_; i++)
 	{
-		// transition i to sampled
-		if (i != 0)
-			Transition::ColorAttachmentToShaderReadOptimal(bloomImage_->get(), commandBuffer, {VK_IMAGE_ASPECT_COLOR_BIT, uint32_t(i - 1), 1, 0, 1});
-		// transition i + 1 to color attachment (already done)
-		
-		const auto dim = extentGivenMiplevel(bloomExtent, i);
-		Framebuffer framebuffer(dim);
-		framebuffer.addColorAttachment(bloomImageViews_[i]);
-		framebuffer.beginRendering(commandBuffer, {
-			FramebufferOption{FramebufferType::Color, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE, {}}
-		});
-
-		auto viewport = CreateInfo::Viewport(dim);
-		VkRect2D scissor{};
-		scissor.extent = dim;
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-		vkCmdPushConstants(commandBuffer, bloomDownsamplePipeline_.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(dim), &dim);
-
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bloomDownsamplePipeline_.layout, 0, 1, &bloomDownsamplePipeline_.sets[i], 0, nullptr);
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bloomDownsamplePipeline_.pipeline);
-		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-
-		framebuffer.endRendering(commandBuffer);
+		// Mip i - 1 is read while i is written.
+		barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 1, 0, 1 }, ImageUsage::ComputeSampled);
+		barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 }, ImageUsage::Storage);
+		barriers.flush(commandBuffer);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomDownsamplePipeline_.layout, 0, 1, &downsampleSets[i - 1], 0, nullptr);
+		dispatch(commandBuffer, extentGivenMiplevel(bloomExtent, i));
 	}
-	// all mips will be in sampled (except last)
 	vkCmdEndDebugUtilsLabelEXT(commandBuffer);
 
 	// Blur Upsampling
 	label.pLabelName = "Upsampling";
 	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
 
-	for (uint32_t i = 0; i < maxDownsamples - 1; i++)
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomUpsamplePipeline_.pipeline);
+	vkCmdPushConstants(commandBuffer, bloomUpsamplePipeline_.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(filterRadius), &filterRadius);
+	for (uint32_t i = mipLevels_ - 1; i > 0; i--)
 	{
-		int mipLevelToReadFrom = int(maxDownsamples) - 1 - i;
-		int mipLevelToWriteTo = int(maxDownsamples) - 2 - i;
-
-		Transition::ColorAttachmentToShaderReadOptimal(bloomImage_->get(), commandBuffer, { VK_IMAGE_ASPECT_COLOR_BIT, uint32_t(mipLevelToReadFrom), 1, 0, 1 });
-		Transition::ShaderReadOptimalToColorAttachment(bloomImage_->get(), commandBuffer, { VK_IMAGE_ASPECT_COLOR_BIT, uint32_t(mipLevelToWriteTo), 1, 0, 1 });
-		
-		const auto dim = mipLevelToWriteTo == -1 ? extent : extentGivenMiplevel(bloomExtent, mipLevelToWriteTo);
-		Framebuffer framebuffer(dim);
-		framebuffer.addColorAttachment(mipLevelToWriteTo == -1 ? colorView : bloomImageViews_[mipLevelToWriteTo]);
-		framebuffer.beginRendering(commandBuffer, {
-			FramebufferOption{FramebufferType::Color, VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_STORE_OP_STORE, {}}
-		});
-
-		auto viewport = CreateInfo::Viewport(dim);
-		VkRect2D scissor{};
-		scissor.extent = dim;
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-		float radius = 0.005f;
-		vkCmdPushConstants(commandBuffer, bloomUpsamplePipeline_.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(radius), &radius);
-
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bloomUpsamplePipeline_.layout, 0, 1, &bloomUpsamplePipeline_.sets[i], 0, nullptr);
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bloomUpsamplePipeline_.pipeline);
-		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-
-		framebuffer.endRendering(commandBuffer);
+		const uint32_t mipLevelToWriteTo = i - 1;
+		barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 }, ImageUsage::ComputeSampled);
+		barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, mipLevelToWriteTo, 1, 0, 1 }, ImageUsage::Storage);
+		barriers.flush(commandBuffer);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomUpsamplePipeline_.layout, 0, 1, &upsampleSets[mipLevelToWriteTo], 0, nullptr);
+		dispatch(commandBuffer, extentGivenMiplevel(bloomExtent, mipLevelToWriteTo));
 	}
 	vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+}
 
-	label.pLabelName = "Compositing";
-	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+void Bloom::blurSinglePass(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, Target& target)
+{
+	Image& mips = *target.image;
+	const auto& mipViews = target.mipViews;
+	const VkExtent2D bloomExtent = mips.getExtent();
+	const DownsampleTiles tiles = getDownsampleTiles(bloomExtent.width, bloomExtent.height);
+
+	const VkDescriptorSet downsampleSet = frameDescriptors.allocate(singlePassDownsamplePipeline_.descLayout);
+	const VkDescriptorSet upsampleSet = frameDescriptors.allocate(fusedUpsamplePipeline_.descLayout);
+	DescriptorWrite writer;
+	for (uint32_t mip = 0; mip < maxMipLevels; mip++)
+	{
+		// Levels the chain does not have are never written, but have to be valid. They repeat the last one.
+		writer.add(downsampleSet, mip, 0, ImageType::Storage, 1, VK_NULL_HANDLE, mipViews[std::min(mip, mipLevels_ - 1)], VK_IMAGE_LAYOUT_GENERAL);
+	}
+	writer.add(downsampleSet, maxMipLevels, 0, BufferType::Storage, 1, *target.counter, 0, sizeof(uint32_t));
+	writer.add(upsampleSet, 0, 0, ImageType::CombinedSampler, 1, bloomSampler_, target.lowerView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	writer.add(upsampleSet, 1, 0, ImageType::Storage, 1, VK_NULL_HANDLE, mipViews[0], VK_IMAGE_LAYOUT_GENERAL);
+	writer.write(device_.device);
 
-	Transition::ColorAttachmentToShaderReadOptimal(bloomImage_->get(), commandBuffer, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-	Framebuffer framebuffer(extent);
-	framebuffer.addColorAttachment(swapchainView);
-	framebuffer.beginRendering(commandBuffer, {
-		FramebufferOption{FramebufferType::Color, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE, {}}
-	});
+	VkDebugUtilsLabelEXT label{};
+	label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+	label.pLabelName = "Downsampling";
+	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
 
-	auto viewport = CreateInfo::Viewport(extent);
-	VkRect2D scissor{};
-	scissor.extent = extent;
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	BarrierBatch barriers;
+	if (!target.counterCleared)
+	{
+		vkCmdFillBuffer(commandBuffer, *target.counter, 0, sizeof(uint32_t), 0);
+		barriers.memory(VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+		target.counterCleared = true;
+	}
+	else
+	{
+		// The last downsample put the counter back to zero.
+		barriers.memory(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+	}
+	barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels_, 0, 1 }, ImageUsage::Storage);
+	barriers.flush(commandBuffer);
+
+	const std::array<uint32_t, 2> downsampleConstants = { mipLevels_, tiles.getGroupCount() };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, singlePassDownsamplePipeline_.layout, 0, 1, &downsampleSet, 0, nullptr);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, singlePassDownsamplePipeline_.pipeline);
+	vkCmdPushConstants(commandBuffer, singlePassDownsamplePipeline_.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(downsampleConstants), downsampleConstants.data());
+	vkCmdDispatch(commandBuffer, tiles.groupsX, tiles.groupsY, 1);
+	vkCmdEndDebugUtilsLabelEXT(commandBuffer);
 
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bloomCompositePipeline_.layout, 0, 1, &bloomCompositePipeline_.set, 0, nullptr);
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bloomCompositePipeline_.pipeline);
-	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	label.pLabelName = "Upsampling";
+	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
 
-	framebuffer.endRendering(commandBuffer);
+	barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, ImageUsage::Storage);
+	barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels_ - 1, 0, 1 }, ImageUsage::ComputeSampled);
+	barriers.flush(commandBuffer);
 
+	struct
+	{
+		float filterRadius;
+		uint32_t lowerLevelCount;
+	} upsampleConstants{ filterRadius, mipLevels_ - 1 };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, fusedUpsamplePipeline_.layout, 0, 1, &upsampleSet, 0, nullptr);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, fusedUpsamplePipeline_.pipeline);
+	vkCmdPushConstants(commandBuffer, fusedUpsamplePipeline_.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(upsampleConstants), &upsampleConstants);
+	dispatch(commandBuffer, bloomExtent);
 	vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+}
 
-	Transition::ShaderReadOptimalToColorAttachment(image, commandBuffer, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-	Transition::ShaderReadOptimalToColorAttachment(bloomImage_->get(), commandBuffer, { VK_IMAGE_ASPECT_COLOR_BIT, 0, maxDownsamples, 0, 1 });
-	// all mips will be color attachment
+VkImageView Bloom::useResult(BarrierBatch& barriers, uint32_t target, const Device::Queue& queue)
+{
+	Image& mips = use(target, queue);
+	barriers.transition(mips, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, ImageUsage::Sampled);
+	return targets_[target].mipViews[0];
+}
+
+Image& Bloom::use(uint32_t target, const Device::Queue& queue)
+{
+	auto& used = targets_[target];
+	if (used.queue && used.queue != &queue)
+	{
+		BarrierBatch::handOver(*used.image);
+	}
+	used.queue = &queue;
+	return *used.image;
+}
+
+void Bloom::release(Target& target)
+{
+	if (!target.image)
+	{
+		return;
+	}
+	target.image.reset();
+	// Blurs on the compute queue may still use it, which the device waits for but the pool alone does not.
+	device_.release([&device = device_, memory = target.memory, views = std::move(target.mipViews), lowerView = target.lowerView]() {
+		for (const auto view : views)
+		{
+			vkDestroyImageView(device.device, view, nullptr);
+		}
+		vkDestroyImageView(device.device, lowerView, nullptr);
+		device.transients.release(memory);
+	});
+	target.memory = VK_NULL_HANDLE;
+	target.mipViews.clear();
+	target.lowerView = VK_NULL_HANDLE;
 }
 
 Bloom::~Bloom()
 {
-	for (const auto& imageView : bloomImageViews_)
+	for (auto& target : targets_)
 	{
-		vkDestroyImageView(device_.device, imageView, nullptr);
+		release(target);
 	}
 	vkDestroySampler(device_.device, bloomSampler_, nullptr);
-	vkDestroyDescriptorPool(device_.device, bloomDownsamplePipeline_.pool, nullptr);
-	vkDestroyDescriptorPool(device_.device, bloomUpsamplePipeline_.pool, nullptr);
-	vkDestroyDescriptorPool(device_.device, bloomCompositePipeline_.pool, nullptr);
-	vkDestroyDescriptorSetLayout(device_.device, bloomDownsamplePipeline_.descLayout, nullptr);
-	vkDestroyDescriptorSetLayout(device_.device, bloomUpsamplePipeline_.descLayout, nullptr);
-	vkDestroyDescriptorSetLayout(device_.device, bloomCompositePipeline_.descLayout, nullptr);
-	vkDestroyPipeline(device_.device, bloomDownsamplePipeline_.pipeline, nullptr);
-	vkDestroyPipeline(device_.device, bloomUpsamplePipeline_.pipeline, nullptr);
-	vkDestroyPipeline(device_.device, bloomCompositePipeline_.pipeline, nullptr);
-	vkDestroyPipelineLayout(device_.device, bloomDownsamplePipeline_.layout, nullptr);
-	vkDestroyPipelineLayout(device_.device, bloomUpsamplePipeline_.layout, nullptr);
-	vkDestroyPipelineLayout(device_.device, bloomCompositePipeline_.layout, nullptr);
+	for (const auto* computePipeline : { &bloomDownsamplePipeline_, &bloomUpsamplePipeline_, &singlePassDownsamplePipeline_, &fusedUpsamplePipeline_ })
+	{
+		device_.registry.release(computePipeline->descLayout);
+		vkDestroyPipeline(device_.device, computePipeline->pipeline, nullptr);
+		vkDestroyPipelineLayout(device_.device, computePipeline->layout, nullptr);
+	}
 }
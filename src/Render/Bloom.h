@@ -1,51 +1,99 @@
 #pragma once
 
 #include <vulkan/vulkan_core.h>
+#include <vk_mem_alloc.h>
 #include "../Core/Common.h"
+#include "../Core/Device.h"
+#include "../Common/MipChain.h"
+#include <array>
 #include <memory>
-#include <utility>
+#include <vector>
 
-class Device;
 class Image;
+class Buffer;
+class BarrierBatch;
+class DescriptorAllocator;
+/**
+ * @brief Bloom in three steps: prefilter downsamples the HDR image into a target's first level, blur runs the rest of the
+ * mip chain down and back up in compute shaders, and the final pass (see PostProcess) mixes the first level over the HDR image.
+ * The chain gets more levels at higher resolutions, so the glow covers about the same part of the screen at any size.
+ * There are two targets, so one frame's blur can run on the compute queue while the next frame prefilters into the other.
+ * A target moved between queues is only used after a semaphore wait on the queue that used it last.
+*/
 class Bloom
 {
 public:
 	Bloom(Device& device);
 
-	void doBloom(VkCommandBuffer commandBuffer, VkExtent2D extent, VkImage image, VkImageView colorView, VkImageView swapchainView);
+	static constexpr uint32_t targetCount = 2;
+
+	/**
+	 * @brief Recreates the targets for an HDR image of extent, nothing they held is kept. The old ones are released to the device.
+	 * @param format Of the levels, one with hdrColorFeatures (see HdrPrecision.h). The shaders work with any.
+	*/
+	void resize(VkExtent2D extent, VkFormat format);
+
+	/**
+	 * @brief Single pass blurs with one dispatch down the whole chain and one back up, see BloomDownsampleSinglePass.comp
+	 * and BloomUpsampleFused.comp. Otherwise each level is a dispatch of its own with a barrier in between,
+	 * which filters with 13 taps on the way down rather than 4. Takes effect at the next blur.
+	*/
+	void setSinglePass(bool singlePass);
+	bool getSinglePass() const;
+
+	/**
+	 * @param frameDescriptors Reset once the frame has retired, the sets of this frame come from it.
+	 * @param hdr Compute sampled on entry, the caller moves it.
+	*/
+	void prefilter(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, Image& hdr, uint32_t target, const Device::Queue& queue);
+	/**
+	 * @brief Leaves the result in the first level of target.
+	*/
+	void blur(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, uint32_t target, const Device::Queue& queue);
+	/**
+	 * @brief Adds the move of the first level of target to sampled, for the final pass.
+	 * @return A view of that level.
+	*/
+	VkImageView useResult(BarrierBatch& barriers, uint32_t target, const Device::Queue& queue);
 
 	~Bloom();
 private:
-	const uint32_t maxDownsamples = 5;
-
-	Device& device_;
-	struct BloomDownsamplePipeline {
-		VkDescriptorSetLayout descLayout;
-		VkDescriptorPool pool;
-		VkPipelineLayout layout;
-		std::vector<VkDescriptorSet> sets;
-		VkPipeline pipeline;
-	} bloomDownsamplePipeline_;
+	// What the single pass downsample can write, the first level and two workgroup reductions.
+	static constexpr uint32_t maxMipLevels = 1 + 2 * DownsampleTiles::levelsPerGroup;
+	static constexpr uint32_t minMipExtent = 16;
 
-	struct BloomUpsamplePipeline {
-		VkDescriptorSetLayout descLayout;
-		VkDescriptorPool pool;
-		VkPipelineLayout layout;
-		std::vector<VkDescriptorSet> sets;
-		VkPipeline pipeline;
-	} bloomUpsamplePipeline_;
+	struct Target
+	{
+		std::unique_ptr<Image> image;
+		VmaAllocation memory{};
+		std::vector<VkImageView> mipViews;
+		VkImageView lowerView{}; // Every level but the first, what the fused upsample samples.
+		std::unique_ptr<Buffer> counter; // Workgroups of the single pass downsample that have finished.
+		bool counterCleared = false;
+		const Device::Queue* queue = nullptr; // Last recorded for.
+	};
+	/**
+	 * @brief Hands the target over when queue is not the one it was last used on.
+	*/
+	Image& use(uint32_t target, const Device::Queue& queue);
+	void release(Target& target);
+	void blurPerLevel(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, Target& target);
+	void blurSinglePass(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, Target& target);
 
-	struct BloomCompositePipeline {
+	Device& device_;
+	struct BloomComputePipeline {
 		VkDescriptorSetLayout descLayout;
-		VkDescriptorPool pool;
 		VkPipelineLayout layout;
-		VkDescriptorSet set;
 		VkPipeline pipeline;
-	} bloomCompositePipeline_;
+	};
+	BloomComputePipeline bloomDownsamplePipeline_;
+	BloomComputePipeline bloomUpsamplePipeline_;
+	BloomComputePipeline singlePassDownsamplePipeline_;
+	BloomComputePipeline fusedUpsamplePipeline_;
 
-	std::unique_ptr<Image> bloomImage_{};
 	VkSampler bloomSampler_{};
 
-	// Index i represents image view of miplevel i.
-	std::vector<VkImageView> bloomImageViews_;
-};
\ No newline at end of file
+	std::array<Target, targetCount> targets_;
+	uint32_t mipLevels_ = 1; // Of the targets.
+	bool singlePass_ = true;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+/**
+ * @brief Precision of the HDR colour target, the bloom chain, the irradiance and prefiltered cubemaps and the BRDF lookup table.
+ * Every pass that reads or writes them moves half or a quarter of the bytes below full precision.
+*/
+enum class HdrPrecision
+{
+	Full, // 32-bit floats.
+	Half, // 16-bit floats.
+	Packed, // 11 and 10-bit unsigned floats in 32 bits, without alpha or negative values.
+};
+
+inline constexpr HdrPrecision hdrPrecisions[] = { HdrPrecision::Full, HdrPrecision::Half, HdrPrecision::Packed };
+
+inline constexpr const char* getName(HdrPrecision precision)
+{
+	switch (precision)
+	{
+	case HdrPrecision::Full: return "Full (RGBA32F)";
+	case HdrPrecision::Half: return "Half (RGBA16F)";
+	case HdrPrecision::Packed: return "Packed (B10G11R11)";
+	}
+	return "";
+}
+
+/**
+ * @return Of the HDR target, the bloom chain and the irradiance and prefiltered cubemaps.
+*/
+inline constexpr VkFormat getColorFormat(HdrPrecision precision)
+{
+	switch (precision)
+	{
+	case HdrPrecision::Full: return VK_FORMAT_R32G32B32A32_SFLOAT;
+	case HdrPrecision::Half: return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case HdrPrecision::Packed: return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+/**
+ * @return Of the BRDF lookup table. Its two channels are already 32 bits at half precision, so packed keeps those.
+*/
+inline constexpr VkFormat getLutFormat(HdrPrecision precision)
+{
+	return precision == HdrPrecision::Full ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R16G16_SFLOAT;
+}
+
+/**
+ * @brief What the colour format has to support: rendered to with blending, filtered, and written and read
+ * by compute shaders that leave the format out of their storage image declarations.
+*/
+inline constexpr VkFormatFeatureFlags2 hdrColorFeatures =
+	VK_FORMAT_FEATURE_2_COLOR_ATTACHMENT_BIT |
+	VK_FORMAT_FEATURE_2_COLOR_ATTACHMENT_BLEND_BIT |
+	VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+	VK_FORMAT_FEATURE_2_STORAGE_IMAGE_BIT |
+	VK_FORMAT_FEATURE_2_STORAGE_READ_WITHOUT_FORMAT_BIT |
+	VK_FORMAT_FEATURE_2_STORAGE_WRITE_WITHOUT_FORMAT_BIT;
+inline constexpr VkFormatFeatureFlags2 hdrLutFeatures =
+	VK_FORMAT_FEATURE_2_COLOR_ATTACHMENT_BIT |
+	VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
@@ -0,0 +1,338 @@
+#include "OcclusionCulling.h"
+#include "../Common/Bench.h"
+
+#include <BS_thread_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+	constexpr uint32_t laneWidth = 8;
+	constexpr uint32_t rowsPerBand = 16;
+
+	struct ScreenVertex
+	{
+		float x, y, z;
+		bool valid;
+	};
+
+	ScreenVertex toScreen(const glm::vec4& clip, uint32_t width, uint32_t height)
+	{
+		// Anything behind or crossing the near plane is rejected. Losing an occluder is safe, writing a wrong depth is not.
+		if (clip.w <= 0.f || clip.z < 0.f)
+		{
+			return { 0.f, 0.f, 0.f, false };
+		}
+		const float invW = 1.f / clip.w;
+		return {
+			(clip.x * invW * 0.5f + 0.5f) * float(width),
+			(clip.y * invW * 0.5f + 0.5f) * float(height),
+			clip.z * invW,
+			true
+		};
+	}
+}
+
+OccluderMesh simplifyOccluder(const glm::vec3* positions, const uint32_t* indices, size_t indexCount, size_t maxTriangles)
+{
+	const size_t triangleCount = indexCount / 3;
+	std::vector<uint32_t> kept(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		kept[i] = i;
+	}
+
+	if (triangleCount > maxTriangles)
+	{
+		std::vector<float> areas(triangleCount);
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			const glm::vec3& a = positions[indices[i * 3]];
+			areas[i] = glm::length(glm::cross(positions[indices[i * 3 + 1]] - a, positions[indices[i * 3 + 2]] - a));
+		}
+		std::nth_element(kept.begin(), kept.begin() + maxTriangles, kept.end(), [&](uint32_t a, uint32_t b) { return areas[a] > areas[b]; });
+		kept.resize(maxTriangles);
+		std::sort(kept.begin(), kept.end());
+	}
+
+	// Compacted, so a large mesh does not keep every position for a few triangles.
+	OccluderMesh mesh;
+	std::unordered_map<uint32_t, uint32_t> remap;
+	mesh.indices.reserve(kept.size() * 3);
+	for (const uint32_t triangle : kept)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t index = indices[triangle * 3 + k];
+			const auto [it, inserted] = remap.try_emplace(index, static_cast<uint32_t>(mesh.positions.size()));
+			if (inserted)
+			{
+				mesh.positions.push_back(positions[index]);
+			}
+			mesh.indices.push_back(it->second);
+		}
+	}
+	return mesh;
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height) :
+	width_(width), height_(height), stride_((width + laneWidth - 1) / laneWidth * laneWidth)
+{
+	depth_.resize(static_cast<size_t>(stride_) * height_, 1.0f);
+}
+
+void OcclusionCuller::begin(const glm::mat4& viewProjection)
+{
+	viewProjection_ = viewProjection;
+	std::fill(depth_.begin(), depth_.end(), 1.0f);
+	triangles_.clear();
+	rasterMs_ = 0.f;
+	tested_ = 0;
+	culled_ = 0;
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* positions, const uint32_t* indices, size_t indexCount, const glm::mat4& model)
+{
+	const glm::mat4 mvp = viewProjection_ * model;
+	const float maxX = float(width_ - 1);
+	const float maxY = float(height_ - 1);
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		ScreenVertex v[3];
+		for (int k = 0; k < 3; k++)
+		{
+			v[k] = toScreen(mvp * glm::vec4(positions[indices[i + k]], 1.0f), width_, height_);
+		}
+		if (!v[0].valid || !v[1].valid || !v[2].valid)
+		{
+			continue;
+		}
+
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+		if (std::abs(area) < 1e-6f)
+		{
+			continue;
+		}
+		// Occluders are rasterized regardless of winding.
+		if (area < 0.f)
+		{
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		const float boundMinX = std::max(0.f, std::min({ v[0].x, v[1].x, v[2].x }));
+		const float boundMaxX = std::min(maxX, std::max({ v[0].x, v[1].x, v[2].x }));
+		const float boundMinY = std::max(0.f, std::min({ v[0].y, v[1].y, v[2].y }));
+		const float boundMaxY = std::min(maxY, std::max({ v[0].y, v[1].y, v[2].y }));
+		if (boundMinX > boundMaxX || boundMinY > boundMaxY)
+		{
+			continue;
+		}
+
+		Triangle triangle{};
+		for (int k = 0; k < 3; k++)
+		{
+			const ScreenVertex& a = v[k];
+			const ScreenVertex& b = v[(k + 1) % 3];
+			triangle.edgeA[k] = a.y - b.y;
+			triangle.edgeB[k] = b.x - a.x;
+			triangle.edgeC[k] = -(triangle.edgeA[k] * a.x + triangle.edgeB[k] * a.y);
+		}
+
+		// z / w is linear in screen space.
+		const float invArea = 1.f / area;
+		triangle.zA = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) * invArea;
+		triangle.zB = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) * invArea;
+		// Evaluated at pixel centers, moved to the farthest corner so the pixel is never nearer than the triangle anywhere in it.
+		triangle.zC = v[0].z - triangle.zA * v[0].x - triangle.zB * v[0].y + 0.5f * (std::abs(triangle.zA) + std::abs(triangle.zB));
+
+		triangle.minX = static_cast<int>(boundMinX);
+		triangle.maxX = static_cast<int>(boundMaxX);
+		triangle.minY = static_cast<int>(boundMinY);
+		triangle.maxY = static_cast<int>(boundMaxY);
+		triangles_.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::rasterize(BS::thread_pool* pool)
+{
+	auto s = Bench::record();
+
+	const uint32_t bands = (height_ + rowsPerBand - 1) / rowsPerBand;
+	const auto rasterizeBand = [this](uint32_t band) {
+		rasterizeRows(band * rowsPerBand, std::min(height_, (band + 1) * rowsPerBand));
+	};
+
+	if (pool && !triangles_.empty())
+	{
+		pool->detach_loop(0u, bands, rasterizeBand);
+		pool->wait();
+	}
+	else
+	{
+		for (uint32_t band = 0; band < bands; band++)
+		{
+			rasterizeBand(band);
+		}
+	}
+
+	auto e = Bench::record();
+	rasterMs_ = Bench::diff<float>(s, e);
+}
+
+void OcclusionCuller::rasterizeRows(uint32_t rowBegin, uint32_t rowEnd)
+{
+	for (const auto& triangle : triangles_)
+	{
+		const int y0 = std::max<int>(triangle.minY, rowBegin);
+		const int y1 = std::min<int>(triangle.maxY, rowEnd - 1);
+		const int x0 = triangle.minX & ~int(laneWidth - 1);
+
+		for (int y = y0; y <= y1; y++)
+		{
+			const float py = float(y) + 0.5f;
+			float* row = &depth_[static_cast<size_t>(y) * stride_];
+			float rowEdge[3];
+			for (int k = 0; k < 3; k++)
+			{
+				rowEdge[k] = triangle.edgeB[k] * py + triangle.edgeC[k];
+			}
+			const float rowZ = triangle.zB * py + triangle.zC;
+
+#if defined(__AVX2__)
+			const __m256 laneOffset = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+			const __m256 zero = _mm256_setzero_ps();
+			for (int x = x0; x <= triangle.maxX; x += laneWidth)
+			{
+				const __m256 px = _mm256_add_ps(_mm256_set1_ps(float(x)), laneOffset);
+				const __m256 e0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edgeA[0]), px), _mm256_set1_ps(rowEdge[0]));
+				const __m256 e1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edgeA[1]), px), _mm256_set1_ps(rowEdge[1]));
+				const __m256 e2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edgeA[2]), px), _mm256_set1_ps(rowEdge[2]));
+				const __m256 inside = _mm256_and_ps(_mm256_and_ps(
+					_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+					_mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+					_mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+				if (_mm256_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				const __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.zA), px), _mm256_set1_ps(rowZ));
+				const __m256 current = _mm256_loadu_ps(row + x);
+				_mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+			}
+#else
+			for (int x = x0; x <= triangle.maxX; x++)
+			{
+				const float px = float(x) + 0.5f;
+				if (triangle.edgeA[0] * px + rowEdge[0] >= 0.f &&
+					triangle.edgeA[1] * px + rowEdge[1] >= 0.f &&
+					triangle.edgeA[2] * px + rowEdge[2] >= 0.f)
+				{
+					row[x] = std::min(row[x], triangle.zA * px + rowZ);
+				}
+			}
+#endif
+		}
+	}
+}
+
+bool OcclusionCuller::isVisible(const BoundingBox& bounds, const glm::mat4& model) const
+{
+	tested_++;
+
+	const glm::mat4 mvp = viewProjection_ * model;
+	float minX = std::numeric_limits<float>::max(), maxX = std::numeric_limits<float>::lowest();
+	float minY = std::numeric_limits<float>::max(), maxY = std::numeric_limits<float>::lowest();
+	float minZ = std::numeric_limits<float>::max();
+
+	for (int i = 0; i < 8; i++)
+	{
+		const glm::vec3 corner = {
+			(i & 1) ? bounds.max.x : bounds.min.x,
+			(i & 2) ? bounds.max.y : bounds.min.y,
+			(i & 4) ? bounds.max.z : bounds.min.z
+		};
+		const auto v = toScreen(mvp * glm::vec4(corner, 1.0f), width_, height_);
+		if (!v.valid)
+		{
+			return true; // Crosses the near plane.
+		}
+		minX = std::min(minX, v.x);
+		maxX = std::max(maxX, v.x);
+		minY = std::min(minY, v.y);
+		maxY = std::max(maxY, v.y);
+		minZ = std::min(minZ, v.z);
+	}
+
+	// Outside the frustum.
+	if (minZ > 1.0f || maxX < 0.f || maxY < 0.f || minX >= float(width_) || minY >= float(height_))
+	{
+		culled_++;
+		return false;
+	}
+
+	// Depth is sampled at pixel centers, so grow the rectangle by a pixel to stay conservative at the edges.
+	const int x0 = std::max(0, static_cast<int>(minX) - 1);
+	const int x1 = std::min(int(width_) - 1, static_cast<int>(maxX) + 1);
+	const int y0 = std::max(0, static_cast<int>(minY) - 1);
+	const int y1 = std::min(int(height_) - 1, static_cast<int>(maxY) + 1);
+
+	for (int y = y0; y <= y1; y++)
+	{
+		const float* row = &depth_[static_cast<size_t>(y) * stride_];
+#if defined(__AVX2__)
+		const __m256 nearest = _mm256_set1_ps(minZ);
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		for (int x = x0 & ~int(laneWidth - 1); x <= x1; x += laneWidth)
+		{
+			const __m256i px = _mm256_add_epi32(_mm256_set1_epi32(x), lanes);
+			const __m256i inRange = _mm256_and_si256(
+				_mm256_cmpgt_epi32(px, _mm256_set1_epi32(x0 - 1)),
+				_mm256_cmpgt_epi32(_mm256_set1_epi32(x1 + 1), px));
+			const __m256 passes = _mm256_cmp_ps(_mm256_loadu_ps(row + x), nearest, _CMP_GE_OQ);
+			if (_mm256_movemask_ps(_mm256_and_ps(passes, _mm256_castsi256_ps(inRange))) != 0)
+			{
+				return true;
+			}
+		}
+#else
+		for (int x = x0; x <= x1; x++)
+		{
+			if (row[x] >= minZ)
+			{
+				return true;
+			}
+		}
+#endif
+	}
+
+	culled_++;
+	return false;
+}
+
+uint32_t OcclusionCuller::getWidth() const
+{
+	return width_;
+}
+
+uint32_t OcclusionCuller::getHeight() const
+{
+	return height_;
+}
+
+float OcclusionCuller::getDepth(uint32_t x, uint32_t y) const
+{
+	return depth_[static_cast<size_t>(y) * stride_ + x];
+}
+
+OcclusionCuller::Stats OcclusionCuller::getStats() const
+{
+	return { static_cast<uint32_t>(triangles_.size()), tested_.load(), culled_.load(), rasterMs_ };
+}
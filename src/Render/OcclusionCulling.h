@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace BS { class thread_pool; }
+
+struct BoundingBox
+{
+	glm::vec3 min{ std::numeric_limits<float>::max() };
+	glm::vec3 max{ std::numeric_limits<float>::lowest() };
+
+	void expand(const glm::vec3& point) { min = glm::min(min, point); max = glm::max(max, point); }
+	bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+};
+
+/**
+ * @brief What a mesh occludes with, its largest triangles and only the positions they use.
+*/
+struct OccluderMesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+};
+
+/**
+ * @brief Keeps at most maxTriangles of the largest triangles, in their original order. Fewer triangles can only hide less,
+ * so the proxy never culls what the mesh would not, and the largest are what hides the most of walls and floors.
+*/
+OccluderMesh simplifyOccluder(const glm::vec3* positions, const uint32_t* indices, size_t indexCount, size_t maxTriangles);
+
+/**
+ * @brief Software occlusion culling. Occluder triangles are rasterized into a small depth buffer (8 pixels per AVX2 lane),
+ * then bounding boxes are tested against it. Does not depend on Vulkan, so it can be benchmarked on its own.
+ * Each pixel holds the farthest depth of the triangle over the whole pixel, so a sloped occluder never hides more than it covers.
+ * Coverage is sampled at pixel centers: a gap between occluders narrower than one pixel of this buffer may be filled,
+ * and what is only seen through it culled. A gap of a pixel or more always keeps what is behind it.
+*/
+class OcclusionCuller
+{
+public:
+	struct Stats
+	{
+		uint32_t occluderTriangles;
+		uint32_t tested;
+		uint32_t culled;
+		float rasterMs;
+	};
+
+	OcclusionCuller(uint32_t width = 320, uint32_t height = 192);
+
+	/**
+	 * @brief Clears depth and occluders for a new frame.
+	*/
+	void begin(const glm::mat4& viewProjection);
+
+	void addOccluder(const glm::vec3* positions, const uint32_t* indices, size_t indexCount, const glm::mat4& model);
+
+	/**
+	 * @brief Rasterizes every occluder added since begin(). The buffer is split in row bands across the pool if given.
+	*/
+	void rasterize(BS::thread_pool* pool = nullptr);
+
+	/**
+	 * @brief Thread safe once rasterize() returned.
+	*/
+	bool isVisible(const BoundingBox& bounds, const glm::mat4& model) const;
+
+	uint32_t getWidth() const;
+	uint32_t getHeight() const;
+	float getDepth(uint32_t x, uint32_t y) const;
+	Stats getStats() const;
+
+private:
+	struct Triangle
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float zA, zB, zC; // z = zA * x + zB * y + zC
+		int minX, maxX, minY, maxY;
+	};
+
+	void rasterizeRows(uint32_t rowBegin, uint32_t rowEnd);
+
+	const uint32_t width_;
+	const uint32_t height_;
+	const uint32_t stride_; // width rounded up to 8
+
+	glm::mat4 viewProjection_{ 1.0f };
+	std::vector<float> depth_;
+	std::vector<Triangle> triangles_;
+
+	float rasterMs_ = 0.f;
+	mutable std::atomic<uint32_t> tested_ = 0;
+	mutable std::atomic<uint32_t> culled_ = 0;
+};
@@ -0,0 +1,229 @@
+#include "PostProcess.h"
+#include "../Core/Device.h"
+#include "../Core/Common.h"
+#include "../Core/Shader.h"
+#include "../Core/DescriptorAllocator.h"
+#include "../Core/DescriptorWrite.h"
+#include "../Core/Framebuffer.h"
+#include "Shaders/BRDF.vert.h"
+#include "Shaders/PostProcess.frag.h"
+
+#include <volk.h>
+#include <array>
+
+namespace {
+	// As PostProcess.frag.
+	struct SpecializationData
+	{
+		uint32_t tonemap;
+		VkBool32 grid;
+		VkBool32 encodeSrgb;
+	};
+
+	struct PushConstants
+	{
+		glm::mat4 inverseViewProjection;
+		glm::vec4 viewProjectionZ;
+		glm::vec4 viewProjectionW;
+		float exposure;
+		float bloomStrength;
+	};
+
+	// Of the bloom over the scene.
+	constexpr float bloomStrength = 0.04f;
+
+	bool isSrgb(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+const char* PostProcess::getName(Tonemap tonemap)
+{
+	switch (tonemap)
+	{
+	case Tonemap::None: return "None";
+	case Tonemap::Reinhard: return "Reinhard";
+	case Tonemap::Aces: return "ACES";
+	}
+	return "";
+}
+
+PostProcess::PostProcess(Device& device): device_(device)
+{
+	ShaderReflect reflect;
+	reflect.add(Shaders::BRDF_vert);
+	reflect.add(Shaders::PostProcess_frag);
+
+	descLayout_ = reflect.retrieveDescriptorSetLayout(device_)[0];
+	layout_ = reflect.retrievePipelineLayout(device_.device, { descLayout_ });
+	auto modules = reflect.retrieveShaderModule(device_);
+	auto stages = ShaderReflect::getStages(modules);
+
+	auto vertexInputState = CreateInfo::VertexInputState(nullptr, 0, nullptr, 0);
+	auto inputAssemblyState = CreateInfo::InputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+	auto viewportState = CreateInfo::ViewportState();
+	auto rasterizationState = CreateInfo::RasterizationState(
+		false,
+		VK_CULL_MODE_NONE,
+		VK_FRONT_FACE_COUNTER_CLOCKWISE
+	);
+	auto multisampleState = CreateInfo::MultisampleState();
+	auto depthStencilState = CreateInfo::NoDepthState();
+	auto attachment = CreateInfo::NoBlend();
+	auto colorBlendState = CreateInfo::ColorBlendState(&attachment, 1);
+
+	std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
+
+	VkFormat format = device_.getSurfaceFormat();
+	auto rendering = CreateInfo::Rendering(&format, 1, VK_FORMAT_UNDEFINED);
+
+	std::array<VkSpecializationMapEntry, 3> mapEntries{};
+	mapEntries[0] = { 0, offsetof(SpecializationData, tonemap), sizeof(SpecializationData::tonemap) };
+	mapEntries[1] = { 1, offsetof(SpecializationData, grid), sizeof(SpecializationData::grid) };
+	mapEntries[2] = { 2, offsetof(SpecializationData, encodeSrgb), sizeof(SpecializationData::encodeSrgb) };
+
+	for (const Tonemap tonemap : tonemaps)
+	{
+		for (const bool grid : { false, true })
+		{
+			// An sRGB swapchain encodes on write, any other is taken to want sRGB anyway.
+			SpecializationData data{ static_cast<uint32_t>(tonemap), grid, !isSrgb(format) };
+			VkSpecializationInfo specInfo{};
+			specInfo.dataSize = sizeof(SpecializationData);
+			specInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+			specInfo.pMapEntries = mapEntries.data();
+			specInfo.pData = &data;
+			for (auto& stage : stages)
+			{
+				if (stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+				{
+					stage.pSpecializationInfo = &specInfo;
+				}
+			}
+
+			VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+			pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
+			pipelineCreateInfo.pStages = stages.data();
+			pipelineCreateInfo.pVertexInputState = &vertexInputState;
+			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+			pipelineCreateInfo.pTessellationState = nullptr;
+			pipelineCreateInfo.pViewportState = &viewportState;
+			pipelineCreateInfo.pRasterizationState = &rasterizationState;
+			pipelineCreateInfo.pMultisampleState = &multisampleState;
+			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+			pipelineCreateInfo.pColorBlendState = &colorBlendState;
+			pipelineCreateInfo.pDynamicState = &dynamicState;
+			pipelineCreateInfo.layout = layout_;
+
+			Connect(pipelineCreateInfo, rendering);
+
+			check(device_.createGraphicsPipelines(1, &pipelineCreateInfo, &pipelines_[getVariant(tonemap, grid)]));
+		}
+	}
+
+	ShaderReflect::deleteModules(device_, modules);
+
+	VkSamplerCreateInfo samplerCI = CreateInfo::SamplerCI(1, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST, 1.f);
+	check(vkCreateSampler(device_.device, &samplerCI, nullptr, &sampler_));
+}
+
+void PostProcess::setTonemap(Tonemap tonemap)
+{
+	tonemap_ = tonemap;
+}
+
+PostProcess::Tonemap PostProcess::getTonemap() const
+{
+	return tonemap_;
+}
+
+void PostProcess::setExposure(float exposure)
+{
+	exposure_ = exposure;
+}
+
+float PostProcess::getExposure() const
+{
+	return exposure_;
+}
+
+void PostProcess::setGrid(bool grid)
+{
+	grid_ = grid;
+}
+
+bool PostProcess::getGrid() const
+{
+	return grid_;
+}
+
+void PostProcess::record(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, const Inputs& inputs, const glm::mat4& viewProjection, VkImageView swapchainView, VkExtent2D extent)
+{
+	const VkDescriptorSet set = frameDescriptors.allocate(descLayout_);
+	DescriptorWrite writer;
+	writer.add(set, 0, 0, ImageType::CombinedSampler, 1, sampler_, inputs.hdr, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	writer.add(set, 1, 0, ImageType::CombinedSampler, 1, sampler_, inputs.bloom, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Unread without the grid, any sampled view will do.
+	writer.add(set, 2, 0, ImageType::CombinedSampler, 1, sampler_, grid_ ? inputs.depth : inputs.hdr, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	writer.write(device_.device);
+
+	PushConstants constants{};
+	constants.inverseViewProjection = glm::inverse(viewProjection);
+	// glm is column major, these are rows.
+	constants.viewProjectionZ = { viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2] };
+	constants.viewProjectionW = { viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3] };
+	constants.exposure = exposure_;
+	constants.bloomStrength = bloomStrength;
+
+	VkDebugUtilsLabelEXT label{};
+	label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+	label.pLabelName = "Post Process";
+	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+
+	Framebuffer framebuffer(extent);
+	framebuffer.addColorAttachment(swapchainView);
+	framebuffer.beginRendering(commandBuffer, {
+		FramebufferOption{FramebufferType::Color, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE, {}}
+	});
+
+	auto viewport = CreateInfo::Viewport(extent);
+	VkRect2D scissor{};
+	scissor.extent = extent;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout_, 0, 1, &set, 0, nullptr);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines_[getVariant(tonemap_, grid_)]);
+	vkCmdPushConstants(commandBuffer, layout_, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+	framebuffer.endRendering(commandBuffer);
+
+	vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+}
+
+PostProcess::~PostProcess()
+{
+	vkDestroySampler(device_.device, sampler_, nullptr);
+	for (const auto pipeline : pipelines_)
+	{
+		vkDestroyPipeline(device_.device, pipeline, nullptr);
+	}
+	vkDestroyPipelineLayout(device_.device, layout_, nullptr);
+	device_.registry.release(descLayout_);
+}
+
+uint32_t PostProcess::getVariant(Tonemap tonemap, bool grid)
+{
+	return static_cast<uint32_t>(tonemap) * 2 + (grid ? 1 : 0);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <array>
+
+class Device;
+class DescriptorAllocator;
+
+/**
+ * @brief The last pass of a frame, one full-screen triangle into the swapchain. Reads the HDR target once, mixes the bloom over it,
+ * applies the exposure, tonemaps, draws the grid over the result and encodes to sRGB when the swapchain format does not.
+ * Every combination of options is a pipeline of its own specialized from the same shader, built up front, so switching costs nothing
+ * and what is off is not in the shader at all.
+*/
+class PostProcess
+{
+public:
+	// As PostProcess.frag.
+	enum class Tonemap : uint32_t
+	{
+		None, // Clamped.
+		Reinhard,
+		Aces,
+	};
+	static constexpr Tonemap tonemaps[] = { Tonemap::None, Tonemap::Reinhard, Tonemap::Aces };
+	static const char* getName(Tonemap tonemap);
+
+	PostProcess(Device& device);
+
+	void setTonemap(Tonemap tonemap);
+	Tonemap getTonemap() const;
+	/**
+	 * @brief Scales the scene and its bloom before tonemapping.
+	*/
+	void setExposure(float exposure);
+	float getExposure() const;
+	/**
+	 * @brief Draws the y = 0 plane as a grid, behind the scene where its depth is in front.
+	*/
+	void setGrid(bool grid);
+	bool getGrid() const;
+
+	struct Inputs
+	{
+		VkImageView hdr;
+		VkImageView bloom;
+		VkImageView depth; // Sampled, only read with the grid.
+	};
+	/**
+	 * @param frameDescriptors Reset once the frame has retired, the set of this frame comes from it.
+	 * @param inputs Sampled, the caller moves them.
+	 * @param viewProjection Of the camera the depth was drawn with.
+	 * @param swapchainView A colour attachment of extent, every pixel is written.
+	*/
+	void record(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, const Inputs& inputs, const glm::mat4& viewProjection, VkImageView swapchainView, VkExtent2D extent);
+
+	~PostProcess();
+private:
+	static constexpr uint32_t tonemapCount = static_cast<uint32_t>(std::size(tonemaps));
+	static uint32_t getVariant(Tonemap tonemap, bool grid);
+
+	Device& device_;
+
+	VkDescriptorSetLayout descLayout_{};
+	VkPipelineLayout layout_{};
+	std::array<VkPipeline, tonemapCount * 2> pipelines_{}; // See getVariant.
+	VkSampler sampler_{};
+
+	Tonemap tonemap_ = Tonemap::Aces;
+	float exposure_ = 1.f;
+	bool grid_ = false;
+};
@@ -2,29 +2,40 @@
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
-#include <memory>
 
 class Device;
-class Buffer;
 
+/**
+ * @brief A full-screen triangle at the far plane, drawn after the opaque geometry in the same rendering scope.
+ * It neither writes depth nor changes it in the shader, so the early depth test leaves it only the pixels nothing covers.
+*/
 class Skybox
 {
 public:
-	Skybox(Device& device, const std::shared_ptr<Buffer>& cubeBuffer);
+	/**
+	 * @param colorFormat Of the HDR target it draws into.
+	*/
+	Skybox(Device& device, VkFormat colorFormat);
+
+	/**
+	 * @brief Recreates the pipeline for another HDR target format, the old one is released to the device.
+	*/
+	void setColorFormat(VkFormat colorFormat);
 
 	void set(VkImageView imageView, VkSampler sampler) const;
-	void render(VkCommandBuffer commandBuffer, const glm::mat4& projection, const glm::mat4& view, VkImageView colorView, VkImageView depthView, VkExtent2D extent);
+	/**
+	 * @brief Draws into an already begun rendering scope (HDR color + depth).
+	*/
+	void record(VkCommandBuffer commandBuffer, const glm::mat4& projection, const glm::mat4& view, VkExtent2D extent);
 
 	~Skybox();
 private:
-	Device& device_;
+	VkPipeline createPipeline(VkFormat colorFormat) const;
 
-	std::shared_ptr<Buffer> cubeBuffer;
-	std::unique_ptr<Buffer> uniformBuffer;
+	Device& device_;
 
 	VkDescriptorSet skyboxSet;
 	VkDescriptorSetLayout skyboxSetLayout;
-	VkDescriptorPool skyboxPool;
 	VkPipelineLayout skyboxLayout;
 	VkPipeline skyboxPipeline;
 };
\ No newline at end of file
@@ -7,47 +7,74 @@
 #include "Core/Image.h"
 #include "Scene.h"
 
+#include <algorithm>
 #include <array>
+#include <limits>
 #include <volk.h>
 #include <fmt/format.h>
+#include <spdlog/spdlog.h>
 #include "Core/DescriptorWrite.h"
 #include "Core/Transition.h"
 #include "Core/Framebuffer.h"
 #include "Render/Bloom.h"
+#include "Render/PostProcess.h"
+#include "Core/ThreadCommandPools.h"
+#include "Core/UploadRing.h"
+#include "Core/BindlessTextures.h"
+#include "Shaders/PBR.frag.h"
+#include "Shaders/PBR.vert.h"
 
-Renderer::Renderer(Device& device, Scene& scene): device_(device), scene_(scene), maxFramesInFlight(device_.getMaxFramesInFlight())
-{
-	vertexShader_ = loadShader(device_.device, "Shaders/PBR.vert.spv");
-	fragmentShader_ = loadShader(device_.device, "Shaders/PBR.frag.spv");
+#include <BS_thread_pool.hpp>
+
+namespace {
+	RenderGraph::ImageDesc hdrDesc(VkExtent2D extent, HdrPrecision precision)
+	{
+		return { extent, getColorFormat(precision), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
+	}
+
+	float getLength(const std::optional<Interval>& interval)
+	{
+		return interval ? static_cast<float>(interval->length()) : 0.f;
+	}
+}
 
-	constexpr size_t meshDrawDataBufferSize = 2048ull * sizeof(IndirectDrawParam);
-	constexpr size_t lightBufferSize = 128ull * sizeof(Light) + sizeof(LightUpload); 
-	constexpr size_t indirectBufferSize = 2048ull * sizeof(VkDrawIndexedIndirectCommand);
+Renderer::Renderer(Device& device, Scene& scene, BS::thread_pool& workers): device_(device), scene_(scene), workers_(workers), maxFramesInFlight(device_.getMaxFramesInFlight())
+{
+	vertexShader_ = loadShader(device_, Shaders::PBR_vert);
+	fragmentShader_ = loadShader(device_, Shaders::PBR_frag);
 
-	indirectBuffer = std::make_unique<Buffer>(device_, indirectBufferSize,
-		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+	// Room for roughly 2048 draws and a few lights at first, it grows on demand.
+	constexpr VkDeviceSize initialFrameSize = 256ull * 1024;
+	uploadRing_ = std::make_unique<UploadRing>(device_, initialFrameSize,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, maxFramesInFlight);
 
 	// Global Descriptor Set (Per Frame, Global)
 	DescriptorCreator creator{};
-	creator.add("Global Set", 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT);
-	creator.add("Global Set", 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-	creator.add("Global Set", 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
-	globalSetLayout = creator.createLayout("Global Set", device_.device);
+	creator.add("Global Set", 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT);
+	creator.add("Global Set", 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+	creator.add("Global Set", 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
+	globalSetLayout = creator.createLayout("Global Set", device_);
 
 	// Bindless Set (Global)
-	creator.add("Bindless Set", 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT);
-	creator.add("Bindless Set", 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10000, VK_SHADER_STAGE_FRAGMENT_BIT, 
+	// The texture array can grow up to what the device allows, the set only holds what is in use.
+	constexpr uint32_t defaultTextureCount = 4;
+	const uint32_t maxTextures = std::min({
+		device_.indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+		device_.indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		1u << 20 }) - defaultTextureCount;
+	creator.add("Bindless Set", 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, defaultTextureCount, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT);
+	creator.add("Bindless Set", 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures, VK_SHADER_STAGE_FRAGMENT_BIT, 
 		VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT |
 		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
 		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
 		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT);
-	bindlessSetLayout = creator.createLayout("Bindless Set", device_.device, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+	bindlessSetLayout = creator.createLayout("Bindless Set", device_, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
 
 	// IBR set
 	creator.add("IBR Set", 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
 	creator.add("IBR Set", 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
 	creator.add("IBR Set", 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
-	ibrSetLayout = creator.createLayout("IBR Set", device_.device);
+	ibrSetLayout = creator.createLayout("IBR Set", device_);
 	
 	// Layout
 	VkPushConstantRange range{};
@@ -57,202 +84,244 @@ Renderer::Renderer(Device& device, Scene& scene): device_(device), scene_(scene)
 
 	// Rendering techniques
 	bloom_ = std::make_unique<Bloom>(device_);
+	postProcess_ = std::make_unique<PostProcess>(device_);
 
-	// Pool
-	globalPool_ = creator.createPool("Global Set", device_.device, maxFramesInFlight);
-	bindlessPool = creator.createPool("Bindless Set", device_.device, 1, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
-	ibrPool = creator.createPool("IBR Set", device_.device, 1);
-
-	// Sets
-	globalSets_.resize(maxFramesInFlight);
-	creator.allocateSets("Global Set", device_.device, maxFramesInFlight, globalSets_.data());
-	creator.allocateVariableSets("Bindless Set", device_.device, 1, &bindlessSet_, 2048);
-	creator.allocateSets("IBR Set", device_.device, 1, &ibrSet);
-
-	// Buffers
-	globalUniformBuffers_.resize(maxFramesInFlight);
-	perMeshDrawDataBuffer.resize(maxFramesInFlight);
-	lightBuffer.resize(maxFramesInFlight);
-
-	for (size_t i = 0; i < maxFramesInFlight; i++)
+	computePool_ = CreateInfo::createCommandPool(device_.device, device_.computeQueue.family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	for (uint32_t i = 0; i < maxFramesInFlight; i++)
 	{
-		globalUniformBuffers_[i] = std::make_unique<Buffer>(device, sizeof(GlobalUniform), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-		perMeshDrawDataBuffer[i] = std::make_unique<Buffer>(device_, meshDrawDataBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-		lightBuffer[i] = std::make_unique<Buffer>(device_, lightBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+		computeCommandBuffers_.push_back(CreateInfo::allocateCommandBuffer(device_.device, computePool_));
 	}
+	computeTickets_.resize(maxFramesInFlight);
+	frameSinglePassBloom_.resize(maxFramesInFlight);
 
-	// Write
-	DescriptorWrite writer;
-	for (size_t i = 0; i < maxFramesInFlight; i++)
+	timer_ = std::make_unique<GpuTimer>(device_, maxFramesInFlight, ScopeCount);
+	if (!timer_->isSupported())
 	{
-		writer.add(globalSets_[i], 0, 0, BufferType::Uniform, 1, *globalUniformBuffers_[i], 0, VK_WHOLE_SIZE);
-		writer.add(globalSets_[i], 1, 0, BufferType::Storage, 1, *perMeshDrawDataBuffer[i], 0, VK_WHOLE_SIZE);
-		writer.add(globalSets_[i], 2, 0, BufferType::Storage, 1, *lightBuffer[i], 0, VK_WHOLE_SIZE);
+		SPDLOG_WARN("Timestamps are not supported on the graphics and compute queues, GPU timings are unavailable.");
 	}
-	writer.write(device_.device);
-
-	// HDR
-	DescriptorCreator hdrCreator;
-	hdrCreator.add("HDR To Image", 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
-	hdrPipeline_.setLayouts[0] = hdrCreator.createLayout("HDR To Image", device_.device);
-	hdrPipeline_.pool = hdrCreator.createPool("HDR To Image", device_.device);
-	hdrCreator.allocateSets("HDR To Image", device_.device, 1, &hdrSet);
-
-	hdrPipeline_.layout = hdrCreator.createPipelineLayout(device_.device, hdrPipeline_.setLayouts);
-	hdrPipeline_.pipeline = [&]() {
-		VkShaderModule vertexShader = loadShader(device_.device, "Shaders/BRDF.vert.spv");
-		VkShaderModule fragmentShader = loadShader(device_.device, "Shaders/Blit.frag.spv");
-
-		VkPipeline pipeline;
-		std::array stages = {
-			CreateInfo::ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader),
-			CreateInfo::ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader)
-		};
-		auto vertexInputState = CreateInfo::VertexInputState(nullptr, 0, nullptr, 0);
-
-		auto inputAssemblyState = CreateInfo::InputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-
-		auto viewportState = CreateInfo::ViewportState();
-
-		auto rasterizationState = CreateInfo::RasterizationState(
-			VK_FALSE,
-			VK_CULL_MODE_BACK_BIT,
-			VK_FRONT_FACE_COUNTER_CLOCKWISE
-		);
-
-		auto multisampleState = CreateInfo::MultisampleState();
-
-		auto depthStencilState = CreateInfo::NoDepthState();
-
-		auto colorAttachment = CreateInfo::NoBlend();
-		auto colorBlendState = CreateInfo::ColorBlendState(&colorAttachment, 1);
 
-		std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-		auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
+	commandPools_ = std::make_unique<ThreadCommandPools>(device_, static_cast<uint32_t>(workers_.get_thread_count()), maxFramesInFlight);
 
-		VkFormat swapchainFormat = device_.getSurfaceFormat();
-		auto rendering = CreateInfo::Rendering(&swapchainFormat, 1, device_.getDepthFormat());
+	// Sets
+	globalSets_.resize(maxFramesInFlight);
+	creator.allocateSets("Global Set", device_, maxFramesInFlight, globalSets_.data());
+	bindless_ = std::make_unique<BindlessTextures>(device_, bindlessSetLayout, 1, defaultTextureCount, 2048, maxTextures, maxFramesInFlight);
+	creator.allocateSets("IBR Set", device_, 1, &ibrSet);
 
-		VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-		pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
-		pipelineCreateInfo.pStages = stages.data();
-		pipelineCreateInfo.pVertexInputState = &vertexInputState;
-		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-		pipelineCreateInfo.pTessellationState = nullptr;
-		pipelineCreateInfo.pViewportState = &viewportState;
-		pipelineCreateInfo.pRasterizationState = &rasterizationState;
-		pipelineCreateInfo.pMultisampleState = &multisampleState;
-		pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-		pipelineCreateInfo.pColorBlendState = &colorBlendState;
-		pipelineCreateInfo.pDynamicState = &dynamicState;
-		pipelineCreateInfo.layout = hdrPipeline_.layout;
+	// Sets only needed by the frame that records them, reset when the frame comes around again.
+	frameDescriptors_ = std::vector<DescriptorAllocator>(maxFramesInFlight);
+	for (uint32_t i = 0; i < maxFramesInFlight; i++)
+	{
+		frameDescriptors_[i].init(device_.device, device_.registry, fmt::format("Frame {}", i));
+	}
 
-		Connect(pipelineCreateInfo, rendering);
+	// Written on first use, and again whenever the upload ring is replaced.
+	globalSetGenerations_.resize(maxFramesInFlight, std::numeric_limits<uint32_t>::max());
+
+	// The frame's passes. Descriptions are placeholders until the first draw knows the extent.
+	graph_ = std::make_unique<RenderGraph>(device_);
+	const auto depth = graph_->importImage("Depth");
+	// Owned by Bloom, which moves it between queues itself.
+	const auto bloom = graph_->importImage("Bloom");
+	hdr_ = graph_->createImage("HDR", hdrDesc({ 1, 1 }, precision_));
+
+	graph_->addPass("Opaque", [&](RenderGraph::PassBuilder& pass) {
+		pass.write(hdr_, ImageUsage::ColorAttachment);
+		pass.write(depth, ImageUsage::DepthStencilAttachment);
+	}, [this](VkCommandBuffer commandBuffer) {
+		timer_->begin(commandBuffer, SceneScope);
+		Framebuffer framebuffer(frame_.extent);
+		framebuffer.addColorAttachment(graph_->getImage(hdr_).getView());
+		framebuffer.addDepthAttachment(frame_.depthView);
+		framebuffer.beginRendering(commandBuffer, {
+			{FramebufferType::Color, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, { 0.f, 0.f, 0.f, 1.f }},
+			{FramebufferType::Depth, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, { 1.0f, 0 }}
+		}, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT);
 
-		check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		// Executed in order, so the depth pre-pass fills the depth buffer before anything is shaded
+		// and the skybox is drawn after the opaque geometry and only shades what it left uncovered.
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(frame_.opaqueBuffers.size()), frame_.opaqueBuffers.data());
 
-		vkDestroyShaderModule(device_.device, vertexShader, nullptr);
-		vkDestroyShaderModule(device_.device, fragmentShader, nullptr);
-		return pipeline;
-	}();
+		framebuffer.endRendering(commandBuffer);
+		timer_->end(commandBuffer, SceneScope);
+	});
 
+	// Recorded on the primary rather than a worker, so its barriers stay in order with the graph's.
+	// The composite is left out, as a deferred blur runs between the two.
+	graph_->addPass("Bloom", [&](RenderGraph::PassBuilder& pass) {
+		pass.read(hdr_, ImageUsage::ComputeSampled);
+		pass.write(bloom, ImageUsage::Storage);
+	}, [this](VkCommandBuffer commandBuffer) {
+		bloom_->prefilter(commandBuffer, frameDescriptors_[frameCount_], graph_->getImage(hdr_), bloomTarget_, device_.graphicsQueue);
+		if (!deferBloom_)
+		{
+			timer_->begin(commandBuffer, BloomScope);
+			bloom_->blur(commandBuffer, frameDescriptors_[frameCount_], bloomTarget_, device_.graphicsQueue);
+			timer_->end(commandBuffer, BloomScope);
+		}
+	});
 }
 
-void Renderer::draw(VkCommandBuffer commandBuffer, VkImageView colorView, VkImageView depthView, const Scene::Drawbles& renderItems, const State& state)
+void Renderer::draw(VkCommandBuffer commandBuffer, VkImageView depthView, const Scene::Drawbles& renderItems, const State& state, LinearArena& arena)
 {
-	// HDR Pipeline
+	// The frame's last blur on the compute queue used its descriptors and timestamps too.
+	device_.wait(computeTickets_[frameCount_]);
+	computeTickets_[frameCount_] = {};
+	readTimings();
+
+	// A new extent reallocates the transients, the old ones retire with this frame.
 	const VkExtent2D extent = { uint32_t(state.camera_->viewportWidth), uint32_t(state.camera_->viewportHeight) };
-	if (!hdrImage_ || extent != hdrImage_->getExtent())
+	graph_->setDesc(hdr_, hdrDesc(extent, precision_));
+	if (extent.width != bloomExtent_.width || extent.height != bloomExtent_.height)
 	{
-		hdrBin_.push_back(std::make_pair(std::move(hdrImage_), maxFramesInFlight));
-		VkImageCreateInfo imageCI = CreateInfo::Image2DCI(extent, 1, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-		hdrImage_ = std::make_unique<Image>(device_, imageCI);
-		hdrImage_->attachImageView(hdrImage_->getFullRange());
-		VkSamplerCreateInfo samplerCI = CreateInfo::SamplerCI(1,
-			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER, 
-			VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, device_.deviceProperties.limits.maxSamplerAnisotropy);
-
-		hdrImage_->attachSampler(samplerCI);
-		hdrImage_->UndefinedToColorAttachment(commandBuffer);
-
-		DescriptorWrite writer;
-		writer.add(hdrSet, 0, 0, ImageType::CombinedSampler, 1, hdrImage_->getSampler(), hdrImage_->getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		writer.write(device_.device);
+		bloom_->resize(extent, getColorFormat(precision_));
+		bloomExtent_ = extent;
+		latestBloomValid_ = false;
 	}
+	// Blurred one frame late, unless there is no earlier bloom to composite meanwhile.
+	deferBloom_ = asyncCompute_ && latestBloomValid_;
+	bloom_->setSinglePass(singlePassBloom_);
+	frameSinglePassBloom_[frameCount_] = singlePassBloom_;
+	bloomTarget_ = (latestBloom_ + 1) % Bloom::targetCount;
 	
-	{ // Global UBO
-		GlobalUniform uniform{};
-		uniform.projection = state.camera_->calculateProjection();
-		uniform.view = state.camera_->calculateView();
-		uniform.viewPos = state.camera_->getPosition();
-		globalUniformBuffers_[frameCount_]->upload(&uniform, sizeof(uniform));
-	}
+	const auto& groups = std::get<Scene::PipelineGroups>(renderItems);
+	const auto& indirectParams = std::get<Scene::DrawParams>(renderItems);
+	const auto& commands = std::get<Scene::DrawCommands>(renderItems);
 
-	{ // Light
-		LightUpload upload{};
-		upload.count = static_cast<int32_t>(state.lights_.size());
-		lightBuffer[frameCount_]->upload(&upload, sizeof(upload));
-		lightBuffer[frameCount_]->upload(state.lights_.data(), state.lights_.size() * sizeof(Light), sizeof(upload));
+	// Per-frame data, sub-allocated from this frame's region of the upload ring.
+	const VkDeviceSize lightsSize = sizeof(LightUpload) + SizeInBytes(state.lights_);
+	uploadRing_->beginFrame(frameCount_,
+		uploadRing_->getAlignedSize(sizeof(GlobalUniform)) +
+		uploadRing_->getAlignedSize(SizeInBytes(indirectParams)) +
+		uploadRing_->getAlignedSize(lightsSize) +
+		uploadRing_->getAlignedSize(SizeInBytes(commands)));
+
+	bindless_->beginFrame(frameCount_);
+	frameDescriptors_[frameCount_].reset();
+	const VkDescriptorSet bindlessSet = bindless_->getSet();
+
+	if (globalSetGenerations_[frameCount_] != uploadRing_->getGeneration())
+	{
+		// Nothing in flight uses this frame's set anymore.
+		DescriptorWrite writer(&arena);
+		writer.add(globalSets_[frameCount_], 0, 0, BufferType::DynamicUniform, 1, uploadRing_->getBuffer(), 0, sizeof(GlobalUniform));
+		writer.add(globalSets_[frameCount_], 1, 0, BufferType::DynamicStorage, 1, uploadRing_->getBuffer(), 0, uploadRing_->getFrameSize());
+		writer.add(globalSets_[frameCount_], 2, 0, BufferType::DynamicStorage, 1, uploadRing_->getBuffer(), 0, uploadRing_->getFrameSize());
+		writer.write(device_.device);
+		globalSetGenerations_[frameCount_] = uploadRing_->getGeneration();
 	}
 
+	GlobalUniform uniform{};
+	uniform.projection = state.camera_->calculateProjection();
+	uniform.view = state.camera_->calculateView();
+	uniform.viewPos = state.camera_->getPosition();
+
+	LightUpload lightHeader{};
+	lightHeader.count = static_cast<int32_t>(state.lights_.size());
+	const VkDeviceSize lightsOffset = uploadRing_->allocate(lightsSize);
+	uploadRing_->write(lightsOffset, &lightHeader, sizeof(lightHeader));
+	uploadRing_->write(lightsOffset + sizeof(lightHeader), state.lights_.data(), SizeInBytes(state.lights_));
+
+	// In binding order: uniform, draw data, lights.
+	const std::array<uint32_t, 3> globalOffsets = {
+		static_cast<uint32_t>(uploadRing_->upload(&uniform, sizeof(uniform))),
+		static_cast<uint32_t>(uploadRing_->upload(indirectParams.data(), SizeInBytes(indirectParams))),
+		static_cast<uint32_t>(lightsOffset)
+	};
+	const VkDeviceSize commandsOffset = uploadRing_->upload(commands.data(), SizeInBytes(commands));
+
 	if (!skybox_)
 	{
-		skybox_ = std::make_unique<Skybox>(device_, scene_.getCubeBuffer());
+		skybox_ = std::make_unique<Skybox>(device_, getColorFormat(precision_));
 		skybox_->set(scene_.getCubeMap().getView(), scene_.getCubeMap().getSampler());
 	}
-	
-
-	const auto& groups = std::get<Scene::PipelineGroups>(renderItems);
-	const auto& indirectParams = std::get<Scene::DrawParams>(renderItems);
-	const auto& commands = std::get<Scene::DrawCommands>(renderItems);
-
-	indirectBuffer->upload(commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand));
-	perMeshDrawDataBuffer[frameCount_]->upload(indirectParams.data(), indirectParams.size() * sizeof(IndirectDrawParam));
 
-	// Begin Rendering (Opaque)
+	// Record in parallel. The frame's last submission was waited on in acquire, so its pools can be reset.
+	commandPools_->reset(frameCount_);
+
+	const VkFormat hdrFormat = getColorFormat(precision_);
+	VkCommandBufferInheritanceRenderingInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	inheritance.colorAttachmentCount = 1;
+	inheritance.pColorAttachmentFormats = &hdrFormat;
+	inheritance.depthAttachmentFormat = device_.getDepthFormat();
+	inheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Pipeline groups are split in contiguous batches, one per worker and pass.
+	const bool depthPrepass = depthPrepass_;
+	const size_t passCount = depthPrepass ? 2 : 1;
+	const size_t batchCount = std::min<size_t>(groups.size(), workers_.get_thread_count());
+	ArenaVector<VkCommandBuffer> opaqueBuffers{ arena };
+	opaqueBuffers.resize(passCount * batchCount + 1); // + skybox
+
+	for (size_t task = 0; task < passCount * batchCount; task++)
 	{
-		VkDebugUtilsLabelEXT label{};
-		label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
-		label.pLabelName = "Opaque";
-		vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+		workers_.detach_task([&, task]() {
+			const size_t batch = task % batchCount;
+			const bool depthOnly = depthPrepass && task < batchCount;
+			VkCommandBuffer secondary = commandPools_->begin(frameCount_, &inheritance);
+
+			VkViewport viewport = CreateInfo::Viewport(extent);
+			vkCmdSetViewport(secondary, 0, 1, &viewport);
+
+			VkRect2D scissor{};
+			scissor.extent = extent;
+			vkCmdSetScissor(secondary, 0, 1, &scissor);
+
+			size_t offset = 0;
+			VkBuffer vertexBuffer = depthOnly ? scene_.getPositionBuffer() : scene_.getVertexBuffer();
+			vkCmdBindVertexBuffers(secondary, 0, 1, &vertexBuffer, &offset);
+			vkCmdBindIndexBuffer(secondary, scene_.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindDescriptorSets(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &globalSets_[frameCount_], static_cast<uint32_t>(globalOffsets.size()), globalOffsets.data());
+			vkCmdBindDescriptorSets(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 1, 1, &bindlessSet, 0, nullptr);
+			vkCmdBindDescriptorSets(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 2, 1, &ibrSet, 0, nullptr);
+
+			const size_t first = batch * groups.size() / batchCount;
+			const size_t last = (batch + 1) * groups.size() / batchCount;
+			VkPipeline boundPipeline = VK_NULL_HANDLE;
+			for (size_t i = first; i < last; i++)
+			{
+				const auto& group = groups[i];
+				const VkPipeline pipeline = depthOnly ? group.second.depthPipeline : group.first;
+				if (pipeline == VK_NULL_HANDLE)
+				{
+					continue;
+				}
+				// Groups are sorted by pipeline, neighbours often differ only in dynamic state.
+				if (pipeline != boundPipeline)
+				{
+					vkCmdBindPipeline(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+					boundPipeline = pipeline;
+				}
+				if (!depthOnly)
+				{
+					// Already in the depth buffer, only the front-most surface passes.
+					const bool prepassed = depthPrepass && group.second.depthPipeline != VK_NULL_HANDLE;
+					vkCmdSetDepthCompareOp(secondary, prepassed ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS);
+					vkCmdSetDepthWriteEnable(secondary, !prepassed);
+				}
+				vkCmdSetCullMode(secondary, group.second.cullMode);
+				vkCmdSetPrimitiveTopology(secondary, group.second.topology);
+				vkCmdPushConstants(secondary, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &group.second.offset);
+				vkCmdDrawIndexedIndirect(secondary, uploadRing_->getBuffer(), commandsOffset + sizeof(VkDrawIndexedIndirectCommand) * group.second.offset, group.second.count, sizeof(VkDrawIndexedIndirectCommand));
+			}
 
-		Framebuffer framebuffer(extent);
-		framebuffer.addColorAttachment(hdrImage_->getView());
-		framebuffer.addDepthAttachment(depthView);
-		framebuffer.beginRendering(commandBuffer, {
-			{FramebufferType::Color, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, { 0.f, 0.f, 0.f, 1.f }},
-			{FramebufferType::Depth, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, { 1.0f, 0 }}
+			check(vkEndCommandBuffer(secondary));
+			opaqueBuffers[task] = secondary;
 		});
+	}
 
-		VkViewport viewport = CreateInfo::Viewport(extent);
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-		VkRect2D scissor{};
-		scissor.extent = extent;
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-		size_t offset = 0;
-		VkBuffer vertexBuffer = scene_.getVertexBuffer();
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
-		vkCmdBindIndexBuffer(commandBuffer, scene_.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &globalSets_[frameCount_], 0, nullptr);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 1, 1, &bindlessSet_, 0, nullptr);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 2, 1, &ibrSet, 0, nullptr);
-
-		for (const auto& group : groups)
-		{
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, group.first);
-			vkCmdPushConstants(commandBuffer, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &group.second.offset);
-			vkCmdDrawIndexedIndirect(commandBuffer, *indirectBuffer, sizeof(VkDrawIndexedIndirectCommand) * group.second.offset, group.second.count, sizeof(VkDrawIndexedIndirectCommand));
-		}
+	workers_.detach_task([&]() {
+		VkCommandBuffer secondary = commandPools_->begin(frameCount_, &inheritance);
+		skybox_->record(secondary, state.camera_->calculateProjection(), state.camera_->calculateView(), extent);
+		check(vkEndCommandBuffer(secondary));
+		opaqueBuffers[passCount * batchCount] = secondary;
+	});
 
-		framebuffer.endRendering(commandBuffer);
+	workers_.wait();
 
-		vkCmdEndDebugUtilsLabelEXT(commandBuffer);
-	}
+	frame_ = { extent, depthView, uniform.projection * uniform.view, { opaqueBuffers.data(), opaqueBuffers.size() } };
+	graph_->execute(commandBuffer);
 
 	/* Transparent is WIP
 
@@ -386,40 +455,221 @@ void Renderer::draw(VkCommandBuffer commandBuffer, VkImageView colorView, VkImag
 	}
 	*/
 
-	// infiniteGrid_->draw(commandBuffer, globalSets_[frameCount_], hdrImage_->getView(), depthView, extent);
+	//Transition::ShaderReadOptimalToColorAttachment(accum->get(), commandBuffer);
+	//Transition::ShaderReadOptimalToColorAttachment(reveal->get(), commandBuffer);
+}
 
-	skybox_->render(commandBuffer, state.camera_->calculateProjection(), state.camera_->calculateView(), hdrImage_->getView(), depthView, extent);
+bool Renderer::defersBloom() const
+{
+	return deferBloom_;
+}
 
-	bloom_->doBloom(commandBuffer, extent, hdrImage_->get(), hdrImage_->getView(), colorView);
-	/*
-	hdrImage_->ColorAttachmentToShaderReadOptimal(commandBuffer);
+void Renderer::composite(VkCommandBuffer commandBuffer, VkImageView colorView, VkImage depthImage)
+{
+	const uint32_t target = deferBloom_ ? latestBloom_ : bloomTarget_;
+	const bool grid = postProcess_->getGrid();
+	const VkImageSubresourceRange depthRange = { getDepthAspect(device_.getDepthFormat()), 0, 1, 0, 1 };
+	timer_->begin(commandBuffer, CompositeScope);
+
+	Image& hdr = graph_->getImage(hdr_);
+	BarrierBatch barriers;
+	barriers.transition(hdr, ImageUsage::Sampled);
+	const VkImageView bloomView = bloom_->useResult(barriers, target, device_.graphicsQueue);
+	if (grid)
+	{
+		barriers.transition(depthImage, depthRange, ImageUsage::DepthStencilAttachment, ImageUsage::Sampled);
+	}
+	barriers.flush(commandBuffer);
 
-	
-	{ // Draw to swapchain image
-		Framebuffer framebuffer(extent);
-		framebuffer.addColorAttachment(colorView);
-		framebuffer.beginRendering(commandBuffer, {
-			{FramebufferType::Color, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE, {}} //don't care as we are drawing over all pixels
-		});
+	postProcess_->record(commandBuffer, frameDescriptors_[frameCount_], { hdr.getView(), bloomView, frame_.depthView }, frame_.viewProjection, colorView, frame_.extent);
 
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, hdrPipeline_.layout, 0, 1, &hdrSet, 0, nullptr);
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, hdrPipeline_.pipeline);
-		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-		framebuffer.endRendering(commandBuffer);
+	if (grid)
+	{
+		// The next frame's scene expects it as an attachment.
+		barriers.transition(depthImage, depthRange, ImageUsage::Sampled, ImageUsage::DepthStencilAttachment);
+		barriers.flush(commandBuffer);
 	}
-	
+	timer_->end(commandBuffer, CompositeScope);
+}
 
-	hdrImage_->ShaderReadOptimalToColorAttachment(commandBuffer);
-	*/
+void Renderer::endFrame(Device::Ticket scene)
+{
+	if (deferBloom_)
+	{
+		VkCommandBuffer commandBuffer = computeCommandBuffers_[frameCount_];
+		check(vkResetCommandBuffer(commandBuffer, 0));
 
-	//Transition::ShaderReadOptimalToColorAttachment(accum->get(), commandBuffer);
-	//Transition::ShaderReadOptimalToColorAttachment(reveal->get(), commandBuffer);
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		check(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		timer_->begin(commandBuffer, BloomScope);
+		bloom_->blur(commandBuffer, frameDescriptors_[frameCount_], bloomTarget_, device_.computeQueue);
+		timer_->end(commandBuffer, BloomScope);
 
-	cleanupFrameDependentItems();
+		check(vkEndCommandBuffer(commandBuffer));
+		// The next frame's composite waits on this through the device's async tickets.
+		computeTickets_[frameCount_] = device_.submit(device_.computeQueue, commandBuffer, { &scene, 1 });
+	}
+	latestBloom_ = bloomTarget_;
+	latestBloomValid_ = true;
 
 	frameCount_ = (frameCount_ + 1) % maxFramesInFlight;
 }
 
+void Renderer::setAsyncCompute(bool enabled)
+{
+	asyncCompute_ = enabled;
+}
+
+bool Renderer::getAsyncCompute() const
+{
+	return asyncCompute_;
+}
+
+void Renderer::setDepthPrepass(bool enabled)
+{
+	depthPrepass_ = enabled;
+	scene_.setPositionStream(enabled);
+}
+
+bool Renderer::getDepthPrepass() const
+{
+	return depthPrepass_;
+}
+
+void Renderer::setSinglePassBloom(bool singlePass)
+{
+	singlePassBloom_ = singlePass;
+}
+
+bool Renderer::getSinglePassBloom() const
+{
+	return singlePassBloom_;
+}
+
+void Renderer::setHdrPrecision(HdrPrecision precision)
+{
+	if (precision == precision_)
+	{
+		return;
+	}
+	if (!supportsHdrPrecision(precision))
+	{
+		SPDLOG_WARN("HDR precision {} is not supported, keeping {}.", getName(precision), getName(precision_));
+		return;
+	}
+	// Frames in flight read the lighting set that is rewritten, and draw with the pipelines that are replaced.
+	check(vkDeviceWaitIdle(device_.device));
+	precision_ = precision;
+
+	scene_.setHdrPrecision(precision_);
+	if (skybox_)
+	{
+		skybox_->setColorFormat(getColorFormat(precision_));
+	}
+	// The HDR target follows its description at the next draw, the bloom targets are recreated with it.
+	bloomExtent_ = {};
+}
+
+HdrPrecision Renderer::getHdrPrecision() const
+{
+	return precision_;
+}
+
+bool Renderer::supportsHdrPrecision(HdrPrecision precision) const
+{
+	return device_.supportsFormat(getColorFormat(precision), hdrColorFeatures) &&
+		device_.supportsFormat(getLutFormat(precision), hdrLutFeatures);
+}
+
+void Renderer::setTonemap(PostProcess::Tonemap tonemap)
+{
+	postProcess_->setTonemap(tonemap);
+}
+
+PostProcess::Tonemap Renderer::getTonemap() const
+{
+	return postProcess_->getTonemap();
+}
+
+void Renderer::setExposure(float exposure)
+{
+	postProcess_->setExposure(exposure);
+}
+
+float Renderer::getExposure() const
+{
+	return postProcess_->getExposure();
+}
+
+void Renderer::setGrid(bool grid)
+{
+	if (grid && !supportsGrid())
+	{
+		SPDLOG_WARN("The depth format cannot be sampled, the grid stays off.");
+		return;
+	}
+	postProcess_->setGrid(grid);
+}
+
+bool Renderer::getGrid() const
+{
+	return postProcess_->getGrid();
+}
+
+bool Renderer::supportsGrid() const
+{
+	return device_.supportsFormat(device_.getDepthFormat(), VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_BIT);
+}
+
+Renderer::GpuTimings Renderer::getGpuTimings() const
+{
+	return timings_;
+}
+
+void Renderer::readTimings()
+{
+	timer_->beginFrame(frameCount_);
+	std::array<std::optional<Interval>, ScopeCount> intervals;
+	for (uint32_t scope = 0; scope < ScopeCount; scope++)
+	{
+		intervals[scope] = timer_->get(scope);
+	}
+	if (!intervals[SceneScope])
+	{
+		// Not drawn yet, or not timed at all.
+		return;
+	}
+
+	timings_.sceneMs = getLength(intervals[SceneScope]);
+	timings_.bloomMs = getLength(intervals[BloomScope]);
+	timings_.compositeMs = getLength(intervals[CompositeScope]);
+	if (intervals[BloomScope])
+	{
+		// Read back before draw records the frame again, so the mode is still the one it was timed with.
+		float& average = frameSinglePassBloom_[frameCount_] ? timings_.singlePassBloomMs : timings_.perLevelBloomMs;
+		average = average == 0.f ? timings_.bloomMs : average * 0.95f + timings_.bloomMs * 0.05f;
+	}
+	timings_.overlapMs = 0.f;
+	// A deferred blur starts after its frame's scene and is done before the next frame's composite.
+	if (previousIntervals_[BloomScope])
+	{
+		std::array<Interval, 4> graphics{};
+		uint32_t count = 0;
+		for (const auto& interval : { previousIntervals_[SceneScope], previousIntervals_[CompositeScope], intervals[SceneScope], intervals[CompositeScope] })
+		{
+			if (interval)
+			{
+				graphics[count++] = *interval;
+			}
+		}
+		timings_.overlapMs = static_cast<float>(covered(*previousIntervals_[BloomScope], { graphics.data(), count }));
+	}
+	previousIntervals_ = intervals;
+}
+
 VkShaderModule Renderer::getVertexModule() const
 {
 	return vertexShader_;
@@ -430,9 +680,9 @@ VkShaderModule Renderer::getFragmentModule() const
 	return fragmentShader_;
 }
 
-VkDescriptorSet Renderer::getImageSet() const
+BindlessTextures& Renderer::getBindlessTextures() const
 {
-	return bindlessSet_;
+	return *bindless_;
 }
 
 VkDescriptorSet Renderer::getIBRSet() const
@@ -445,31 +695,18 @@ VkPipelineLayout Renderer::getPipelineLayout() const
 	return pipelineLayout_;
 }
 
-void Renderer::cleanupFrameDependentItems()
-{
-	for (auto& frame : hdrBin_)
-	{
-		frame.second -= 1;
-	}
-	std::erase_if(hdrBin_, [](const std::pair<std::unique_ptr<Image>, int>& imagePair) {
-		return imagePair.second <= 0;
-	});
-}
-
 Renderer::~Renderer()
 {
-	hdrPipeline_.clear(device_.device);
-
-	vkDestroyShaderModule(device_.device, vertexShader_, nullptr);
-	vkDestroyShaderModule(device_.device, fragmentShader_, nullptr);
+	device_.registry.release(vertexShader_);
+	device_.registry.release(fragmentShader_);
 
 	vkDestroyPipelineLayout(device_.device, pipelineLayout_, nullptr);
 
-	vkDestroyDescriptorPool(device_.device, globalPool_, nullptr);
-	vkDestroyDescriptorPool(device_.device, bindlessPool, nullptr); 
-	vkDestroyDescriptorPool(device_.device, ibrPool, nullptr);
+	bindless_.reset();
+
+	vkDestroyCommandPool(device_.device, computePool_, nullptr);
 
-	vkDestroyDescriptorSetLayout(device_.device, globalSetLayout, nullptr);
-	vkDestroyDescriptorSetLayout(device_.device, bindlessSetLayout, nullptr);
-	vkDestroyDescriptorSetLayout(device_.device, ibrSetLayout, nullptr);
+	device_.registry.release(globalSetLayout);
+	device_.registry.release(bindlessSetLayout);
+	device_.registry.release(ibrSetLayout);
 }
@@ -2,73 +2,192 @@
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
+#include <array>
 #include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 #include "Scene.h"
+#include "Core/Device.h"
+#include "Core/DescriptorAllocator.h"
+#include "Core/GpuTimer.h"
+#include "Core/RenderGraph.h"
+#include "Render/HdrPrecision.h"
+#include "Render/PostProcess.h"
 
-class Device;
 class Image;
 class Buffer;
-class InfiniteGrid;
 class Skybox;
 class FlattenCubemap;
 class Bloom;
 class IrradianceCubemap;
 class PrefilterCubemap;
+class ThreadCommandPools;
+class UploadRing;
+class BindlessTextures;
 
 class Renderer
 {
 public:
-	Renderer(Device& device, Scene& scene);
-
-	void draw(VkCommandBuffer commandBuffer, VkImageView colorView, VkImageView depthView, const Scene::Drawbles& renderItems, const State& state);
+	Renderer(Device& device, Scene& scene, BS::thread_pool& workers);
+
+	/**
+	 * @brief Records the scene and its bloom, everything before the composite.
+	*/
+	void draw(VkCommandBuffer commandBuffer, VkImageView depthView, const Scene::Drawbles& renderItems, const State& state, LinearArena& arena);
+	/**
+	 * @return Whether the frame's blur is left to endFrame. The caller then submits what draw recorded before recording the rest,
+	 * so the blur runs on the compute queue while the rest of the frame and the next one's scene do on the graphics queue.
+	*/
+	bool defersBloom() const;
+	/**
+	 * @brief The final pass into colorView, a colour attachment of the swapchain, see PostProcess.
+	 * When the bloom is deferred, it is the one of the previous frame.
+	 * @param depthImage Of the view given to draw, sampled for the grid and left as a depth attachment again.
+	*/
+	void composite(VkCommandBuffer commandBuffer, VkImageView colorView, VkImage depthImage);
+	/**
+	 * @brief Call once the frame is submitted.
+	 * @param scene The submission of what draw recorded, which a deferred blur waits on. Ignored otherwise.
+	*/
+	void endFrame(Device::Ticket scene);
+
+	/**
+	 * @brief Takes effect at the next draw. Bloom is then blurred on the compute queue and lags a frame behind the scene.
+	*/
+	void setAsyncCompute(bool enabled);
+	bool getAsyncCompute() const;
+	/**
+	 * @brief Takes effect at the next draw. Opaque geometry is first drawn depth only from the position stream,
+	 * then shaded with an equal depth test, so each pixel is shaded once. What discards is left to the colour pass.
+	 * The position stream only exists while enabled, see Scene::setPositionStream.
+	*/
+	void setDepthPrepass(bool enabled);
+	bool getDepthPrepass() const;
+	/**
+	 * @brief Takes effect at the next draw, see Bloom::setSinglePass.
+	*/
+	void setSinglePassBloom(bool singlePass);
+	bool getSinglePassBloom() const;
+	/**
+	 * @brief Takes effect right away: waits for the device to go idle, recreates the pipelines that render to the HDR target
+	 * and regenerates the lighting maps. The HDR and bloom targets follow at the next draw. Kept as is when unsupported.
+	*/
+	void setHdrPrecision(HdrPrecision precision);
+	HdrPrecision getHdrPrecision() const;
+	bool supportsHdrPrecision(HdrPrecision precision) const;
+
+	/**
+	 * @brief Take effect at the next composite, see PostProcess.
+	*/
+	void setTonemap(PostProcess::Tonemap tonemap);
+	PostProcess::Tonemap getTonemap() const;
+	void setExposure(float exposure);
+	float getExposure() const;
+	/**
+	 * @brief Kept off when the depth format cannot be sampled.
+	*/
+	void setGrid(bool grid);
+	bool getGrid() const;
+	bool supportsGrid() const;
+
+	struct GpuTimings
+	{
+		float sceneMs;
+		float bloomMs; // Downsampling and upsampling, on whichever queue ran it.
+		float compositeMs;
+		float overlapMs; // Of the bloom, what ran while the graphics queue drew this frame or the next.
+		// Of the bloom, averaged over the frames blurred each way. Zero until one is.
+		float perLevelBloomMs;
+		float singlePassBloomMs;
+	};
+	/**
+	 * @return Of a frame that has retired, zero for what the device cannot time.
+	*/
+	GpuTimings getGpuTimings() const;
 
 	// TODO: remove this
 	VkShaderModule getVertexModule() const;
 	VkShaderModule getFragmentModule() const;
-	VkDescriptorSet getImageSet() const;
+	BindlessTextures& getBindlessTextures() const;
 	VkDescriptorSet getIBRSet() const;
 	VkPipelineLayout getPipelineLayout() const;
 
-	void cleanupFrameDependentItems();
-
 	~Renderer();
 private:
 	Device& device_;
 	Scene& scene_;
+	BS::thread_pool& workers_;
+
+	// Secondary command buffers recorded on the workers.
+	std::unique_ptr<ThreadCommandPools> commandPools_;
 
 	VkShaderModule vertexShader_{}; // For testing
 	VkShaderModule fragmentShader_{};
 
 	VkDescriptorSetLayout ibrSetLayout{};
-	VkDescriptorPool ibrPool{};
 	VkDescriptorSet ibrSet{};
 
-	std::vector<std::unique_ptr<Buffer>> perMeshDrawDataBuffer;
-	std::vector<std::unique_ptr<Buffer>> lightBuffer;
-	std::unique_ptr<Buffer> indirectBuffer{};
+	// Uniform, draw data, lights and indirect commands of every frame.
+	std::unique_ptr<UploadRing> uploadRing_;
 
-	VkDescriptorPool globalPool_{};
 	VkDescriptorSetLayout globalSetLayout{};
 
-	VkDescriptorPool bindlessPool{};
 	VkDescriptorSetLayout bindlessSetLayout{};
+	std::unique_ptr<BindlessTextures> bindless_;
 
 	VkPipelineLayout pipelineLayout_{};
 
-	std::unique_ptr<Image> hdrImage_;
-	VkDescriptorSet hdrSet;
-
-	PipelineInfo<1> hdrPipeline_;
-	std::vector <std::pair<std::unique_ptr<Image>, int>> hdrBin_;
-
 	std::unique_ptr<Bloom> bloom_;
+	std::unique_ptr<PostProcess> postProcess_;
+	VkExtent2D bloomExtent_{};
+	uint32_t bloomTarget_ = 0; // Written by the frame being drawn.
+	uint32_t latestBloom_ = 0; // Last blurred, or being blurred on the compute queue.
+	bool latestBloomValid_ = false; // Not since the targets were recreated.
+
+	bool asyncCompute_ = false;
+	bool depthPrepass_ = false;
+	bool deferBloom_ = false; // Of the frame being drawn.
+	bool singlePassBloom_ = true;
+	HdrPrecision precision_ = HdrPrecision::Half; // As the scene's.
+	std::vector<bool> frameSinglePassBloom_; // How each frame in flight blurs, to tell its timings apart.
+	// Deferred blurs, per frame in flight.
+	VkCommandPool computePool_{};
+	std::vector<VkCommandBuffer> computeCommandBuffers_;
+	std::vector<Device::Ticket> computeTickets_;
+
+	enum TimerScope : uint32_t
+	{
+		SceneScope,
+		BloomScope,
+		CompositeScope,
+		ScopeCount
+	};
+	std::unique_ptr<GpuTimer> timer_;
+	std::array<std::optional<Interval>, ScopeCount> previousIntervals_; // Of the frame before the one last read back.
+	GpuTimings timings_{};
+	/**
+	 * @brief Reads back the timestamps of the frame that last used frameCount_.
+	*/
+	void readTimings();
+
+	// Built once, the passes record from frame_.
+	std::unique_ptr<RenderGraph> graph_;
+	RenderGraph::Resource hdr_{};
+
+	// What the passes of the frame being drawn need.
+	struct FrameContext
+	{
+		VkExtent2D extent;
+		VkImageView depthView;
+		glm::mat4 viewProjection;
+		std::span<const VkCommandBuffer> opaqueBuffers; // Recorded on the workers, the depth pre-pass first and the skybox last.
+	} frame_{};
 
-	std::vector<std::unique_ptr<Buffer>> globalUniformBuffers_;
 	std::vector<VkDescriptorSet> globalSets_;
-	VkDescriptorSet bindlessSet_{};
+	std::vector<uint32_t> globalSetGenerations_; // Upload ring generation each set points at.
+	std::vector<DescriptorAllocator> frameDescriptors_; // Per frame in flight.
 
-	std::unique_ptr<InfiniteGrid> infiniteGrid_;
 	std::unique_ptr<Skybox> skybox_;
 
 	uint32_t frameCount_ = 0;
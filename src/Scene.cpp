@@ -15,7 +15,13 @@
 #include <volk.h>
 #include "Light.h"
 #include <stb_image.h>
+#include <BS_thread_pool.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <tuple>
 #include "Core/DescriptorWrite.h"
+#include "Core/BindlessTextures.h"
+#include "Shaders/Depth.vert.h"
 
 namespace {
 	template<class T>
@@ -215,15 +221,49 @@ namespace {
 	}
 
 
+	VkPrimitiveTopology getTopologyClass(VkPrimitiveTopology topology)
+	{
+		switch (topology)
+		{
+		case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+			return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+		case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+			return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+		default:
+			return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		}
+	}
+
+	constexpr std::array topologyClasses = { VK_PRIMITIVE_TOPOLOGY_POINT_LIST, VK_PRIMITIVE_TOPOLOGY_LINE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+
+	size_t getTopologyClassIndex(VkPrimitiveTopology topologyClass)
+	{
+		return std::find(topologyClasses.begin(), topologyClasses.end(), topologyClass) - topologyClasses.begin();
+	}
+
 	struct SpecializationData
 	{
 		VkBool32 alphaMask;
-		float alphaMaskCutoff;
 	};
 
+	// Occluders are rasterized on the CPU every frame, larger meshes occlude with their largest triangles.
+	constexpr size_t maxOccluderTriangles = 4096;
+
+	MaterialCharacteristic getCharacteristic(const tinygltf::Material& material, const tinygltf::Primitive& primitive)
+	{
+		MaterialCharacteristic characteristic{};
+		characteristic.topologyClass = getTopologyClass(getMode(primitive.mode));
+		characteristic.alphaMask = material.alphaMode == "MASK";
+		return characteristic;
+	}
+
+	// Triangles without alpha test, drawn by any triangle mesh whose own pipeline is still compiling.
+	constexpr MaterialCharacteristic fallbackCharacteristic{ .topologyClass = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, .alphaMask = false };
+
 }
 
-Scene::Scene(Device& device) : device_(device)
+Scene::Scene(Device& device, BS::thread_pool& workers) : device_(device), workers_(workers)
 {
 	maxFramesInFlight = device.getMaxFramesInFlight();
 
@@ -244,6 +284,7 @@ Scene::Scene(Device& device) : device_(device)
 	vertexBuffer = std::make_unique<Buffer>(device_, vertexBufferSize,
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
 		//VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | 
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | // Positions are copied out for the depth pre-pass.
 		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
 	indexBuffer = std::make_unique<Buffer>(device_, indexBufferSize,
@@ -257,8 +298,10 @@ Scene::Scene(Device& device) : device_(device)
 	cubeBuffer_->upload(cubeVertices.data(), cubeSize);
 
 	flattenCubemap_ = std::make_unique<FlattenCubemap>(device_, cubeBuffer_);
-	irradianceCubemap_ = std::make_unique<IrradianceCubemap>(device_, cubeBuffer_);
-	prefilterCubemap_ = std::make_unique<PrefilterCubemap>(device_, cubeBuffer_);
+	irradianceCubemap_ = std::make_unique<IrradianceCubemap>(device_);
+	prefilterCubemap_ = std::make_unique<PrefilterCubemap>(device_);
+
+	culler_ = std::make_unique<OcclusionCuller>();
 
 	// Compositing Pipeline
 	/*
@@ -351,7 +394,7 @@ Scene::Scene(Device& device) : device_(device)
 
 		Connect(pipelineCreateInfo, rendering);
 
-		check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		check(device_.createGraphicsPipelines(1, &pipelineCreateInfo, &pipeline));
 		return pipeline;
 	}();
 
@@ -386,7 +429,7 @@ Scene::Scene(Device& device) : device_(device)
 	*/
 }
 
-void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkShaderModule fragmentShader, VkDescriptorSet imageSet, VkPipelineLayout layout)
+void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkShaderModule fragmentShader, BindlessTextures& bindless, VkPipelineLayout layout)
 {
 	tinygltf::Model model;
 	{
@@ -409,9 +452,55 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 		check(ret);
 	}
 
-	Buffer stagingBuffer(device_, 16ull * 1024ull * 1024ull,
+	pipelineSource_ = { vertexShader, fragmentShader, layout };
+	if (!fallbackPipeline_)
+	{
+		fallbackPipeline_ = createOpaquePipeline(fallbackCharacteristic);
+	}
+	if (device_.supportsGraphicsPipelineLibrary() && !libraries_.preRasterization)
+	{
+		createOpaqueLibraries();
+	}
+	if (!depthPipelines_[0])
+	{
+		createDepthPipelines();
+	}
+
+	{ // Every variant the file needs is compiled in parallel before the meshes are built, or fast-linked when libraries are available.
+		auto s = Bench::record();
+		size_t variantCount = 0;
+		for (const auto& mesh : model.meshes)
+		{
+			for (const auto& primitive : mesh.primitives)
+			{
+				const auto characteristic = getCharacteristic(model.materials[primitive.material], primitive);
+				if (!pipelines.contains(characteristic))
+				{
+					requestPipeline(characteristic);
+					variantCount++;
+				}
+			}
+		}
+		if (libraries_.preRasterization)
+		{
+			// Fast-linked variants are usable right away, optimized links keep going in the background.
+			auto e = Bench::record();
+			SPDLOG_INFO("Fast-linked {} pipeline variants in {}ms.", variantCount, Bench::diff<float>(s, e));
+		}
+		else
+		{
+			compiles_.wait();
+			auto e = Bench::record();
+			SPDLOG_INFO("Compiled {} pipeline variants in {}ms on {} threads.", variantCount, Bench::diff<float>(s, e), compiles_.getThreadCount());
+		}
+	}
+
+	constexpr VkDeviceSize stagingSize = 16ull * 1024ull * 1024ull;
+	Buffer stagingBuffer(device_, stagingSize,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
 		VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+	// The last copy out of stagingBuffer.
+	Device::Ticket staged{};
 
 	// Gather hints
 	std::unordered_map<int, FormatUsageHint> hints{};
@@ -436,9 +525,8 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 		insertHint(material.pbrMetallicRoughness.metallicRoughnessTexture.index, FormatUsageHint::UNORM);
 	}
 
-	// Load textures
-	std::vector<VkDescriptorImageInfo> descImageInfos{};
-	const uint32_t startingElement = textures.size();
+	// Load textures, each gets a slot in the bindless array. Materials refer to them by the file's texture index.
+	std::vector<int> textureSlots(model.textures.size(), -1);
 
 	for (size_t i = 0; i < model.textures.size(); i++)
 	{
@@ -482,33 +570,23 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 		Buffer stagingBuffer(device_, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 		stagingBuffer.upload(image.image.data(), imageSize);
 
-		CreateInfo::performOneTimeAction(device_.device, device_.graphicsQueue.queue, device_.graphicsPool, [&](VkCommandBuffer commandBuffer) {
-			Transition::UndefinedToTransferDestination(ptr->get(), commandBuffer, range);
+		// The next texture is decoded while this one uploads, the staging buffer is destroyed once the copy has completed.
+		device_.submitOneTime(device_.graphicsQueue, [&](VkCommandBuffer commandBuffer) {
+			ptr->transition(commandBuffer, ImageUsage::TransferDestination);
 
 			ptr->upload(commandBuffer, stagingBuffer);
 
-			Image::generateMipmaps(ptr->get(), image.width, image.height, mipLevels, commandBuffer);
+			ptr->generateMaxMipmaps(commandBuffer);
 		});
 
-		VkDescriptorImageInfo descImageInfo{};
-		descImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		descImageInfo.imageView = ptr->getView();
-		descImageInfo.sampler = ptr->getSampler();
-		descImageInfos.push_back(descImageInfo);
+		textureSlots[i] = static_cast<int>(bindless.add(ptr->getView(), ptr->getSampler()).id);
 
 		textures.push_back(std::move(ptr));
 	}
-
-	VkWriteDescriptorSet writeSet{};
-	writeSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	writeSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	writeSet.descriptorCount = descImageInfos.size();
-	writeSet.dstArrayElement = startingElement;
-	writeSet.dstBinding = 1;
-	writeSet.pImageInfo = descImageInfos.data();
-	writeSet.dstSet = imageSet;
-
-	vkUpdateDescriptorSets(device_.device, 1, &writeSet, 0, nullptr);
+	bindless.flush();
+	const auto getTextureSlot = [&](int texture) {
+		return texture >= 0 ? textureSlots[texture] : -1;
+	};
 /*
 	const auto transparentPipeline = [&](bool doubleSided, int mode) {
 		VkPipeline pipeline;
@@ -607,6 +685,7 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 				const auto& material = model.materials[primitive.material];
 
 				std::vector<StaticVertex> vertices{};
+				std::vector<glm::vec3> positions{};
 				std::vector<uint32_t> indices{};
 
 				BufferHelper<float> position{ model, primitive, "POSITION" };
@@ -614,6 +693,7 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 				BufferHelper<float> tangent{ model, primitive, "TANGENT" };
 				BufferHelper<float> uv{ model, primitive, "TEXCOORD_0" };
 
+				BoundingBox bounds{};
 				for (size_t i = 0; i < position.count; i++)
 				{
 					StaticVertex vertex{};
@@ -622,6 +702,8 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 					vertex.tangent = tangent.ptr ? glm::make_vec4(&tangent.ptr[tangent.stride * i]) : glm::vec4(1.0f);
 					vertex.uv = uv.ptr ? glm::make_vec2(&uv.ptr[uv.stride * i]) : glm::vec2();
 					vertices.push_back(vertex);
+					positions.push_back(vertex.position);
+					bounds.expand(vertex.position);
 				}
 
 				check(primitive.indices >= 0);
@@ -629,6 +711,7 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 				index.deposit(indices);
 
 				const auto verticesSize = SizeInBytes(vertices);
+				const auto positionsSize = SizeInBytes(positions);
 				const auto indicesSize = SizeInBytes(indices);
 
 				VkDeviceSize vertexSizeOffset;
@@ -636,36 +719,59 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 				const auto vertexAlloc = performAllocation(virtualVertex_, verticesSize, vertexSizeOffset);
 				const auto indicesAlloc = performAllocation(virtualIndices_, indicesSize, indicesSizeOffset);
 
+				const auto firstIndex = static_cast<uint32_t>(indicesSizeOffset / sizeof(uint32_t));
+				const auto vertexOffset = static_cast<int32_t>(vertexSizeOffset / sizeof(StaticVertex));
+
+				vertexHighWater_ = std::max(vertexHighWater_, vertexSizeOffset + verticesSize);
+
+				// The previous primitive's copy overlapped building this one's vertices, it must be done before the staging buffer is overwritten.
+				check(verticesSize + indicesSize + positionsSize <= stagingSize, "Primitive does not fit the staging buffer!");
+				device_.wait(staged);
 				stagingBuffer.upload(vertices.data(), verticesSize);
-				CreateInfo::performOneTimeAction(device_.device, device_.transferQueue.queue, device_.transferPool, [&](VkCommandBuffer commandBuffer) {
+				stagingBuffer.upload(indices.data(), indicesSize, verticesSize);
+				if (positionBuffer)
+				{
+					reservePositions(vertexHighWater_ / sizeof(StaticVertex));
+					stagingBuffer.upload(positions.data(), positionsSize, verticesSize + indicesSize);
+				}
+				staged = device_.submitOneTime(device_.transferQueue, [&](VkCommandBuffer commandBuffer) {
 					stagingBuffer.copy(*vertexBuffer, commandBuffer, verticesSize, vertexSizeOffset, 0);
+					stagingBuffer.copy(*indexBuffer, commandBuffer, indicesSize, indicesSizeOffset, verticesSize);
+					if (positionBuffer)
+					{
+						stagingBuffer.copy(*positionBuffer, commandBuffer, positionsSize, vertexOffset * sizeof(glm::vec3), verticesSize + indicesSize);
+					}
 				});
 
-				stagingBuffer.upload(indices.data(), indicesSize);
-				CreateInfo::performOneTimeAction(device_.device, device_.transferQueue.queue, device_.transferPool, [&](VkCommandBuffer commandBuffer) {
-					stagingBuffer.copy(*indexBuffer, commandBuffer, indicesSize, indicesSizeOffset, 0);
-				});
-
-				const auto firstIndex = static_cast<uint32_t>(indicesSizeOffset / sizeof(uint32_t));
-				const auto vertexOffset = static_cast<int32_t>(vertexSizeOffset / sizeof(StaticVertex));
-
 				const auto indexCount = static_cast<uint32_t>(indices.size());
 
-				const auto colorId = material.pbrMetallicRoughness.baseColorTexture.index;
-				const auto normalId = material.normalTexture.index;
-				const auto mroId = material.pbrMetallicRoughness.metallicRoughnessTexture.index;
-				const auto emissiveId = material.emissiveTexture.index;
+				const auto colorId = getTextureSlot(material.pbrMetallicRoughness.baseColorTexture.index);
+				const auto normalId = getTextureSlot(material.normalTexture.index);
+				const auto mroId = getTextureSlot(material.pbrMetallicRoughness.metallicRoughnessTexture.index);
+				const auto emissiveId = getTextureSlot(material.emissiveTexture.index);
 				
 				const auto transparent = false; //material.alphaMode == "BLEND";
 
-				MaterialCharacteristic matCh{};
-				matCh.doubleSided = material.doubleSided;
-				matCh.mode = primitive.mode;
-				matCh.alphaMask = material.alphaMode == "MASK";
-				matCh.alphaMaskCutoff = material.alphaCutoff;
+				const MaterialCharacteristic matCh = getCharacteristic(material, primitive);
 				
 				// Pipeline
-				VkPipeline pipeline = getOrCreatePipeline(matCh, vertexShader, fragmentShader, imageSet, layout);
+				const PipelineVariant& pipeline = requestPipeline(matCh);
+
+				// Masked or blended surfaces have holes, so they cannot hide anything.
+				std::vector<glm::vec3> occluderPositions{};
+				std::vector<uint32_t> occluderIndices{};
+				const bool occluder = primitive.mode == TINYGLTF_MODE_TRIANGLES && !matCh.alphaMask && !transparent;
+				if (occluder && indices.size() / 3 <= maxOccluderTriangles)
+				{
+					occluderPositions = positions;
+					occluderIndices = indices;
+				}
+				else if (occluder)
+				{
+					auto proxy = simplifyOccluder(positions.data(), indices.data(), indices.size(), maxOccluderTriangles);
+					occluderPositions = std::move(proxy.positions);
+					occluderIndices = std::move(proxy.indices);
+				}
 			
 				gpuMesh->submeshes.push_back(Submesh{
 					.vertexAlloc = vertexAlloc,
@@ -674,12 +780,20 @@ void Scene::loadGLTF(const std::string& path, VkShaderModule vertexShader, VkSha
 					.firstIndex = firstIndex,
 					.vertexOffset = vertexOffset,
 					
-					.pipeline = pipeline,
+					.pipeline = &pipeline,
+					.cullMode = VkCullModeFlags(material.doubleSided ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE),
+					.topology = getMode(primitive.mode),
 					.colorId = colorId,
 					.normalId = normalId,
 					.mroId = mroId,
 					.emissiveId = emissiveId,
-					.transparent = transparent
+					.alphaCutoff = static_cast<float>(material.alphaCutoff),
+					.alphaMask = matCh.alphaMask,
+					.transparent = transparent,
+
+					.bounds = bounds,
+					.occluderPositions = std::move(occluderPositions),
+					.occluderIndices = std::move(occluderIndices)
 				});
 				
 			}
@@ -740,112 +854,205 @@ void Scene::loadCubeMap(const std::string& path, VkDescriptorSet ibrSet)
 	img->attachImageView(img->getFullRange());
 	img->attachSampler(samplerInfo);
 
-	std::vector<VkImageView> temp;
-	
-	CreateInfo::performOneTimeAction(device_.device, device_.graphicsQueue.queue, device_.graphicsPool, [&](VkCommandBuffer commandBuffer) {
-		img->UndefinedToTransferDestination(commandBuffer);
+	const Device::Ticket flattened = device_.submitOneTime(device_.graphicsQueue, [&](VkCommandBuffer commandBuffer) {
+		img->transition(commandBuffer, ImageUsage::TransferDestination);
 		img->upload(commandBuffer, stagingBuffer);
 		img->generateMaxMipmaps(commandBuffer);
 
 		cubeMap_ = flattenCubemap_->convert(commandBuffer, img.get(), 1024);
-		cubeMap_->ColorAttachmentToTransferDestination(commandBuffer);
-		cubeMap_->generateMaxCubeMipmaps(commandBuffer);
+		cubeMap_->transition(commandBuffer, ImageUsage::TransferDestination);
+		cubeMap_->generateMaxMipmaps(commandBuffer);
+	});
+	setName(device_.device, cubeMap_->get(), path);
 
-		irradianceMap_ = irradianceCubemap_->convert(commandBuffer, cubeMap_.get(), 32); // 32 by 32 irradiance
-		prefilterMap_ = prefilterCubemap_->precomputeFilter(commandBuffer, cubeMap_.get(), 128, temp); // 128 by 128 prefilter
-		brdfMap_ = prefilterCubemap_->precomputerBRDF(commandBuffer, 512, 512);
+	ibrSet_ = ibrSet;
+	precomputeLighting({ &flattened, 1 });
+	auto e = Bench::record();
+	SPDLOG_INFO("Cubemap recorded in {}ms.", Bench::diff<float>(s, e));
+}
 
-		irradianceMap_->ColorAttachmentToShaderReadOptimal(commandBuffer);
-		prefilterMap_->ColorAttachmentToShaderReadOptimal(commandBuffer);
-		brdfMap_->ColorAttachmentToShaderReadOptimal(commandBuffer);
+void Scene::precomputeLighting(std::span<const Device::Ticket> waits)
+{
+	const VkFormat format = getColorFormat(precision_);
+	std::vector<VkImageView> temp;
+
+	device_.submitOneTime(device_.graphicsQueue, [&](VkCommandBuffer commandBuffer) {
+		brdfMap_ = prefilterCubemap_->precomputerBRDF(commandBuffer, 512, 512, getLutFormat(precision_));
+		brdfMap_->transition(commandBuffer, ImageUsage::Sampled);
 	});
 
-	auto e = Bench::record();
-	SPDLOG_INFO("Cubemap took: {}ms.", Bench::diff<float>(s, e));
+	// The convolutions run on the compute queue, alongside whatever the graphics queue is busy with.
+	const Device::Ticket convolved = device_.submitOneTime(device_.computeQueue, [&](VkCommandBuffer commandBuffer) {
+		BarrierBatch::handOver(*cubeMap_);
+		cubeMap_->transition(commandBuffer, ImageUsage::ComputeSampled);
 
-	// temp is ready to clear
-	for (const auto& t : temp)
+		irradianceMap_ = irradianceCubemap_->convert(commandBuffer, cubeMap_.get(), 32, format, temp); // 32 by 32 irradiance
+		prefilterMap_ = prefilterCubemap_->precomputeFilter(commandBuffer, cubeMap_.get(), 128, format, temp); // 128 by 128 prefilter
+	}, waits);
+	for (Image* image : { cubeMap_.get(), irradianceMap_.get(), prefilterMap_.get() })
 	{
-		vkDestroyImageView(device_.device, t, nullptr);
+		BarrierBatch::handOver(*image);
 	}
+	// Frames only wait on the compute queue at the end, everything submitted to graphics from here on waits on the maps.
+	device_.submit(device_.graphicsQueue, VK_NULL_HANDLE, { &convolved, 1 });
 
-	setName(device_.device, cubeMap_->get(), path);
+	// The convolutions read these on the GPU, they are destroyed once it has completed.
+	device_.release([&device = device_, temp = std::move(temp)]() {
+		for (const auto& t : temp)
+		{
+			vkDestroyImageView(device.device, t, nullptr);
+		}
+	});
 
 	DescriptorWrite writer;
-	writer.add(ibrSet, 0, 0, ImageType::CombinedSampler, 1, irradianceMap_->getSampler(), irradianceMap_->getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	writer.add(ibrSet, 1, 0, ImageType::CombinedSampler, 1, prefilterMap_->getSampler(), prefilterMap_->getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	writer.add(ibrSet, 2, 0, ImageType::CombinedSampler, 1, brdfMap_->getSampler(), brdfMap_->getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	writer.add(ibrSet_, 0, 0, ImageType::CombinedSampler, 1, irradianceMap_->getSampler(), irradianceMap_->getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	writer.add(ibrSet_, 1, 0, ImageType::CombinedSampler, 1, prefilterMap_->getSampler(), prefilterMap_->getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	writer.add(ibrSet_, 2, 0, ImageType::CombinedSampler, 1, brdfMap_->getSampler(), brdfMap_->getView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	writer.write(device_.device);
 }
 
-Scene::Drawbles Scene::getDrawables() const
+Scene::Drawbles Scene::getDrawables(const glm::mat4& viewProjection, LinearArena& arena)
 {
-	// Group stuff
-	
+	// Gather stuff
 	struct RenderObject
 	{
 		glm::mat4 model;
 		const Submesh* submesh;
+		VkPipeline pipeline;
 	};
-	std::unordered_map<VkPipeline, std::vector<RenderObject>> grouping;
+	ArenaVector<RenderObject> objects{ arena };
 
-	const auto group = [&](const auto& groupFn, const std::unique_ptr<Node>& node, glm::mat4 parent) -> void {
+	const auto gather = [&](const auto& gatherFn, const std::unique_ptr<Node>& node, glm::mat4 parent) -> void {
 		glm::mat4 model = parent * node->getMatrix();
 		if (node->mesh)
 		{
 			for (const auto& submesh : node->mesh->submeshes)
 			{
-				auto& group = grouping[submesh.pipeline];
-				group.push_back(RenderObject{ .model = model, .submesh = &submesh });
+				// Triangles are drawn with the fallback until their own pipeline has compiled, points and lines wait.
+				VkPipeline pipeline = submesh.pipeline->pipeline.load(std::memory_order_acquire);
+				if (!pipeline && getTopologyClass(submesh.topology) == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+				{
+					pipeline = fallbackPipeline_;
+				}
+				if (pipeline)
+				{
+					objects.push_back(RenderObject{ .model = model, .submesh = &submesh, .pipeline = pipeline });
+				}
 			}
 		}
 
 		for (const auto& child : node->childrens)
 		{
-			groupFn(groupFn, child, model);
+			gatherFn(gatherFn, child, model);
 		}
 	};
 
 	for (const auto& node : nodes)
 	{
-		group(group, node, glm::mat4(1.0f));
+		gather(gather, node, glm::mat4(1.0f));
 	}
 
-	std::vector<IndirectDrawParam> indirectParams;
-	std::vector<VkDrawIndexedIndirectCommand> commands;
-	PipelineGroups opaqueGroup;
-
-	size_t objectCounter = 0;
-	for (const auto& group : grouping)
+	// Cull stuff
+	ArenaVector<uint8_t> visible(objects.size(), 1, arena);
+	if (occlusionCulling_)
 	{
-		const size_t groupOffset = objectCounter;
-		size_t groupCounter = 0;
-		for (const auto& object : group.second)
+		culler_->begin(viewProjection);
+		for (const auto& object : objects)
 		{
-			IndirectDrawParam param{};
-			param.model = object.model;
-			param.colorId = object.submesh->colorId;
-			param.normalId = object.submesh->normalId;
-			param.mroId = object.submesh->mroId;
-			param.emissiveId = object.submesh->emissiveId;
-			indirectParams.push_back(param);
+			const auto& submesh = *object.submesh;
+			if (!submesh.occluderIndices.empty())
+			{
+				culler_->addOccluder(submesh.occluderPositions.data(), submesh.occluderIndices.data(), submesh.occluderIndices.size(), object.model);
+			}
+		}
+		culler_->rasterize(&workers_);
 
-			VkDrawIndexedIndirectCommand command{};
-			command.firstIndex = object.submesh->firstIndex;
-			command.firstInstance = 0;
-			command.indexCount = object.submesh->indexCount;
-			command.instanceCount = 1;
-			command.vertexOffset = object.submesh->vertexOffset;
-			commands.push_back(command);
+		workers_.detach_loop(size_t(0), objects.size(), [&](size_t i) {
+			const auto& bounds = objects[i].submesh->bounds;
+			visible[i] = !bounds.valid() || culler_->isVisible(bounds, objects[i].model);
+		});
+		workers_.wait();
+	}
 
-			groupCounter++;
+	// Group stuff, sorting by pipeline keeps each group contiguous without a map of vectors.
+	ArenaVector<const RenderObject*> sorted{ arena };
+	sorted.reserve(objects.size());
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		if (visible[i])
+		{
+			sorted.push_back(&objects[i]);
 		}
+	}
+	const auto drawState = [](const RenderObject* object) {
+		return std::make_tuple(object->pipeline, object->submesh->cullMode, object->submesh->topology);
+	};
+	std::sort(sorted.begin(), sorted.end(), [&](const RenderObject* a, const RenderObject* b) {
+		return drawState(a) < drawState(b);
+	});
+
+	DrawParams indirectParams{ arena };
+	DrawCommands commands{ arena };
+	PipelineGroups opaqueGroup{ arena };
+	indirectParams.reserve(sorted.size());
+	commands.reserve(sorted.size());
 
-		opaqueGroup[group.first] = { .offset = static_cast<uint32_t>(groupOffset), .count = static_cast<uint32_t>(groupCounter) };
-		objectCounter += groupCounter;
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		const auto* object = sorted[i];
+		if (i == 0 || drawState(sorted[i - 1]) != drawState(object))
+		{
+			// The fallback never discards, whatever the material. Every other pipeline is the same variant for the whole group.
+			const bool discards = object->pipeline != fallbackPipeline_ && object->submesh->alphaMask;
+			opaqueGroup.push_back({ object->pipeline, DrawCall{
+				.offset = static_cast<uint32_t>(i),
+				.count = 0,
+				.cullMode = object->submesh->cullMode,
+				.topology = object->submesh->topology,
+				.depthPipeline = discards ? VK_NULL_HANDLE : depthPipelines_[getTopologyClassIndex(getTopologyClass(object->submesh->topology))]
+			} });
+		}
+		opaqueGroup.back().second.count++;
+
+		IndirectDrawParam param{};
+		param.model = object->model;
+		param.colorId = object->submesh->colorId;
+		param.normalId = object->submesh->normalId;
+		param.mroId = object->submesh->mroId;
+		param.emissiveId = object->submesh->emissiveId;
+		param.alphaCutoff = object->submesh->alphaCutoff;
+		indirectParams.push_back(param);
+
+		VkDrawIndexedIndirectCommand command{};
+		command.firstIndex = object->submesh->firstIndex;
+		command.firstInstance = 0;
+		command.indexCount = object->submesh->indexCount;
+		command.instanceCount = 1;
+		command.vertexOffset = object->submesh->vertexOffset;
+		commands.push_back(command);
 	}
 
-	return std::make_tuple(opaqueGroup, indirectParams, commands);
+	return Drawbles{ std::move(opaqueGroup), std::move(indirectParams), std::move(commands) };
+}
+
+void Scene::setOcclusionCulling(bool enabled)
+{
+	occlusionCulling_ = enabled;
+}
+
+bool Scene::getOcclusionCulling() const
+{
+	return occlusionCulling_;
+}
+
+uint32_t Scene::getCompilingPipelines() const
+{
+	return compiles_.getPending();
+}
+
+OcclusionCuller::Stats Scene::getCullingStats() const
+{
+	return culler_->getStats();
 }
 
 VkBuffer Scene::getVertexBuffer() const
@@ -858,6 +1065,68 @@ VkBuffer Scene::getIndexBuffer() const
 	return *indexBuffer;
 }
 
+VkBuffer Scene::getPositionBuffer() const
+{
+	return positionBuffer ? *positionBuffer : VK_NULL_HANDLE;
+}
+
+void Scene::setPositionStream(bool enabled)
+{
+	if (!enabled)
+	{
+		// Frames in flight may still read it, the buffer retires with them.
+		positionBuffer.reset();
+		positionCapacity_ = 0;
+		return;
+	}
+	if (positionBuffer)
+	{
+		return;
+	}
+
+	const VkDeviceSize vertexCount = vertexHighWater_ / sizeof(StaticVertex);
+	reservePositions(vertexCount);
+	if (vertexCount == 0)
+	{
+		return;
+	}
+
+	// De-interleaved by the copy, a region per vertex. Only when enabled, loads write their positions as they go.
+	std::vector<VkBufferCopy> regions(vertexCount);
+	for (VkDeviceSize i = 0; i < vertexCount; i++)
+	{
+		regions[i] = { i * sizeof(StaticVertex) + offsetof(StaticVertex, position), i * sizeof(glm::vec3), sizeof(glm::vec3) };
+	}
+	device_.wait(device_.submitOneTime(device_.transferQueue, [&](VkCommandBuffer commandBuffer) {
+		vkCmdCopyBuffer(commandBuffer, *vertexBuffer, *positionBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+	}));
+}
+
+void Scene::reservePositions(VkDeviceSize vertexCount)
+{
+	if (positionBuffer && vertexCount <= positionCapacity_)
+	{
+		return;
+	}
+
+	// Grows by half again, so a series of loads copies it a few times at most.
+	constexpr VkDeviceSize minPositionCapacity = 64 * 1024;
+	const VkDeviceSize capacity = std::max(minPositionCapacity, vertexCount + vertexCount / 2);
+	auto buffer = std::make_unique<Buffer>(device_, capacity * sizeof(glm::vec3),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+	if (positionBuffer)
+	{
+		device_.wait(device_.submitOneTime(device_.transferQueue, [&](VkCommandBuffer commandBuffer) {
+			positionBuffer->copy(*buffer, commandBuffer, positionCapacity_ * sizeof(glm::vec3), 0, 0);
+		}));
+	}
+	positionBuffer = std::move(buffer);
+	positionCapacity_ = capacity;
+}
+
 /*
 
 void Scene::draw(VkCommandBuffer commandBuffer, const State& state, VkImageView colorView, VkImageView depthView)
@@ -1154,7 +1423,6 @@ void Scene::draw(VkCommandBuffer commandBuffer, const State& state, VkImageView
 	}
 
 	const VkExtent2D extent = { uint32_t(state.camera_->viewportWidth), uint32_t(state.camera_->viewportHeight) };
-	// infiniteGrid_->draw(commandBuffer, globalSets_[frameCount_], colorView, depthView, extent);
 
 	skybox_->render(commandBuffer, state.camera_->calculateProjection(), state.camera_->calculateView(), colorView, depthView, extent);
 
@@ -1168,90 +1436,299 @@ void Scene::draw(VkCommandBuffer commandBuffer, const State& state, VkImageView
 }
 */
 
-VkPipeline Scene::getOrCreatePipeline(const MaterialCharacteristic& character, VkShaderModule vertexShader, VkShaderModule fragmentShader, VkDescriptorSet imageSet, VkPipelineLayout layout)
+const PipelineVariant& Scene::requestPipeline(const MaterialCharacteristic& character)
+{
+	auto& variant = pipelines[character];
+	if (!variant)
+	{
+		variant = std::make_unique<PipelineVariant>();
+		compilePipeline(character, *variant);
+	}
+	return *variant;
+}
+
+void Scene::compilePipeline(const MaterialCharacteristic& character, PipelineVariant& variant)
 {
-	if (auto it = pipelines.find(character); it != pipelines.end())
+	if (libraries_.preRasterization)
 	{
-		return it->second;
+		auto s = Bench::record();
+		variant.pipeline.store(linkOpaquePipeline(character, false), std::memory_order_release);
+		auto e = Bench::record();
+		SPDLOG_INFO("Fast-linked pipeline variant in {}ms.", Bench::diff<float>(s, e));
+
+		compiles_.run([this, character, target = &variant]() {
+			const VkPipeline fastLinked = target->pipeline.exchange(linkOpaquePipeline(character, true), std::memory_order_acq_rel);
+			std::scoped_lock lock(retiredPipelinesMutex_);
+			retiredPipelines_.push_back(fastLinked);
+		});
 	}
 	else
 	{
-		const auto opaquePipeline = [&](bool doubleSided, int mode, bool alphaMask, float alphaMaskCutoff) {
-			VkPipeline pipeline;
-			std::array stages = {
-				CreateInfo::ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader),
-				CreateInfo::ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader)
-			};
-
-			auto vertexBinding = StaticVertex::BindingDescription();
-			auto vertexAttributes = StaticVertex::AttributesDescription();
-			auto vertexInputState = CreateInfo::VertexInputState(&vertexBinding, 1, vertexAttributes.data(), vertexAttributes.size());
-
-			auto inputAssemblyState = CreateInfo::InputAssemblyState(getMode(mode));
-
-			auto viewportState = CreateInfo::ViewportState();
-
-			auto rasterizationState = CreateInfo::RasterizationState(
-				VK_FALSE,
-				doubleSided ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE,
-				VK_FRONT_FACE_COUNTER_CLOCKWISE
-			);
-
-			auto multisampleState = CreateInfo::MultisampleState();
-
-			auto depthStencilState = CreateInfo::DepthStencilState();
-
-			auto colorAttachment = CreateInfo::ColorBlendAttachment();
-			auto colorBlendState = CreateInfo::ColorBlendState(&colorAttachment, 1);
-
-			std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-			auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
-
-			VkFormat swapchainFormat = VK_FORMAT_R32G32B32A32_SFLOAT; //hdr
-			auto rendering = CreateInfo::Rendering(&swapchainFormat, 1, device_.getDepthFormat());
-
-			SpecializationData data{};
-			data.alphaMask = alphaMask;
-			data.alphaMaskCutoff = alphaMaskCutoff;
-
-			std::array<VkSpecializationMapEntry, 2> mapEntries{};
-			mapEntries[0].constantID = 0;
-			mapEntries[0].offset = offsetof(SpecializationData, alphaMask);
-			mapEntries[0].size = sizeof(SpecializationData::alphaMask);
-			mapEntries[1].constantID = 1;
-			mapEntries[1].offset = offsetof(SpecializationData, alphaMaskCutoff);
-			mapEntries[1].size = sizeof(SpecializationData::alphaMaskCutoff);
-			VkSpecializationInfo specInfo{};
-			specInfo.dataSize = sizeof(SpecializationData);
-			specInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
-			specInfo.pMapEntries = mapEntries.data();
-			specInfo.pData = &data;
-			stages[1].pSpecializationInfo = &specInfo;
-
-			VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-			pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
-			pipelineCreateInfo.pStages = stages.data();
-			pipelineCreateInfo.pVertexInputState = &vertexInputState;
-			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-			pipelineCreateInfo.pTessellationState = nullptr;
-			pipelineCreateInfo.pViewportState = &viewportState;
-			pipelineCreateInfo.pRasterizationState = &rasterizationState;
-			pipelineCreateInfo.pMultisampleState = &multisampleState;
-			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-			pipelineCreateInfo.pColorBlendState = &colorBlendState;
-			pipelineCreateInfo.pDynamicState = &dynamicState;
-			pipelineCreateInfo.layout = layout;
-
-			Connect(pipelineCreateInfo, rendering);
-
-			check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
-			return pipeline;
-		};
-		pipelines[character] = opaquePipeline(character.doubleSided, character.mode, character.alphaMask, character.alphaMaskCutoff);
-		return pipelines[character];
+		compiles_.compile(variant.pipeline, [this, character]() {
+			return createOpaquePipeline(character);
+		});
+	}
+}
+
+void Scene::setHdrPrecision(HdrPrecision precision)
+{
+	if (precision == precision_)
+	{
+		return;
+	}
+	precision_ = precision;
+
+	// Variants still compiling or linking would come out for the old format.
+	compiles_.wait();
+
+	// Only the fragment output part of a library knows the format, the other parts are kept.
+	std::vector<VkPipeline> retired = { fallbackPipeline_, libraries_.fragmentOutput };
+	retired.insert(retired.end(), depthPipelines_.begin(), depthPipelines_.end());
+	for (const auto& [character, variant] : pipelines)
+	{
+		retired.push_back(variant->pipeline.exchange(VK_NULL_HANDLE, std::memory_order_acq_rel));
+	}
+	device_.release([&device = device_, retired = std::move(retired)]() {
+		for (const auto pipeline : retired)
+		{
+			vkDestroyPipeline(device.device, pipeline, nullptr);
+		}
+	});
+
+	if (fallbackPipeline_)
+	{
+		fallbackPipeline_ = createOpaquePipeline(fallbackCharacteristic);
+	}
+	if (libraries_.fragmentOutput)
+	{
+		libraries_.fragmentOutput = createOpaquePipeline(fallbackCharacteristic, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+	}
+	if (depthPipelines_[0])
+	{
+		createDepthPipelines();
+	}
+	for (const auto& [character, variant] : pipelines)
+	{
+		compilePipeline(character, *variant);
+	}
+
+	if (cubeMap_)
+	{
+		precomputeLighting({});
+	}
+}
+
+HdrPrecision Scene::getHdrPrecision() const
+{
+	return precision_;
+}
+
+void Scene::createOpaqueLibraries()
+{
+	auto s = Bench::record();
+	for (size_t i = 0; i < topologyClasses.size(); i++)
+	{
+		libraries_.vertexInput[i] = createOpaquePipeline({ .topologyClass = topologyClasses[i], .alphaMask = false },
+			VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT);
+	}
+	libraries_.preRasterization = createOpaquePipeline(fallbackCharacteristic, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+	for (size_t i = 0; i < libraries_.fragmentShader.size(); i++)
+	{
+		libraries_.fragmentShader[i] = createOpaquePipeline({ .topologyClass = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, .alphaMask = i == 1 },
+			VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+	}
+	libraries_.fragmentOutput = createOpaquePipeline(fallbackCharacteristic, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+	auto e = Bench::record();
+	SPDLOG_INFO("Compiled opaque pipeline libraries in {}ms.", Bench::diff<float>(s, e));
+}
+
+VkPipeline Scene::linkOpaquePipeline(const MaterialCharacteristic& character, bool optimize) const
+{
+	const std::array libraries = {
+		libraries_.vertexInput[getTopologyClassIndex(character.topologyClass)],
+		libraries_.preRasterization,
+		libraries_.fragmentShader[character.alphaMask ? 1 : 0],
+		libraries_.fragmentOutput
+	};
+
+	VkPipelineLibraryCreateInfoKHR libraryInfo{ VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR };
+	libraryInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+	libraryInfo.pLibraries = libraries.data();
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	pipelineCreateInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+	pipelineCreateInfo.layout = pipelineSource_.layout;
+	Connect(pipelineCreateInfo, libraryInfo);
+
+	VkPipeline pipeline;
+	check(device_.createGraphicsPipelines(1, &pipelineCreateInfo, &pipeline));
+	return pipeline;
+}
+
+VkPipeline Scene::createOpaquePipeline(const MaterialCharacteristic& character, VkGraphicsPipelineLibraryFlagsEXT parts) const
+{
+	VkPipeline pipeline;
+	std::vector<VkPipelineShaderStageCreateInfo> stages;
+	if (!parts || (parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT))
+	{
+		stages.push_back(CreateInfo::ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, pipelineSource_.vertexShader));
+	}
+	if (!parts || (parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT))
+	{
+		stages.push_back(CreateInfo::ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, pipelineSource_.fragmentShader));
+	}
+
+	auto vertexBinding = StaticVertex::BindingDescription();
+	auto vertexAttributes = StaticVertex::AttributesDescription();
+	auto vertexInputState = CreateInfo::VertexInputState(&vertexBinding, 1, vertexAttributes.data(), vertexAttributes.size());
+
+	// Only the class matters, the exact topology and the cull mode are set per draw group.
+	auto inputAssemblyState = CreateInfo::InputAssemblyState(character.topologyClass);
+
+	auto viewportState = CreateInfo::ViewportState();
+
+	auto rasterizationState = CreateInfo::RasterizationState(
+		VK_FALSE,
+		VK_CULL_MODE_NONE,
+		VK_FRONT_FACE_COUNTER_CLOCKWISE
+	);
+
+	auto multisampleState = CreateInfo::MultisampleState();
+
+	auto depthStencilState = CreateInfo::DepthStencilState();
+
+	auto colorAttachment = CreateInfo::ColorBlendAttachment();
+	auto colorBlendState = CreateInfo::ColorBlendState(&colorAttachment, 1);
+
+	// Depth is tested for equal and not written where the depth pre-pass drew first.
+	std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_CULL_MODE, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+		VK_DYNAMIC_STATE_DEPTH_COMPARE_OP, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE };
+	auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
+
+	const VkFormat hdrFormat = getColorFormat(precision_);
+	auto rendering = CreateInfo::Rendering(&hdrFormat, 1, device_.getDepthFormat());
+
+	SpecializationData data{};
+	data.alphaMask = character.alphaMask;
+
+	std::array<VkSpecializationMapEntry, 1> mapEntries{};
+	mapEntries[0].constantID = 0;
+	mapEntries[0].offset = offsetof(SpecializationData, alphaMask);
+	mapEntries[0].size = sizeof(SpecializationData::alphaMask);
+	VkSpecializationInfo specInfo{};
+	specInfo.dataSize = sizeof(SpecializationData);
+	specInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+	specInfo.pMapEntries = mapEntries.data();
+	specInfo.pData = &data;
+	for (auto& stage : stages)
+	{
+		if (stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+		{
+			stage.pSpecializationInfo = &specInfo;
+		}
+	}
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
+	pipelineCreateInfo.pStages = stages.data();
+	pipelineCreateInfo.pVertexInputState = &vertexInputState;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+	pipelineCreateInfo.pTessellationState = nullptr;
+	pipelineCreateInfo.pViewportState = &viewportState;
+	pipelineCreateInfo.pRasterizationState = &rasterizationState;
+	pipelineCreateInfo.pMultisampleState = &multisampleState;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+	pipelineCreateInfo.pColorBlendState = &colorBlendState;
+	pipelineCreateInfo.pDynamicState = &dynamicState;
+	pipelineCreateInfo.layout = pipelineSource_.layout;
+
+	Connect(pipelineCreateInfo, rendering);
+
+	// State outside of the requested parts is ignored by the driver, so the same description serves every library.
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT };
+	if (parts)
+	{
+		libraryInfo.flags = parts;
+		pipelineCreateInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+		Connect(pipelineCreateInfo, libraryInfo);
+	}
+
+	check(device_.createGraphicsPipelines(1, &pipelineCreateInfo, &pipeline));
+	return pipeline;
+}
+
+void Scene::createDepthPipelines()
+{
+	for (size_t i = 0; i < topologyClasses.size(); i++)
+	{
+		depthPipelines_[i] = createDepthPipeline(topologyClasses[i]);
 	}
 }
 
+VkPipeline Scene::createDepthPipeline(VkPrimitiveTopology topologyClass) const
+{
+	VkShaderModule vertexShader = loadShader(device_, Shaders::Depth_vert);
+	const auto stage = CreateInfo::ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader);
+
+	VkVertexInputBindingDescription vertexBinding{};
+	vertexBinding.binding = 0;
+	vertexBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	vertexBinding.stride = sizeof(glm::vec3);
+	VkVertexInputAttributeDescription vertexAttribute{};
+	vertexAttribute.binding = 0;
+	vertexAttribute.location = 0;
+	vertexAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+	vertexAttribute.offset = 0;
+	auto vertexInputState = CreateInfo::VertexInputState(&vertexBinding, 1, &vertexAttribute, 1);
+
+	auto inputAssemblyState = CreateInfo::InputAssemblyState(topologyClass);
+
+	auto viewportState = CreateInfo::ViewportState();
+
+	auto rasterizationState = CreateInfo::RasterizationState(
+		VK_FALSE,
+		VK_CULL_MODE_NONE,
+		VK_FRONT_FACE_COUNTER_CLOCKWISE
+	);
+
+	auto multisampleState = CreateInfo::MultisampleState();
+
+	auto depthStencilState = CreateInfo::DepthStencilState();
+
+	// The colour attachment is there as the rendering scope has it, but nothing is written to it.
+	auto colorAttachment = CreateInfo::NoBlend();
+	colorAttachment.colorWriteMask = 0;
+	auto colorBlendState = CreateInfo::ColorBlendState(&colorAttachment, 1);
+
+	std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_CULL_MODE, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY };
+	auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
+
+	const VkFormat hdrFormat = getColorFormat(precision_);
+	auto rendering = CreateInfo::Rendering(&hdrFormat, 1, device_.getDepthFormat());
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	pipelineCreateInfo.stageCount = 1;
+	pipelineCreateInfo.pStages = &stage;
+	pipelineCreateInfo.pVertexInputState = &vertexInputState;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+	pipelineCreateInfo.pTessellationState = nullptr;
+	pipelineCreateInfo.pViewportState = &viewportState;
+	pipelineCreateInfo.pRasterizationState = &rasterizationState;
+	pipelineCreateInfo.pMultisampleState = &multisampleState;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+	pipelineCreateInfo.pColorBlendState = &colorBlendState;
+	pipelineCreateInfo.pDynamicState = &dynamicState;
+	pipelineCreateInfo.layout = pipelineSource_.layout;
+
+	Connect(pipelineCreateInfo, rendering);
+
+	VkPipeline pipeline;
+	check(device_.createGraphicsPipelines(1, &pipelineCreateInfo, &pipeline));
+
+	device_.registry.release(vertexShader);
+	return pipeline;
+}
+
 Image& Scene::getCubeMap() const
 {
 	return *cubeMap_;
@@ -1279,6 +1756,9 @@ std::shared_ptr<Buffer> Scene::getCubeBuffer() const
 
 Scene::~Scene()
 {
+	// Pipelines may still be compiling or linking.
+	compiles_.wait();
+
 	const auto deleteNode = [&](const auto& deleteNodeFn, const std::unique_ptr<Node>& node) -> void {
 		if (node->mesh)
 		{
@@ -1300,9 +1780,28 @@ Scene::~Scene()
 		deleteNode(deleteNode, node);
 	}
 
-	for (const auto& pipeline : pipelines)
+	for (const auto& variant : pipelines)
+	{
+		vkDestroyPipeline(device_.device, variant.second->pipeline.load(), nullptr);
+	}
+	vkDestroyPipeline(device_.device, fallbackPipeline_, nullptr);
+	for (const auto pipeline : retiredPipelines_)
+	{
+		vkDestroyPipeline(device_.device, pipeline, nullptr);
+	}
+	for (const auto library : libraries_.vertexInput)
+	{
+		vkDestroyPipeline(device_.device, library, nullptr);
+	}
+	vkDestroyPipeline(device_.device, libraries_.preRasterization, nullptr);
+	for (const auto library : libraries_.fragmentShader)
+	{
+		vkDestroyPipeline(device_.device, library, nullptr);
+	}
+	vkDestroyPipeline(device_.device, libraries_.fragmentOutput, nullptr);
+	for (const auto pipeline : depthPipelines_)
 	{
-		vkDestroyPipeline(device_.device, pipeline.second, nullptr);
+		vkDestroyPipeline(device_.device, pipeline, nullptr);
 	}
 	
 	textures.clear();
@@ -1312,6 +1811,7 @@ Scene::~Scene()
 
 	vertexBuffer.reset();
 	indexBuffer.reset();
+	positionBuffer.reset();
 }
 
 /*
@@ -1370,7 +1870,7 @@ void Scene::recreateAccumReveal(int width, int height)
 
 	reveal->attachSampler(samplerInfo);
 
-	CreateInfo::performOneTimeAction(device_.device, device_.graphicsQueue.queue, device_.graphicsPool, [&](VkCommandBuffer commandBuffer) {
+	device_.submitOneTime(device_.graphicsQueue, [&](VkCommandBuffer commandBuffer) {
 		Transition::UndefinedToColorAttachment(accum->get(), commandBuffer, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
 		Transition::UndefinedToColorAttachment(reveal->get(), commandBuffer, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
 	});
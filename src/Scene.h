@@ -3,6 +3,10 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <span>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -10,26 +14,33 @@
 
 #include "State.h"
 #include "Core/Common.h"
+#include "Core/Device.h"
 #include "Core/Image.h"
 #include "Common/Handle.h"
+#include "Common/CompileQueue.h"
+#include "Common/LinearArena.h"
+#include "Render/HdrPrecision.h"
 #include "Render/Skybox.h"
-#include "Render/InfiniteGrid.h"
+#include "Render/OcclusionCulling.h"
 #include "Utility/FlattenCubemap.h"
 #include "Utility/IrradianceCubemap.h"
 #include "Utility/PrefilterCubemap.h"
 
 class Device;
 class Buffer;
+class BindlessTextures;
 
+/**
+ * @brief What forks a material pipeline. Cull mode and topology are dynamic state and the alpha cutoff is per-draw data,
+ * so only the topology class (point, line or triangle) and whether the shader may discard are left.
+*/
 struct MaterialCharacteristic
 {
 	// shader name todo:
-	bool doubleSided;
-	int mode;
+	VkPrimitiveTopology topologyClass; // The list topology standing for its class.
 	bool alphaMask;
-	float alphaMaskCutoff;
 
-	constexpr auto tied() const { return std::tie(doubleSided, mode, alphaMask, alphaMaskCutoff); }
+	constexpr auto tied() const { return std::tie(topologyClass, alphaMask); }
 	constexpr bool operator==(MaterialCharacteristic const& rhs) const { return tied() == rhs.tied(); }
 };
 
@@ -40,15 +51,21 @@ namespace std
 		size_t operator()(const MaterialCharacteristic& c) const
 		{
 			size_t result = 0;
-			hash_combine(result, c.doubleSided);
-			hash_combine(result, c.mode);
+			hash_combine(result, c.topologyClass);
 			hash_combine(result, c.alphaMask);
-			hash_combine(result, c.alphaMaskCutoff);
 			return result;
 		}
 	};
 }
 
+/**
+ * @brief Pipeline of one material variant. Compiled on the scene's compile queue, so it stays null until the compile finishes.
+*/
+struct PipelineVariant
+{
+	std::atomic<VkPipeline> pipeline{ VK_NULL_HANDLE };
+};
+
 struct Submesh
 {
 	VmaVirtualAllocation vertexAlloc;
@@ -57,13 +74,22 @@ struct Submesh
 	uint32_t firstIndex;
 	int32_t vertexOffset;
 
-	VkPipeline pipeline;
+	const PipelineVariant* pipeline;
+	VkCullModeFlags cullMode;
+	VkPrimitiveTopology topology;
 	int colorId;
 	int normalId;
 	int mroId;
 	int emissiveId;
+	float alphaCutoff;
+	bool alphaMask; // Discards below alphaCutoff, so the depth pre-pass leaves it out.
 
 	bool transparent;
+
+	BoundingBox bounds;
+	// CPU copy for the software rasterizer, empty if this submesh is not an occluder.
+	std::vector<glm::vec3> occluderPositions;
+	std::vector<uint32_t> occluderIndices;
 };
 
 struct Mesh
@@ -90,33 +116,78 @@ struct IndirectDrawParam
 	int normalId;
 	int mroId;
 	int emissiveId;
+	float alphaCutoff;
 };
 
 class Scene
 {
 public:
-	Scene(Device& device);
+	Scene(Device& device, BS::thread_pool& workers);
 
-	void loadGLTF(const std::string& path, VkShaderModule vertexShader, VkShaderModule fragmentShader, VkDescriptorSet imageSet, VkPipelineLayout layout);
+	/**
+	 * @brief Textures are added to the bindless array, submeshes refer to their slot.
+	*/
+	void loadGLTF(const std::string& path, VkShaderModule vertexShader, VkShaderModule fragmentShader, BindlessTextures& bindless, VkPipelineLayout layout);
 
+	/**
+	 * @param ibrSet Written with the irradiance, prefiltered and BRDF maps, and again whenever the precision changes.
+	*/
 	void loadCubeMap(const std::string& path, VkDescriptorSet ibrSet);
 
+	/**
+	 * @brief Recreates the opaque pipelines for the HDR format of precision and regenerates the lighting maps at it.
+	 * No frame may be in flight, the lighting set is rewritten. Main thread only.
+	*/
+	void setHdrPrecision(HdrPrecision precision);
+	HdrPrecision getHdrPrecision() const;
+
 	struct DrawCall
 	{
 		uint32_t offset;
 		uint32_t count;
+		VkCullModeFlags cullMode;
+		VkPrimitiveTopology topology;
+		// Of the depth pre-pass. Null for what discards, which only the colour pass draws and with a regular depth test.
+		VkPipeline depthPipeline;
 	};
 
-	using PipelineGroups = std::map<VkPipeline, DrawCall>;
-	using DrawParams = std::vector<IndirectDrawParam>;
-	using DrawCommands = std::vector<VkDrawIndexedIndirectCommand>;
+	using PipelineGroups = ArenaVector<std::pair<VkPipeline, DrawCall>>;
+	using DrawParams = ArenaVector<IndirectDrawParam>;
+	using DrawCommands = ArenaVector<VkDrawIndexedIndirectCommand>;
 	using Drawbles = std::tuple <PipelineGroups, DrawParams, DrawCommands>;
-	Drawbles getDrawables() const;
+	/**
+	 * @brief Submeshes hidden behind occluders (or outside the frustum) are left out when occlusion culling is on.
+	 * Everything returned lives in the frame arena, so it is only valid until that arena is reset.
+	*/
+	Drawbles getDrawables(const glm::mat4& viewProjection, LinearArena& arena);
+
+	void setOcclusionCulling(bool enabled);
+	bool getOcclusionCulling() const;
+	OcclusionCuller::Stats getCullingStats() const;
+	/**
+	 * @brief Variants queued or compiling, their submeshes are drawn with the fallback meanwhile.
+	 * Includes optimized links, whose variants are drawn with their fast link meanwhile.
+	*/
+	uint32_t getCompilingPipelines() const;
 
 	VkBuffer getVertexBuffer() const;
 	VkBuffer getIndexBuffer() const;
+	/**
+	 * @brief Only the positions of the vertex buffer, for the depth pre-pass. A vertex has the same index in both.
+	 * Null while the position stream is disabled.
+	*/
+	VkBuffer getPositionBuffer() const;
+	/**
+	 * @brief The position buffer is copied out of the vertex buffer when enabled, then kept up to date by every load,
+	 * and released when disabled, so it only takes memory while the depth pre-pass is on. Waits for the copy. Main thread only.
+	*/
+	void setPositionStream(bool enabled);
 
-	VkPipeline getOrCreatePipeline(const MaterialCharacteristic& character, VkShaderModule vertexShader, VkShaderModule fragmentShader, VkDescriptorSet imageSet, VkPipelineLayout layout);
+	/**
+	 * @brief Unknown variants are queued on the compile queue and drawn with a fallback pipeline until ready.
+	 * Uses the shaders and layout of the last loadGLTF. Main thread only.
+	*/
+	const PipelineVariant& requestPipeline(const MaterialCharacteristic& character);
 
 	Image& getCubeMap() const;
 	Image& getPrefilter() const;
@@ -132,9 +203,55 @@ private:
 
 	std::unique_ptr<Buffer> vertexBuffer{};
 	std::unique_ptr<Buffer> indexBuffer{};
+	// Beside the interleaved vertices, so the depth pre-pass fetches a quarter of the bytes. Only while enabled.
+	std::unique_ptr<Buffer> positionBuffer{};
+	VkDeviceSize positionCapacity_ = 0; // In vertices.
+	VkDeviceSize vertexHighWater_ = 0; // End of the highest vertex allocation, what the position buffer covers.
+	/**
+	 * @brief Grows the position buffer to hold vertexCount, keeping its contents.
+	*/
+	void reservePositions(VkDeviceSize vertexCount);
 	
 	std::vector<std::unique_ptr<Image>> textures{};
-	std::unordered_map<MaterialCharacteristic, VkPipeline> pipelines{};
+	std::unordered_map<MaterialCharacteristic, std::unique_ptr<PipelineVariant>> pipelines{};
+
+	struct PipelineSource
+	{
+		VkShaderModule vertexShader;
+		VkShaderModule fragmentShader;
+		VkPipelineLayout layout;
+	};
+	PipelineSource pipelineSource_{};
+	VkPipeline fallbackPipeline_{};
+	/**
+	 * @brief A complete pipeline when parts is 0, otherwise a library holding only those parts.
+	*/
+	VkPipeline createOpaquePipeline(const MaterialCharacteristic& character, VkGraphicsPipelineLibraryFlagsEXT parts = 0) const;
+
+	// Compiled once when the device supports graphics pipeline libraries, variants are then linked from these.
+	struct OpaqueLibraries
+	{
+		std::array<VkPipeline, 3> vertexInput{}; // One per topology class.
+		VkPipeline preRasterization{};
+		std::array<VkPipeline, 2> fragmentShader{}; // Without and with alpha mask.
+		VkPipeline fragmentOutput{};
+	};
+	OpaqueLibraries libraries_{};
+
+	// Writes depth only, one per topology class. Drawn in the opaque pass's rendering scope, so the colour format is that of the HDR target.
+	std::array<VkPipeline, 3> depthPipelines_{};
+	VkPipeline createDepthPipeline(VkPrimitiveTopology topologyClass) const;
+	void createDepthPipelines();
+	void createOpaqueLibraries();
+	VkPipeline linkOpaquePipeline(const MaterialCharacteristic& character, bool optimize) const;
+	/**
+	 * @brief Links or queues the compilation of variant, which stays null until then.
+	*/
+	void compilePipeline(const MaterialCharacteristic& character, PipelineVariant& variant);
+
+	// Fast-linked pipelines replaced by their optimized link. Frames in flight may still use them, so they live as long as the scene.
+	std::mutex retiredPipelinesMutex_;
+	std::vector<VkPipeline> retiredPipelines_;
 
 	std::vector<std::unique_ptr<Node>> nodes{};
 
@@ -143,11 +260,23 @@ private:
 	std::unique_ptr<Image> irradianceMap_;
 	std::unique_ptr<Image> prefilterMap_;
 	std::unique_ptr<Image> brdfMap_;
+	VkDescriptorSet ibrSet_{};
+	HdrPrecision precision_ = HdrPrecision::Half;
+	/**
+	 * @brief Renders the BRDF table and convolves cubeMap_ after waits, then points ibrSet_ at the results.
+	*/
+	void precomputeLighting(std::span<const Device::Ticket> waits);
 
 	std::unique_ptr<FlattenCubemap> flattenCubemap_;
 	std::unique_ptr<IrradianceCubemap> irradianceCubemap_;
 	std::unique_ptr<PrefilterCubemap> prefilterCubemap_;
 
+	BS::thread_pool& workers_;
+	// Not on the workers, which every frame waits on.
+	CompileQueue compiles_;
+	std::unique_ptr<OcclusionCuller> culler_;
+	bool occlusionCulling_ = true;
+
 	// Is this necessary?
 	//void recreateAccumReveal(int width, int height);
 	//std::unique_ptr<Image> accum;
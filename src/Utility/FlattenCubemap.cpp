@@ -8,6 +8,8 @@
 #include "../Core/Buffer.h"
 #include "../Core/DescriptorWrite.h"
 #include "../Core/Cube.h"
+#include "Shaders/FlattenCubemap.frag.h"
+#include "Shaders/FlattenCubemap.vert.h"
 
 #include <array>
 #include <glm/glm.hpp>
@@ -20,14 +22,13 @@ FlattenCubemap::FlattenCubemap(Device& device, const std::shared_ptr<Buffer>& cu
 	uniformBuffer = std::make_unique<Buffer>(device_, 7 * sizeof(glm::mat4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 	
 	ShaderReflect reflect;
-	reflect.add("Shaders/FlattenCubemap.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-	reflect.add("Shaders/FlattenCubemap.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	reflect.add(Shaders::FlattenCubemap_vert);
+	reflect.add(Shaders::FlattenCubemap_frag);
 
-	conversionDescLayout = reflect.retrieveDescriptorSetLayout(device_.device)[0];
-	conversionPool = reflect.retrieveDescriptorPool(device_.device);
-	conversionSet = reflect.retrieveSet(device_.device, conversionPool, conversionDescLayout)[0];
+	conversionDescLayout = reflect.retrieveDescriptorSetLayout(device_)[0];
+	conversionSet = device_.descriptors.allocate(conversionDescLayout);
 	conversionLayout = reflect.retrievePipelineLayout(device_.device, { conversionDescLayout });
-	auto conversionStages = reflect.retrieveShaderModule(device_.device);
+	auto conversionStages = reflect.retrieveShaderModule(device_);
 
 	conversionPipeline = [&]() {
 		VkPipeline pipeline;
@@ -77,7 +78,7 @@ FlattenCubemap::FlattenCubemap(Device& device, const std::shared_ptr<Buffer>& cu
 
 		Connect(pipelineCreateInfo, rendering);
 
-		check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		check(device_.createGraphicsPipelines(1, &pipelineCreateInfo, &pipeline));
 
 		return pipeline;
 	}();
@@ -98,7 +99,7 @@ FlattenCubemap::FlattenCubemap(Device& device, const std::shared_ptr<Buffer>& cu
 	};
 	uniformBuffer->upload(views.data(), views.size() * sizeof(glm::mat4), sizeof(glm::mat4));
 
-	ShaderReflect::deleteModules(device_.device, conversionStages);
+	ShaderReflect::deleteModules(device_, conversionStages);
 }
 
 std::unique_ptr<Image> FlattenCubemap::convert(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler, int dim)
@@ -110,11 +111,13 @@ std::unique_ptr<Image> FlattenCubemap::convert(VkCommandBuffer commandBuffer, Vk
 		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 	imageCI.arrayLayers = 6; //for cubemap
 	imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+	// Convolved on the compute queue.
+	device_.shareAcrossQueues(imageCI);
 	auto img = std::make_unique<Image>(device_, imageCI);
 	img->attachCubeMapImageView(range);
 
 	// transition...
-	Transition::UndefinedToColorAttachment(img->get(), commandBuffer, range);
+	img->transition(commandBuffer, ImageUsage::ColorAttachment);
 
 	// write to descriptor
 	DescriptorWrite writer;
@@ -180,7 +183,6 @@ FlattenCubemap::~FlattenCubemap()
 {
 	vkDestroyPipelineLayout(device_.device, conversionLayout, nullptr);
 	vkDestroyPipeline(device_.device, conversionPipeline, nullptr);
-	vkDestroyDescriptorSetLayout(device_.device, conversionDescLayout, nullptr);
-	vkDestroyDescriptorPool(device_.device, conversionPool, nullptr);
+	device_.registry.release(conversionDescLayout);
 
 }
@@ -21,7 +21,6 @@ public:
 private:
 	Device& device_;
 	VkDescriptorSetLayout conversionDescLayout{};
-	VkDescriptorPool conversionPool{};
 	VkDescriptorSet conversionSet{};
 	VkPipelineLayout conversionLayout{};
 	VkPipeline conversionPipeline{};
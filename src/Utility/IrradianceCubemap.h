@@ -1,29 +1,33 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
-#include <glm/glm.hpp>
 #include <memory>
+#include <vector>
 
 class Device;
 class Image;
-class Buffer;
+/**
+ * @brief Diffuse convolution of an environment cubemap, in a compute shader so it can run on the compute queue.
+*/
 class IrradianceCubemap
 {
 public:
-	IrradianceCubemap(Device& device, const std::shared_ptr<Buffer>& buffer);
+	IrradianceCubemap(Device& device);
 
-	std::unique_ptr<Image> convert(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler, int dim);
-	std::unique_ptr<Image> convert(VkCommandBuffer commandBuffer, Image* image, int dim);
+	/**
+	 * @param imageView Of an environment cubemap moved to compute sampled by the caller.
+	 * @param format One with hdrColorFeatures (see HdrPrecision.h).
+	 * @param recycling Views the commands use, destroy them once the commands have completed.
+	 * @return Left in compute sampled, and shared with the graphics queue.
+	*/
+	std::unique_ptr<Image> convert(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler, int dim, VkFormat format, std::vector<VkImageView>& recycling);
+	std::unique_ptr<Image> convert(VkCommandBuffer commandBuffer, Image* image, int dim, VkFormat format, std::vector<VkImageView>& recycling);
 
 	~IrradianceCubemap();
 private:
 	Device& device_;
 	VkDescriptorSetLayout irradianceDescLayout{};
-	VkDescriptorPool irradiancePool{};
 	VkDescriptorSet irradianceSet{};
 	VkPipelineLayout irradianceLayout{};
 	VkPipeline irradiancePipeline{};
-
-	std::shared_ptr<Buffer> cubeBuffer;
-	std::unique_ptr<Buffer> uniformBuffer;
-};
\ No newline at end of file
+};
@@ -5,245 +5,162 @@
 #include "../Core/Device.h"
 #include "../Core/Image.h"
 #include "../Core/Transition.h"
-#include "../Core/Buffer.h"
 #include "../Core/DescriptorWrite.h"
-#include "../Core/Cube.h"
-#include <glm/ext/matrix_transform.hpp>
-#include <glm/ext/matrix_clip_space.hpp>
+#include "Shaders/BRDF.frag.h"
+#include "Shaders/BRDF.vert.h"
+#include "Shaders/Prefilter.comp.h"
 
-PrefilterCubemap::PrefilterCubemap(Device& device, const std::shared_ptr<Buffer>& buffer) 
-	: device_(device), cubeBuffer(buffer)
-{
-	uniformBuffer = std::make_unique<Buffer>(device_, 7 * sizeof(glm::mat4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+#include <algorithm>
 
+PrefilterCubemap::PrefilterCubemap(Device& device) 
+	: device_(device)
+{
 	{
 		ShaderReflect reflect;
-		reflect.add("Shaders/Irradiance.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		reflect.add("Shaders/Prefilter.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		reflect.add(Shaders::Prefilter_comp);
 
-		prefilterDescLayout = reflect.retrieveDescriptorSetLayout(device_.device)[0];
-		prefilterPool = reflect.retrieveDescriptorPool(device_.device);
-		prefilterSet = reflect.retrieveSet(device_.device, prefilterPool, prefilterDescLayout)[0];
+		prefilterDescLayout = reflect.retrieveDescriptorSetLayout(device_)[0];
+		device_.descriptors.allocate(prefilterDescLayout, maxMipLevels, prefilterSets.data());
 		prefilterLayout = reflect.retrievePipelineLayout(device_.device, { prefilterDescLayout });
-		auto prefilterStages = reflect.retrieveShaderModule(device_.device);
+		auto prefilterStages = reflect.retrieveShaderModule(device_);
 
 		prefilterPipeline = [&]() {
 			VkPipeline pipeline;
-			const auto stages = reflect.getStages(prefilterStages);
-
-			auto vertexBinding = BasicVertex::BindingDescription();
-			auto vertexAttributes = BasicVertex::PositionAttributesDescription();
-			auto vertexInputState = CreateInfo::VertexInputState(&vertexBinding, 1, vertexAttributes.data(), vertexAttributes.size());
-
-			auto inputAssemblyState = CreateInfo::InputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-
-			auto viewportState = CreateInfo::ViewportState();
-
-			auto rasterizationState = CreateInfo::RasterizationState(
-				false,
-				VK_CULL_MODE_NONE,
-				VK_FRONT_FACE_COUNTER_CLOCKWISE
-			);
-
-			auto multisampleState = CreateInfo::MultisampleState();
-
-			auto depthStencilState = CreateInfo::NoDepthState();
-
-			auto attachment = CreateInfo::NoBlend();
-			auto colorBlendState = CreateInfo::ColorBlendState(&attachment, 1);
-
-			std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-			auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
-
-			VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
-			auto rendering = CreateInfo::Rendering(&format, 1, VK_FORMAT_UNDEFINED);
-			rendering.viewMask = 0b111111;
-
-			VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-			pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
-			pipelineCreateInfo.pStages = stages.data();
-			pipelineCreateInfo.pVertexInputState = &vertexInputState;
-			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-			pipelineCreateInfo.pTessellationState = nullptr;
-			pipelineCreateInfo.pViewportState = &viewportState;
-			pipelineCreateInfo.pRasterizationState = &rasterizationState;
-			pipelineCreateInfo.pMultisampleState = &multisampleState;
-			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-			pipelineCreateInfo.pColorBlendState = &colorBlendState;
-			pipelineCreateInfo.pDynamicState = &dynamicState;
+			VkComputePipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+			pipelineCreateInfo.stage = reflect.getStages(prefilterStages)[0];
 			pipelineCreateInfo.layout = prefilterLayout;
-
-			Connect(pipelineCreateInfo, rendering);
-
-			check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
-
+			check(device_.createComputePipelines(1, &pipelineCreateInfo, &pipeline));
 			return pipeline;
-			}();
-
-		DescriptorWrite writer;
-		writer.add(prefilterSet, 0, 0, BufferType::Uniform, 1, *uniformBuffer, 0, VK_WHOLE_SIZE);
-		writer.write(device_.device);
-
-		const auto projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.f);
-		uniformBuffer->upload(&projection, sizeof(projection));
-		std::array views{
-			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-			glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-		};
-		uniformBuffer->upload(views.data(), views.size() * sizeof(glm::mat4), sizeof(glm::mat4));
-
-		ShaderReflect::deleteModules(device_.device, prefilterStages);
+		}();
+
+		ShaderReflect::deleteModules(device_, prefilterStages);
 	}
 
 	{
+		// The pipeline follows the format of the table, it is created when that changes.
 		ShaderReflect reflect;
-		reflect.add("Shaders/BRDF.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		reflect.add("Shaders/BRDF.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-
+		reflect.add(Shaders::BRDF_vert);
+		reflect.add(Shaders::BRDF_frag);
 		brdfLayout = reflect.retrievePipelineLayout(device_.device, {});
-		auto brdfStages = reflect.retrieveShaderModule(device_.device);
+	}
+}
 
-		brdfPipeline = [&]() {
-			VkPipeline pipeline;
-			const auto stages = reflect.getStages(brdfStages);
+VkPipeline PrefilterCubemap::createBRDFPipeline(VkFormat format) const
+{
+	ShaderReflect reflect;
+	reflect.add(Shaders::BRDF_vert);
+	reflect.add(Shaders::BRDF_frag);
+	auto brdfStages = reflect.retrieveShaderModule(device_);
 
-			auto vertexInputState = CreateInfo::VertexInputState(nullptr, 0, nullptr, 0);
+	VkPipeline pipeline;
+	const auto stages = reflect.getStages(brdfStages);
 
-			auto inputAssemblyState = CreateInfo::InputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+	auto vertexInputState = CreateInfo::VertexInputState(nullptr, 0, nullptr, 0);
 
-			auto viewportState = CreateInfo::ViewportState();
+	auto inputAssemblyState = CreateInfo::InputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
 
-			auto rasterizationState = CreateInfo::RasterizationState(
-				false,
-				VK_CULL_MODE_BACK_BIT,
-				VK_FRONT_FACE_COUNTER_CLOCKWISE
-			);
+	auto viewportState = CreateInfo::ViewportState();
 
-			auto multisampleState = CreateInfo::MultisampleState();
+	auto rasterizationState = CreateInfo::RasterizationState(
+		false,
+		VK_CULL_MODE_BACK_BIT,
+		VK_FRONT_FACE_COUNTER_CLOCKWISE
+	);
 
-			auto depthStencilState = CreateInfo::NoDepthState();
+	auto multisampleState = CreateInfo::MultisampleState();
 
-			auto attachment = CreateInfo::NoBlend();
-			auto colorBlendState = CreateInfo::ColorBlendState(&attachment, 1);
+	auto depthStencilState = CreateInfo::NoDepthState();
 
-			std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-			auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
+	auto attachment = CreateInfo::NoBlend();
+	auto colorBlendState = CreateInfo::ColorBlendState(&attachment, 1);
 
-			VkFormat format = VK_FORMAT_R16G16_SFLOAT;
-			auto rendering = CreateInfo::Rendering(&format, 1, VK_FORMAT_UNDEFINED);
+	std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	auto dynamicState = CreateInfo::DynamicState(dynamicStates.data(), dynamicStates.size());
 
-			VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-			pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
-			pipelineCreateInfo.pStages = stages.data();
-			pipelineCreateInfo.pVertexInputState = &vertexInputState;
-			pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
-			pipelineCreateInfo.pTessellationState = nullptr;
-			pipelineCreateInfo.pViewportState = &viewportState;
-			pipelineCreateInfo.pRasterizationState = &rasterizationState;
-			pipelineCreateInfo.pMultisampleState = &multisampleState;
-			pipelineCreateInfo.pDepthStencilState = &depthStencilState;
-			pipelineCreateInfo.pColorBlendState = &colorBlendState;
-			pipelineCreateInfo.pDynamicState = &dynamicState;
-			pipelineCreateInfo.layout = brdfLayout;
+	auto rendering = CreateInfo::Rendering(&format, 1, VK_FORMAT_UNDEFINED);
 
-			Connect(pipelineCreateInfo, rendering);
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
+	pipelineCreateInfo.pStages = stages.data();
+	pipelineCreateInfo.pVertexInputState = &vertexInputState;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+	pipelineCreateInfo.pTessellationState = nullptr;
+	pipelineCreateInfo.pViewportState = &viewportState;
+	pipelineCreateInfo.pRasterizationState = &rasterizationState;
+	pipelineCreateInfo.pMultisampleState = &multisampleState;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+	pipelineCreateInfo.pColorBlendState = &colorBlendState;
+	pipelineCreateInfo.pDynamicState = &dynamicState;
+	pipelineCreateInfo.layout = brdfLayout;
 
-			check(vkCreateGraphicsPipelines(device_.device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline));
+	Connect(pipelineCreateInfo, rendering);
 
-			return pipeline;
-		}();
+	check(device_.createGraphicsPipelines(1, &pipelineCreateInfo, &pipeline));
 
-		ShaderReflect::deleteModules(device_.device, brdfStages);
-	}
+	ShaderReflect::deleteModules(device_, brdfStages);
+	return pipeline;
 }
 
-std::unique_ptr<Image> PrefilterCubemap::precomputeFilter(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler, int dim, std::vector<VkImageView>& recycling)
+std::unique_ptr<Image> PrefilterCubemap::precomputeFilter(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler, int dim, VkFormat format, std::vector<VkImageView>& recycling)
 {
 	VkExtent2D extent = { uint32_t(dim), uint32_t(dim) };
-	const uint32_t maxMipLevels = 5;
 
 	VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, maxMipLevels, 0, 6 };
-	VkImageCreateInfo imageCI = CreateInfo::Image2DCI(extent, maxMipLevels, VK_FORMAT_R32G32B32A32_SFLOAT,
-		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	VkImageCreateInfo imageCI = CreateInfo::Image2DCI(extent, maxMipLevels, format,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 	imageCI.arrayLayers = 6; //for cubemap
 	imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+	device_.shareAcrossQueues(imageCI);
 	auto img = std::make_unique<Image>(device_, imageCI);
 
-	Transition::UndefinedToColorAttachment(img->get(), commandBuffer, range);
+	img->transition(commandBuffer, ImageUsage::Storage);
 
 	DescriptorWrite writer;
-	writer.add(prefilterSet, 1, 0, ImageType::CombinedSampler, 1, sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	writer.write(device_.device);
-
-	VkDebugUtilsLabelEXT label{};
-	label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
-	label.pLabelName = "Prefilter";
-	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
-
-	VkRenderingAttachmentInfo colorAttachment{};
-	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.clearValue = { 0.f, 0.f, 0.f, 1.f };
-
-	VkRenderingInfo renderInfo{};
-	renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-	renderInfo.renderArea.offset = { 0, 0 };
-	renderInfo.layerCount = 1;
-	renderInfo.colorAttachmentCount = 1;
-	renderInfo.pColorAttachments = &colorAttachment;
-	renderInfo.viewMask = 0b111111; // multiview 6 times.
-
 	for (uint32_t mipLevel = 0; mipLevel < maxMipLevels; mipLevel++)
 	{
-		const int mippedDim = dim * std::pow(0.5, mipLevel);
-		const auto imageView = [&]() {
+		// Storage images cannot be cubes, the faces of a level are written as layers.
+		const auto storageView = [&]() {
 			VkImageView iv;
 			VkImageViewCreateInfo imageViewCI{};
 			imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 			imageViewCI.image = img->get();
-			imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+			imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
 			imageViewCI.format = img->getFormat();
 			imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 1, 0, 6 };
 			check(vkCreateImageView(device_.device, &imageViewCI, nullptr, &iv));
 			return iv;
 		}();
-		recycling.push_back(imageView);
+		recycling.push_back(storageView);
 
-		colorAttachment.imageView = imageView;
-		renderInfo.renderArea.extent.width = uint32_t(mippedDim);
-		renderInfo.renderArea.extent.height = uint32_t(mippedDim);
-		vkCmdBeginRendering(commandBuffer, &renderInfo);
+		writer.add(prefilterSets[mipLevel], 0, 0, ImageType::CombinedSampler, 1, sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		writer.add(prefilterSets[mipLevel], 1, 0, ImageType::Storage, 1, VK_NULL_HANDLE, storageView, VK_IMAGE_LAYOUT_GENERAL);
+	}
+	writer.write(device_.device);
 
-		const VkExtent2D mippedExtent = { uint32_t(mippedDim), uint32_t(mippedDim) };
-		VkRect2D scissor{};
-		scissor.extent = mippedExtent;
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	VkDebugUtilsLabelEXT label{};
+	label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+	label.pLabelName = "Prefilter";
+	vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
 
-		VkViewport viewport = CreateInfo::Viewport(mippedExtent);
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, prefilterPipeline);
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prefilterPipeline);
+	// Levels are independent, nothing has to wait between them.
+	for (uint32_t mipLevel = 0; mipLevel < maxMipLevels; mipLevel++)
+	{
+		const uint32_t mippedDim = std::max(uint32_t(dim) >> mipLevel, 1u);
 
-		VkDeviceSize offset = 0;
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, *cubeBuffer, &offset);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prefilterLayout, 0, 1, &prefilterSet, 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, prefilterLayout, 0, 1, &prefilterSets[mipLevel], 0, nullptr);
 
 		float roughness = float(mipLevel) / float(maxMipLevels - 1);
-		vkCmdPushConstants(commandBuffer, prefilterLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(float), &roughness);
+		vkCmdPushConstants(commandBuffer, prefilterLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float), &roughness);
 
-		vkCmdDraw(commandBuffer, cubeVertices.size(), 1, 0, 0);
-
-		vkCmdEndRendering(commandBuffer);
+		vkCmdDispatch(commandBuffer, (mippedDim + 7) / 8, (mippedDim + 7) / 8, 6);
 	}
 
 	vkCmdEndDebugUtilsLabelEXT(commandBuffer);
 
+	img->transition(commandBuffer, ImageUsage::ComputeSampled);
+
 	// image + sampler
 	img->attachCubeMapImageView(range);
 	VkSamplerCreateInfo samplerCI = CreateInfo::SamplerCI(maxMipLevels, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, device_.deviceProperties.limits.maxSamplerAnisotropy);
@@ -252,21 +169,31 @@ std::unique_ptr<Image> PrefilterCubemap::precomputeFilter(VkCommandBuffer comman
 	return img;
 }
 
-std::unique_ptr<Image> PrefilterCubemap::precomputeFilter(VkCommandBuffer commandBuffer, Image* image, int dim, std::vector<VkImageView>& recycling)
+std::unique_ptr<Image> PrefilterCubemap::precomputeFilter(VkCommandBuffer commandBuffer, Image* image, int dim, VkFormat format, std::vector<VkImageView>& recycling)
 {
-	return precomputeFilter(commandBuffer, image->getView(), image->getSampler(), dim, recycling);
+	return precomputeFilter(commandBuffer, image->getView(), image->getSampler(), dim, format, recycling);
 }
 
-std::unique_ptr<Image> PrefilterCubemap::precomputerBRDF(VkCommandBuffer commandBuffer, int width, int height)
+std::unique_ptr<Image> PrefilterCubemap::precomputerBRDF(VkCommandBuffer commandBuffer, int width, int height, VkFormat format)
 {
+	if (format != brdfFormat_)
+	{
+		// Earlier tables may still be rendering with the old one.
+		device_.release([&device = device_, old = brdfPipeline]() {
+			vkDestroyPipeline(device.device, old, nullptr);
+		});
+		brdfPipeline = createBRDFPipeline(format);
+		brdfFormat_ = format;
+	}
+
 	VkExtent2D extent{ uint32_t(width), uint32_t(height) };
 	const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-	VkImageCreateInfo imageCI = CreateInfo::Image2DCI(extent, 1, VK_FORMAT_R16G16_SFLOAT,
+	VkImageCreateInfo imageCI = CreateInfo::Image2DCI(extent, 1, format,
 		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 	auto img = std::make_unique<Image>(device_, imageCI);
 	img->attachImageView(range);
 
-	Transition::UndefinedToColorAttachment(img->get(), commandBuffer, range);
+	img->transition(commandBuffer, ImageUsage::ColorAttachment);
 
 	VkDebugUtilsLabelEXT label{};
 	label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
@@ -317,8 +244,7 @@ PrefilterCubemap::~PrefilterCubemap()
 	vkDestroyPipelineLayout(device_.device, brdfLayout, nullptr);
 	vkDestroyPipeline(device_.device, brdfPipeline, nullptr);
 
-	vkDestroyDescriptorSetLayout(device_.device, prefilterDescLayout, nullptr);
-	vkDestroyDescriptorPool(device_.device, prefilterPool, nullptr);
+	device_.registry.release(prefilterDescLayout);
 	vkDestroyPipelineLayout(device_.device, prefilterLayout, nullptr);
 	vkDestroyPipeline(device_.device, prefilterPipeline, nullptr);
 }
@@ -1,36 +1,46 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
-#include <glm/glm.hpp>
+#include <array>
 #include <memory>
 #include <vector>
 
 class Device;
 class Image;
-class Buffer;
 class PrefilterCubemap
 {
 public:
-	PrefilterCubemap(Device& device, const std::shared_ptr<Buffer>& cubeBuffer);
+	PrefilterCubemap(Device& device);
 
-	std::unique_ptr<Image> precomputeFilter(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler, int dim, std::vector<VkImageView>& recycling);
-	std::unique_ptr<Image> precomputeFilter(VkCommandBuffer commandBuffer, Image* image, int dim, std::vector<VkImageView>& recycling);
-	std::unique_ptr<Image> precomputerBRDF(VkCommandBuffer commandBuffer, int width, int height);
+	/**
+	 * @brief Specular convolution, in a compute shader so it can run on the compute queue.
+	 * @param imageView Of an environment cubemap moved to compute sampled by the caller.
+	 * @param format One with hdrColorFeatures (see HdrPrecision.h).
+	 * @param recycling Views the commands use, destroy them once the commands have completed.
+	 * @return Left in compute sampled, and shared with the graphics queue.
+	*/
+	std::unique_ptr<Image> precomputeFilter(VkCommandBuffer commandBuffer, VkImageView imageView, VkSampler sampler, int dim, VkFormat format, std::vector<VkImageView>& recycling);
+	std::unique_ptr<Image> precomputeFilter(VkCommandBuffer commandBuffer, Image* image, int dim, VkFormat format, std::vector<VkImageView>& recycling);
+	/**
+	 * @brief A render pass, storage writes to two-channel formats are optional in Vulkan.
+	 * @param format One with hdrLutFeatures (see HdrPrecision.h).
+	*/
+	std::unique_ptr<Image> precomputerBRDF(VkCommandBuffer commandBuffer, int width, int height, VkFormat format);
 
 	~PrefilterCubemap();
 private:
 	Device& device_;
+	static constexpr uint32_t maxMipLevels = 5;
+
 	// Prefilter
 	VkDescriptorSetLayout prefilterDescLayout{};
-	VkDescriptorPool prefilterPool{};
-	VkDescriptorSet prefilterSet{};
+	std::array<VkDescriptorSet, maxMipLevels> prefilterSets{}; // One per mip level, all recorded before any runs.
 	VkPipelineLayout prefilterLayout{};
 	VkPipeline prefilterPipeline{};
 
 	// BRDF
+	VkPipeline createBRDFPipeline(VkFormat format) const;
 	VkPipelineLayout brdfLayout{};
 	VkPipeline brdfPipeline{};
-
-	std::shared_ptr<Buffer> cubeBuffer;
-	std::unique_ptr<Buffer> uniformBuffer;
+	VkFormat brdfFormat_ = VK_FORMAT_UNDEFINED; // Rendered to by brdfPipeline.
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "../src/Common/BlockCache.h"
+
+#include <algorithm>
+
+namespace {
+	using Cache = BlockCache<int, int>;
+	const auto ignore = [](int) {};
+}
+
+TEST(BlockCache, ReleasedBlockWaitsForItsFrame) {
+	Cache cache(2, 100);
+	cache.beginFrame(0, ignore);
+	cache.release(1, 256, 7);
+	ASSERT_FALSE(cache.acquire(1, 256));
+
+	cache.beginFrame(1, ignore);
+	ASSERT_FALSE(cache.acquire(1, 256));
+
+	cache.beginFrame(0, ignore);
+	ASSERT_EQ(cache.acquire(1, 256), 7);
+	ASSERT_FALSE(cache.acquire(1, 256));
+}
+
+TEST(BlockCache, OnlyMatchingKeysThatFit) {
+	Cache cache(1, 100);
+	cache.release(1, 256, 7);
+	cache.beginFrame(0, ignore);
+	ASSERT_FALSE(cache.acquire(2, 256));
+	ASSERT_FALSE(cache.acquire(1, 300));
+	ASSERT_FALSE(cache.acquire(1, 100)); // Would waste more than half.
+	ASSERT_EQ(cache.acquire(1, 200), 7);
+}
+
+TEST(BlockCache, PicksTheSmallestThatFits) {
+	Cache cache(1, 100);
+	cache.release(1, 512, 1);
+	cache.release(1, 300, 2);
+	cache.release(1, 400, 3);
+	cache.beginFrame(0, ignore);
+	ASSERT_EQ(cache.acquire(1, 280), 2);
+	ASSERT_EQ(cache.acquire(1, 280), 3);
+	ASSERT_EQ(cache.getFreeCount(), 1u);
+}
+
+TEST(BlockCache, EvictsBlocksUnusedForTooLong) {
+	Cache cache(1, 2);
+	std::vector<int> evicted;
+	const auto evict = [&](int block) { evicted.push_back(block); };
+	cache.release(1, 256, 7);
+	cache.beginFrame(0, evict);
+	cache.beginFrame(0, evict);
+	cache.beginFrame(0, evict);
+	ASSERT_TRUE(evicted.empty());
+	cache.beginFrame(0, evict);
+	ASSERT_EQ(evicted, std::vector<int>{ 7 });
+	ASSERT_EQ(cache.getFreeCount(), 0u);
+}
+
+TEST(BlockCache, ClearHandsBackPendingBlocks) {
+	Cache cache(2, 100);
+	std::vector<int> evicted;
+	cache.release(1, 256, 7);
+	cache.beginFrame(1, [](int) {});
+	cache.release(2, 256, 8);
+	cache.clear([&](int block) { evicted.push_back(block); });
+	std::sort(evicted.begin(), evicted.end());
+	ASSERT_EQ(evicted, (std::vector<int>{ 7, 8 }));
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "../src/Common/CompileQueue.h"
+
+#include <BS_thread_pool.hpp>
+#include <future>
+
+namespace {
+	// Stands in for a pipeline handle, null until compiled.
+	using Pipeline = const int*;
+	const int fallback = 0;
+	const int specialized = 1;
+
+	// As Scene::getDrawables picks the pipeline of a submesh.
+	Pipeline select(const std::atomic<Pipeline>& variant)
+	{
+		const Pipeline pipeline = variant.load(std::memory_order_acquire);
+		return pipeline ? pipeline : &fallback;
+	}
+}
+
+TEST(CompileQueue, FrameRecordedDuringCompileUsesFallback) {
+	CompileQueue compiles(1);
+	BS::thread_pool workers(2);
+
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	std::atomic<Pipeline> variant{ nullptr };
+	compiles.compile(variant, [released]() {
+		released.wait();
+		return &specialized;
+	});
+	ASSERT_EQ(compiles.getPending(), 1);
+
+	// A frame's work on the workers, waited on as a frame does, while the compile is still blocked.
+	std::atomic<Pipeline> drawn{ nullptr };
+	workers.detach_task([&]() { drawn = select(variant); });
+	workers.wait();
+	ASSERT_EQ(drawn.load(), &fallback);
+
+	release.set_value();
+	compiles.wait();
+	ASSERT_EQ(compiles.getPending(), 0);
+	ASSERT_EQ(select(variant), &specialized);
+}
+
+TEST(CompileQueue, FastLinkIsDrawnUntilOptimizedLinkReplacesIt) {
+	CompileQueue compiles(1);
+	BS::thread_pool workers(2);
+
+	const int fastLinked = 2;
+	std::atomic<Pipeline> variant{ &fastLinked };
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	Pipeline retired = nullptr;
+	compiles.run([&, released]() {
+		released.wait();
+		retired = variant.exchange(&specialized, std::memory_order_acq_rel);
+	});
+
+	std::atomic<Pipeline> drawn{ nullptr };
+	workers.detach_task([&]() { drawn = select(variant); });
+	workers.wait();
+	ASSERT_EQ(drawn.load(), &fastLinked);
+	ASSERT_EQ(compiles.getPending(), 1);
+
+	release.set_value();
+	compiles.wait();
+	ASSERT_EQ(select(variant), &specialized);
+	ASSERT_EQ(retired, &fastLinked);
+}
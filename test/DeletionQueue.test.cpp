@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "../src/Common/DeletionQueue.h"
+
+#include <thread>
+
+namespace {
+	// Keyed on the frame that may still use the object, complete once that frame has.
+	const auto completedUpTo = [](uint64_t completed) {
+		return [completed](uint64_t frame) { return frame <= completed; };
+	};
+}
+
+TEST(DeletionQueue, RunsOnceItsWorkHasCompleted) {
+	DeletionQueue queue;
+	std::vector<int> destroyed;
+
+	queue.push(1, [&]() { destroyed.push_back(1); });
+	queue.push(2, [&]() { destroyed.push_back(2); });
+	ASSERT_EQ(queue.getPending(), 2u);
+
+	ASSERT_EQ(queue.collect(completedUpTo(0)), 0u);
+	ASSERT_TRUE(destroyed.empty());
+	ASSERT_EQ(queue.collect(completedUpTo(1)), 1u);
+	ASSERT_EQ(destroyed, std::vector<int>{ 1 });
+	queue.collect(completedUpTo(2));
+	ASSERT_EQ(destroyed, (std::vector<int>{ 1, 2 }));
+	ASSERT_EQ(queue.getPending(), 0u);
+}
+
+TEST(DeletionQueue, LaterKeysMayCompleteFirst) {
+	DeletionQueue queue;
+	std::vector<int> destroyed;
+
+	// Work on different queues completes out of order.
+	queue.push(5, [&]() { destroyed.push_back(5); });
+	queue.push(3, [&]() { destroyed.push_back(3); });
+	queue.collect([](uint64_t key) { return key == 3; });
+	ASSERT_EQ(destroyed, std::vector<int>{ 3 });
+	ASSERT_EQ(queue.getPending(), 1u);
+}
+
+TEST(DeletionQueue, FlushRunsEverythingInPushOrder) {
+	DeletionQueue queue;
+	std::vector<int> destroyed;
+	for (int i = 0; i < 3; i++) {
+		queue.push(100 - i, [&, i]() { destroyed.push_back(i); });
+	}
+	// Destroying one object can release another.
+	queue.push(0, [&]() { queue.push(1000, [&]() { destroyed.push_back(3); }); });
+	queue.flush();
+	ASSERT_EQ(destroyed, (std::vector<int>{ 0, 1, 2, 3 }));
+	ASSERT_EQ(queue.getPending(), 0u);
+}
+
+TEST(DeletionQueue, PushFromManyThreads) {
+	DeletionQueue queue;
+	std::atomic<int> destroyed = 0;
+	constexpr int threadCount = 4;
+	constexpr int perThread = 1000;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&]() {
+			for (int i = 0; i < perThread; i++) {
+				queue.push(i, [&]() { destroyed++; });
+			}
+		});
+	}
+	// Collect while producers run.
+	while (destroyed < threadCount * perThread / 2) {
+		queue.collect(completedUpTo(perThread));
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	queue.collect(completedUpTo(perThread));
+	ASSERT_EQ(destroyed, threadCount * perThread);
+	ASSERT_EQ(queue.getPending(), 0u);
+}
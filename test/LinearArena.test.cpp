@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "../src/Common/LinearArena.h"
+
+#include <algorithm>
+
+TEST(LinearArena, AllocationsAreAligned) {
+	LinearArena arena(256);
+	arena.allocate(1, 1);
+	void* a = arena.allocate(4, 16);
+	ASSERT_EQ(reinterpret_cast<uintptr_t>(a) % 16, 0);
+	void* b = arena.allocate(8, 8);
+	ASSERT_EQ(reinterpret_cast<uintptr_t>(b) % 8, 0);
+	ASSERT_GE(static_cast<std::byte*>(b), static_cast<std::byte*>(a) + 4);
+}
+
+TEST(LinearArena, OverflowKeepsEarlierAllocations) {
+	LinearArena arena(64);
+	auto* first = static_cast<int*>(arena.allocate(sizeof(int) * 8, alignof(int)));
+	std::fill(first, first + 8, 7);
+	auto* second = static_cast<int*>(arena.allocate(sizeof(int) * 32, alignof(int)));
+	std::fill(second, second + 32, 9);
+
+	ASSERT_EQ(arena.getHeapAllocations(), 2);
+	ASSERT_TRUE(std::all_of(first, first + 8, [](int value) { return value == 7; }));
+}
+
+TEST(LinearArena, SteadyFramesStopAllocating) {
+	LinearArena arena(64);
+	const auto frame = [&]() {
+		arena.reset();
+		ArenaVector<int> values{ arena };
+		for (int i = 0; i < 1000; i++)
+		{
+			values.push_back(i);
+		}
+		ASSERT_EQ(values.back(), 999);
+	};
+
+	frame();
+	frame();
+	const auto allocations = arena.getHeapAllocations();
+	for (int i = 0; i < 10; i++)
+	{
+		frame();
+	}
+	ASSERT_EQ(arena.getHeapAllocations(), allocations);
+}
+
+TEST(LinearArena, DefaultAllocatorUsesHeap) {
+	ArenaVector<int> values;
+	values.assign(100, 3);
+	ASSERT_EQ(values.get_allocator().getArena(), nullptr);
+
+	LinearArena arena;
+	values = ArenaVector<int>(arena);
+	values.push_back(1);
+	ASSERT_EQ(values.get_allocator().getArena(), &arena);
+	ASSERT_GT(arena.getUsed(), 0);
+}
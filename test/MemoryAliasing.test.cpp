@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+#include "../src/Common/MemoryAliasing.h"
+
+TEST(MemoryAliasing, DisjointLifetimesShareMemory) {
+	const std::vector<AliasRequest> requests = { { 256, 64, 0, 1 }, { 128, 64, 2, 3 } };
+	const auto placement = placeAliased(requests);
+	ASSERT_EQ(placement.offsets, (std::vector<uint64_t>{ 0, 0 }));
+	ASSERT_EQ(placement.size, 256u);
+	ASSERT_TRUE(placement.overlapsInMemory(requests, 0, 1));
+}
+
+TEST(MemoryAliasing, OverlappingLifetimesAreKeptApart) {
+	const std::vector<AliasRequest> requests = { { 100, 64, 0, 2 }, { 256, 64, 1, 1 } };
+	const auto placement = placeAliased(requests);
+	// The larger goes first, the smaller starts at the next aligned offset after it.
+	ASSERT_EQ(placement.offsets, (std::vector<uint64_t>{ 256, 0 }));
+	ASSERT_EQ(placement.size, 356u);
+	ASSERT_FALSE(placement.overlapsInMemory(requests, 0, 1));
+}
+
+TEST(MemoryAliasing, FillsGapsBetweenLiveResources) {
+	const std::vector<AliasRequest> requests = {
+		{ 256, 256, 0, 3 },
+		{ 256, 256, 0, 0 },
+		{ 256, 256, 0, 3 },
+		{ 128, 128, 2, 3 } // Fits where the second was.
+	};
+	const auto placement = placeAliased(requests);
+	ASSERT_EQ(placement.offsets, (std::vector<uint64_t>{ 0, 256, 512, 256 }));
+	ASSERT_EQ(placement.size, 768u);
+}
+
+TEST(MemoryAliasing, RespectsAlignment) {
+	const std::vector<AliasRequest> requests = { { 300, 4, 0, 0 }, { 100, 1024, 0, 0 } };
+	const auto placement = placeAliased(requests);
+	ASSERT_EQ(placement.offsets[1], 1024u);
+	ASSERT_EQ(placement.size, 1124u);
+}
@@ -0,0 +1,29 @@
+#include <gtest/gtest.h>
+#include "../src/Common/MipChain.h"
+
+TEST(MipChain, StopsAtMinimumExtent) {
+	// Bloom of a 1080p frame starts at half resolution.
+	ASSERT_EQ(getMipLevels(960, 540, 16, 12), 6u); // 540, 270, 135, 67, 33, 16
+	ASSERT_EQ(getMipLevels(1920, 1080, 16, 12), 7u);
+	ASSERT_EQ(getMipLevels(640, 360, 16, 12), 5u);
+}
+
+TEST(MipChain, AtLeastOneAtMostMax) {
+	ASSERT_EQ(getMipLevels(4, 4, 16, 12), 1u);
+	ASSERT_EQ(getMipLevels(1, 1, 1, 12), 1u);
+	ASSERT_EQ(getMipLevels(1u << 20, 1u << 20, 1, 12), 12u);
+	ASSERT_EQ(getMipLevels(64, 64, 1, 12), 7u);
+}
+
+TEST(MipChain, TilesCoverTheFirstLevel) {
+	const auto tiles = getDownsampleTiles(960, 540);
+	ASSERT_EQ(tiles.groupsX, 15u);
+	ASSERT_EQ(tiles.groupsY, 9u); // 540 / 64 rounded up.
+	ASSERT_EQ(tiles.getGroupCount(), 135u);
+	ASSERT_TRUE(tiles.fitsLastGroup());
+
+	ASSERT_EQ(getDownsampleTiles(64, 64).getGroupCount(), 1u);
+	ASSERT_EQ(getDownsampleTiles(65, 1).getGroupCount(), 2u);
+	ASSERT_TRUE(getDownsampleTiles(4096, 4096).fitsLastGroup());
+	ASSERT_FALSE(getDownsampleTiles(4097, 16).fitsLastGroup());
+}
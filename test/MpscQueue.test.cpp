@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include "../src/Common/MpscQueue.h"
+
+#include <memory>
+#include <thread>
+
+TEST(MpscQueue, DrainsInPushOrder) {
+	MpscQueue<int> queue;
+	ASSERT_TRUE(queue.empty());
+	for (int i = 0; i < 4; i++) {
+		queue.push(i);
+	}
+	std::vector<int> drained;
+	ASSERT_EQ(queue.drain([&](int value) { drained.push_back(value); }), 4u);
+	ASSERT_EQ(drained, (std::vector<int>{ 0, 1, 2, 3 }));
+	ASSERT_TRUE(queue.empty());
+}
+
+TEST(MpscQueue, EveryThreadKeepsItsOrder) {
+	MpscQueue<std::pair<int, int>> queue;
+	constexpr int threadCount = 4;
+	constexpr int perThread = 10000;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < perThread; i++) {
+				queue.push({ t, i });
+			}
+		});
+	}
+
+	std::vector<int> next(threadCount, 0);
+	int drained = 0;
+	const auto consume = [&](std::pair<int, int> value) {
+		ASSERT_EQ(value.second, next[value.first]);
+		next[value.first]++;
+		drained++;
+	};
+	while (drained < threadCount * perThread) {
+		queue.drain(consume);
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	ASSERT_TRUE(queue.empty());
+}
+
+TEST(MpscQueue, DestroysWhatWasNotDrained) {
+	auto value = std::make_shared<int>(0);
+	{
+		MpscQueue<std::shared_ptr<int>> queue;
+		queue.push(value);
+		ASSERT_EQ(value.use_count(), 2);
+	}
+	ASSERT_EQ(value.use_count(), 1);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "../src/Render/OcclusionCulling.h"
+
+#include <BS_thread_pool.hpp>
+#include <random>
+
+namespace {
+	// Identity view projection: clip space is the world, x and y in [-1, 1], z in [0, 1].
+	const glm::mat4 identity{ 1.0f };
+
+	void addQuad(OcclusionCuller& culler, float size, float z)
+	{
+		const glm::vec3 positions[] = { {-size, -size, z}, {size, -size, z}, {size, size, z}, {-size, size, z} };
+		const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+		culler.addOccluder(positions, indices, 6, identity);
+	}
+
+	BoundingBox box(glm::vec3 min, glm::vec3 max)
+	{
+		BoundingBox bounds;
+		bounds.expand(min);
+		bounds.expand(max);
+		return bounds;
+	}
+}
+
+TEST(OcclusionCulling, EmptyBufferKeepsEverything) {
+	OcclusionCuller culler(64, 64);
+	culler.begin(identity);
+	culler.rasterize();
+
+	ASSERT_TRUE(culler.isVisible(box({ -0.1f, -0.1f, 0.8f }, { 0.1f, 0.1f, 0.9f }), identity));
+	ASSERT_EQ(culler.getStats().culled, 0);
+}
+
+TEST(OcclusionCulling, OccluderHidesBoxBehind) {
+	OcclusionCuller culler(64, 64);
+	culler.begin(identity);
+	addQuad(culler, 0.5f, 0.25f);
+	culler.rasterize();
+
+	ASSERT_FLOAT_EQ(culler.getDepth(32, 32), 0.25f);
+	ASSERT_FLOAT_EQ(culler.getDepth(0, 0), 1.0f);
+
+	ASSERT_FALSE(culler.isVisible(box({ -0.2f, -0.2f, 0.5f }, { 0.2f, 0.2f, 0.6f }), identity));
+	ASSERT_TRUE(culler.isVisible(box({ -0.2f, -0.2f, 0.1f }, { 0.2f, 0.2f, 0.6f }), identity)); // Pokes through.
+	ASSERT_TRUE(culler.isVisible(box({ 0.4f, 0.4f, 0.5f }, { 0.7f, 0.7f, 0.6f }), identity)); // Partly uncovered.
+	ASSERT_EQ(culler.getStats().culled, 1);
+}
+
+TEST(OcclusionCulling, OutsideFrustumIsCulled) {
+	OcclusionCuller culler(64, 64);
+	culler.begin(identity);
+	culler.rasterize();
+
+	ASSERT_FALSE(culler.isVisible(box({ 1.5f, 1.5f, 0.5f }, { 2.0f, 2.0f, 0.6f }), identity));
+	ASSERT_FALSE(culler.isVisible(box({ -0.1f, -0.1f, 1.5f }, { 0.1f, 0.1f, 1.6f }), identity));
+}
+
+TEST(OcclusionCulling, WindingDoesNotMatter) {
+	OcclusionCuller culler(64, 64);
+	culler.begin(identity);
+	const glm::vec3 positions[] = { {-1, -1, 0.5f}, {1, -1, 0.5f}, {1, 1, 0.5f} };
+	const uint32_t clockwise[] = { 0, 2, 1 };
+	culler.addOccluder(positions, clockwise, 3, identity);
+	culler.rasterize();
+
+	ASSERT_FLOAT_EQ(culler.getDepth(60, 4), 0.5f);
+	ASSERT_FLOAT_EQ(culler.getDepth(4, 60), 1.0f);
+}
+
+TEST(OcclusionCulling, ThreadedMatchesSerial) {
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> xy(-1.2f, 1.2f);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	for (uint32_t i = 0; i < 3000; i++)
+	{
+		positions.push_back({ xy(rng), xy(rng), depth(rng) });
+		indices.push_back(i);
+	}
+
+	OcclusionCuller serial(320, 192);
+	serial.begin(identity);
+	serial.addOccluder(positions.data(), indices.data(), indices.size(), identity);
+	serial.rasterize();
+
+	BS::thread_pool pool;
+	OcclusionCuller threaded(320, 192);
+	threaded.begin(identity);
+	threaded.addOccluder(positions.data(), indices.data(), indices.size(), identity);
+	threaded.rasterize(&pool);
+
+	ASSERT_GT(serial.getStats().occluderTriangles, 0);
+	ASSERT_EQ(serial.getStats().occluderTriangles, threaded.getStats().occluderTriangles);
+
+	for (uint32_t y = 0; y < serial.getHeight(); y++)
+	{
+		for (uint32_t x = 0; x < serial.getWidth(); x++)
+		{
+			ASSERT_EQ(serial.getDepth(x, y), threaded.getDepth(x, y));
+		}
+	}
+}
+
+TEST(OcclusionCulling, DepthIsTheFarthestInEachPixel) {
+	OcclusionCuller culler(64, 64);
+	culler.begin(identity);
+	// Depth goes from 0.2 on the left to 0.8 on the right.
+	const glm::vec3 positions[] = { {-1, -1, 0.2f}, {1, -1, 0.8f}, {1, 1, 0.8f}, {-1, 1, 0.2f} };
+	const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+	culler.addOccluder(positions, indices, 6, identity);
+	culler.rasterize();
+
+	for (uint32_t x = 0; x < culler.getWidth(); x++)
+	{
+		const float farthest = 0.2f + 0.6f * float(x + 1) / float(culler.getWidth());
+		ASSERT_GE(culler.getDepth(x, 32), farthest - 1e-5f);
+		ASSERT_LE(culler.getDepth(x, 32), farthest + 0.6f / float(culler.getWidth()));
+	}
+}
+
+TEST(OcclusionCulling, GapOfAPixelKeepsWhatIsBehind) {
+	OcclusionCuller culler(64, 64);
+	culler.begin(identity);
+	// Two walls with a gap of 1.5 pixels between x = 32 and x = 33.5.
+	const float gapBegin = 0.0f;
+	const float gapEnd = 1.5f * 2.0f / 64.0f;
+	const glm::vec3 positions[] = {
+		{-1, -1, 0.25f}, {gapBegin, -1, 0.25f}, {gapBegin, 1, 0.25f}, {-1, 1, 0.25f},
+		{gapEnd, -1, 0.25f}, {1, -1, 0.25f}, {1, 1, 0.25f}, {gapEnd, 1, 0.25f}
+	};
+	const uint32_t indices[] = { 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7 };
+	culler.addOccluder(positions, indices, 12, identity);
+	culler.rasterize();
+
+	// Behind the gap, thinner than it.
+	ASSERT_TRUE(culler.isVisible(box({ gapBegin + 0.01f, -0.2f, 0.5f }, { gapEnd - 0.01f, 0.2f, 0.6f }), identity));
+	ASSERT_FALSE(culler.isVisible(box({ -0.8f, -0.2f, 0.5f }, { -0.4f, 0.2f, 0.6f }), identity));
+}
+
+TEST(OcclusionCulling, SimplifiedOccluderKeepsTheLargestTriangles) {
+	// A large quad among slivers that grow along the list.
+	std::vector<glm::vec3> positions = { {-1, -1, 0}, {1, -1, 0}, {1, 1, 0}, {-1, 1, 0} };
+	std::vector<uint32_t> indices;
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		const auto first = static_cast<uint32_t>(positions.size());
+		const float x = 2.0f + float(i);
+		const float size = 0.01f * float(i + 1);
+		positions.insert(positions.end(), { {x, 0, 0}, {x + size, 0, 0}, {x, size, 0} });
+		indices.insert(indices.end(), { first, first + 1, first + 2 });
+	}
+	indices.insert(indices.begin() + 150, { 0, 1, 2, 0, 2, 3 });
+
+	// The quad and the two largest slivers, which come after it.
+	const auto mesh = simplifyOccluder(positions.data(), indices.data(), indices.size(), 4);
+	ASSERT_EQ(mesh.indices.size(), 12);
+	ASSERT_EQ(mesh.positions.size(), 10);
+	ASSERT_EQ(mesh.positions[mesh.indices[0]], positions[0]);
+	ASSERT_EQ(mesh.positions[mesh.indices[1]], positions[1]);
+	ASSERT_EQ(mesh.positions[mesh.indices[2]], positions[2]);
+	ASSERT_EQ(mesh.positions[mesh.indices[5]], positions[3]);
+	ASSERT_EQ(mesh.positions[mesh.indices[11]], positions.back());
+
+	const auto whole = simplifyOccluder(positions.data(), indices.data(), indices.size(), 1000);
+	ASSERT_EQ(whole.indices.size(), indices.size());
+}
@@ -0,0 +1,26 @@
+#include <gtest/gtest.h>
+#include "../src/Common/Overlap.h"
+
+#include <vector>
+
+TEST(Overlap, NothingCoversWithoutOthers) {
+	ASSERT_EQ(covered({ 1.0, 2.0 }, {}), 0.0);
+}
+
+TEST(Overlap, ClipsToTheInterval) {
+	std::vector<Interval> others{ { 0.0, 1.5 }, { 1.75, 5.0 } };
+	ASSERT_DOUBLE_EQ(covered({ 1.0, 2.0 }, others), 0.75);
+}
+
+TEST(Overlap, CountsOverlappingOthersOnce) {
+	// Out of order, nested and overlapping, as passes of two readbacks are.
+	std::vector<Interval> others{ { 3.0, 4.0 }, { 0.0, 2.0 }, { 0.5, 1.0 }, { 1.5, 3.5 } };
+	ASSERT_DOUBLE_EQ(covered({ 0.0, 10.0 }, others), 4.0);
+}
+
+TEST(Overlap, DisjointIntervalsDoNotOverlap) {
+	std::vector<Interval> others{ { 0.0, 1.0 }, { 2.0, 3.0 } };
+	ASSERT_EQ(covered({ 1.0, 2.0 }, others), 0.0);
+	ASSERT_EQ(covered({ 5.0, 4.0 }, others), 0.0);
+	ASSERT_EQ(Interval({ 5.0, 4.0 }).length(), 0.0);
+}
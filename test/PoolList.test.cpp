@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "../src/Common/PoolList.h"
+
+namespace {
+	// Stands in for DescriptorAllocator, a pool is an index into capacities and grows the same way.
+	struct FakeAllocator
+	{
+		PoolList<uint32_t> list;
+		std::vector<uint32_t> capacities;
+		std::vector<uint32_t> used;
+		uint32_t setsPerPool = 8;
+
+		void allocate(uint32_t count) {
+			const bool allocated = list.allocate([&](uint32_t pool) {
+				if (used[pool] + count > capacities[pool]) {
+					return false;
+				}
+				used[pool] += count;
+				return true;
+			});
+			if (allocated) {
+				return;
+			}
+			setsPerPool = std::max(setsPerPool, count);
+			const auto pool = static_cast<uint32_t>(capacities.size());
+			capacities.push_back(setsPerPool);
+			used.push_back(count);
+			list.add(pool, setsPerPool);
+			setsPerPool = std::min(512u, setsPerPool + setsPerPool / 2 + 1);
+		}
+
+		void reset() {
+			std::fill(used.begin(), used.end(), 0);
+			list.reset();
+		}
+	};
+}
+
+TEST(PoolList, PoolCountStaysFixedAcrossFrames) {
+	FakeAllocator allocator;
+	const auto frame = [&]() {
+		// As bloom, a set per mip level, then a few at once.
+		for (int level = 0; level < 11; level++) {
+			allocator.allocate(1);
+		}
+		allocator.allocate(3);
+		allocator.reset();
+	};
+
+	for (int i = 0; i < 3; i++) {
+		frame();
+	}
+	const size_t pools = allocator.list.size();
+	for (int i = 0; i < 32; i++) {
+		frame();
+		ASSERT_EQ(allocator.list.size(), pools);
+	}
+}
+
+TEST(PoolList, TriesEveryPoolBeforeCreating) {
+	PoolList<uint32_t> list;
+	std::vector<uint32_t> free = { 4, 1 };
+	list.add(0, 4);
+	list.add(1, 1);
+	const auto take = [&](uint32_t pool) {
+		if (free[pool] == 0) {
+			return false;
+		}
+		free[pool]--;
+		return true;
+	};
+
+	ASSERT_TRUE(list.allocate(take));
+	ASSERT_EQ(free[1], 0);
+	ASSERT_TRUE(list.allocate(take));
+	ASSERT_EQ(free[0], 3);
+	ASSERT_EQ(list.size(), 2);
+}
+
+TEST(PoolList, LargestIsTriedFirstAfterReset) {
+	PoolList<uint32_t> list;
+	list.add(0, 2);
+	list.add(1, 8);
+	list.add(2, 4);
+	ASSERT_FALSE(list.allocate([](uint32_t) { return false; }));
+	list.reset();
+
+	std::vector<uint32_t> tried;
+	list.allocate([&](uint32_t pool) {
+		tried.push_back(pool);
+		return false;
+	});
+	ASSERT_EQ(tried, std::vector<uint32_t>({ 1, 2, 0 }));
+}
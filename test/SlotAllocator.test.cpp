@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include "../src/Common/SlotAllocator.h"
+
+TEST(SlotAllocator, IndicesAreDense) {
+	SlotAllocator slots(4, 16, 2);
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		ASSERT_EQ(slots.allocate().id, i);
+	}
+	ASSERT_EQ(slots.getUsed(), 4);
+	ASSERT_EQ(slots.getCapacity(), 4);
+}
+
+TEST(SlotAllocator, FreedSlotWaitsForItsFrame) {
+	SlotAllocator slots(4, 16, 2);
+	slots.beginFrame(0);
+	const auto a = slots.allocate();
+	slots.allocate();
+
+	slots.free(a);
+	ASSERT_FALSE(slots.isValid(a));
+	ASSERT_EQ(slots.getUsed(), 1);
+
+	// Frame 1 may still be using frame 0's descriptors.
+	slots.beginFrame(1);
+	ASSERT_EQ(slots.allocate().id, 2);
+
+	slots.beginFrame(0);
+	const auto reused = slots.allocate();
+	ASSERT_EQ(reused.id, a.id);
+	ASSERT_NE(reused.generation, a.generation);
+	ASSERT_TRUE(slots.isValid(reused));
+	ASSERT_FALSE(slots.isValid(a));
+}
+
+TEST(SlotAllocator, GrowsUpToMax) {
+	SlotAllocator slots(2, 5, 1);
+	for (int i = 0; i < 3; i++)
+	{
+		slots.allocate();
+	}
+	ASSERT_EQ(slots.getCapacity(), 4);
+	slots.allocate();
+	slots.allocate();
+	ASSERT_EQ(slots.getCapacity(), 5);
+	ASSERT_THROW(slots.allocate(), std::length_error);
+
+	// Pending slots do not count as free until retired.
+	slots.free({ .id = 0, .generation = 0 });
+	ASSERT_THROW(slots.allocate(), std::length_error);
+	slots.beginFrame(0);
+	ASSERT_EQ(slots.allocate().id, 0);
+}
+
+TEST(SlotAllocator, DoubleFreeIsIgnored) {
+	SlotAllocator slots(4, 4, 1);
+	const auto a = slots.allocate();
+	slots.free(a);
+	slots.free(a);
+	ASSERT_EQ(slots.getUsed(), 0);
+	slots.beginFrame(0);
+	ASSERT_EQ(slots.allocate().id, 0);
+	ASSERT_EQ(slots.allocate().id, 1);
+}
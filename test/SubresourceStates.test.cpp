@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "../src/Common/SubresourceStates.h"
+
+#include <tuple>
+
+namespace {
+	using Region = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, int>; // baseMip, levelCount, baseLayer, layerCount, state
+
+	std::vector<Region> runs(const SubresourceStates<int>& states, uint32_t baseMip, uint32_t levelCount, uint32_t baseLayer, uint32_t layerCount)
+	{
+		std::vector<Region> result;
+		states.forEachRun(baseMip, levelCount, baseLayer, layerCount, [&](uint32_t mip, uint32_t levels, uint32_t layer, uint32_t layers, int state) {
+			result.emplace_back(mip, levels, layer, layers, state);
+		});
+		return result;
+	}
+}
+
+TEST(SubresourceStates, UniformImageIsOneRun) {
+	SubresourceStates<int> states(5, 6, 1);
+	ASSERT_EQ(runs(states, 0, 5, 0, 6), std::vector<Region>{ Region(0, 5, 0, 6, 1) });
+}
+
+TEST(SubresourceStates, MipsSplitWhereStateChanges) {
+	SubresourceStates<int> states(5, 1);
+	states.set(0, 2, 0, 1, 7);
+	states.set(4, 1, 0, 1, 3);
+	const std::vector<Region> expected = { Region(0, 2, 0, 1, 7), Region(2, 2, 0, 1, 0), Region(4, 1, 0, 1, 3) };
+	ASSERT_EQ(runs(states, 0, 5, 0, 1), expected);
+
+	// Only the asked range is visited.
+	ASSERT_EQ(runs(states, 1, 2, 0, 1), (std::vector<Region>{ Region(1, 1, 0, 1, 7), Region(2, 1, 0, 1, 0) }));
+}
+
+TEST(SubresourceStates, LayersWithEqualMipsAreJoined) {
+	SubresourceStates<int> states(3, 6);
+	states.set(0, 1, 0, 6, 2);
+	states.set(2, 1, 4, 2, 5);
+	const std::vector<Region> expected = {
+		Region(0, 1, 0, 4, 2), Region(1, 2, 0, 4, 0),
+		Region(0, 1, 4, 2, 2), Region(1, 1, 4, 2, 0), Region(2, 1, 4, 2, 5)
+	};
+	ASSERT_EQ(runs(states, 0, 3, 0, 6), expected);
+}
+
+TEST(SubresourceStates, SetOnlyTouchesItsRange) {
+	SubresourceStates<int> states(4, 2);
+	states.set(1, 2, 1, 1, 9);
+	for (uint32_t layer = 0; layer < 2; layer++)
+	{
+		for (uint32_t mip = 0; mip < 4; mip++)
+		{
+			ASSERT_EQ(states.get(mip, layer), (layer == 1 && (mip == 1 || mip == 2)) ? 9 : 0);
+		}
+	}
+}
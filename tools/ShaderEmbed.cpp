@@ -0,0 +1,150 @@
+// Build step: turns a SPIR-V binary into a header holding the code and its reflection as constexpr tables.
+// Usage: ShaderEmbed <input.spv> <output.h> <name>, where name is the source file name, e.g. PBR.vert.
+
+#include <spirv_cross.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+	struct Resource
+	{
+		uint32_t set;
+		uint32_t binding;
+		const char* type;
+
+		auto tied() const { return std::tie(set, binding); }
+		bool operator<(const Resource& rhs) const { return tied() < rhs.tied(); }
+	};
+
+	std::vector<uint32_t> readSpirv(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			return {};
+		}
+		const size_t size = file.tellg();
+		std::vector<uint32_t> spirv(size / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+		return spirv;
+	}
+
+	const char* getStage(spv::ExecutionModel model)
+	{
+		switch (model)
+		{
+		case spv::ExecutionModelVertex:
+			return "VK_SHADER_STAGE_VERTEX_BIT";
+		case spv::ExecutionModelFragment:
+			return "VK_SHADER_STAGE_FRAGMENT_BIT";
+		case spv::ExecutionModelGLCompute:
+			return "VK_SHADER_STAGE_COMPUTE_BIT";
+		default:
+			return nullptr;
+		}
+	}
+
+	std::string getIdentifier(std::string name)
+	{
+		std::replace_if(name.begin(), name.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+		return name;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 4)
+	{
+		std::cerr << "Usage: ShaderEmbed <input.spv> <output.h> <name>\n";
+		return 1;
+	}
+	const std::string input = argv[1];
+	const std::string output = argv[2];
+	const std::string name = argv[3];
+	const std::string identifier = getIdentifier(name);
+
+	auto spirv = readSpirv(input);
+	if (spirv.empty())
+	{
+		std::cerr << "Failed to read SPIR-V from " << input << "\n";
+		return 1;
+	}
+
+	spirv_cross::Compiler compiler(spirv);
+	const char* stage = getStage(compiler.get_execution_model());
+	if (!stage)
+	{
+		std::cerr << "Unsupported shader stage in " << input << "\n";
+		return 1;
+	}
+
+	// Same resources the runtime reflection used to look at, dynamic offsets are still chosen by the caller.
+	const auto resources = compiler.get_shader_resources();
+	std::vector<Resource> table;
+	for (const auto& uniform : resources.uniform_buffers)
+	{
+		table.push_back({ compiler.get_decoration(uniform.id, spv::DecorationDescriptorSet), compiler.get_decoration(uniform.id, spv::DecorationBinding), "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER" });
+	}
+	for (const auto& buffer : resources.storage_buffers)
+	{
+		table.push_back({ compiler.get_decoration(buffer.id, spv::DecorationDescriptorSet), compiler.get_decoration(buffer.id, spv::DecorationBinding), "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER" });
+	}
+	for (const auto& image : resources.sampled_images)
+	{
+		table.push_back({ compiler.get_decoration(image.id, spv::DecorationDescriptorSet), compiler.get_decoration(image.id, spv::DecorationBinding), "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER" });
+	}
+	for (const auto& image : resources.storage_images)
+	{
+		table.push_back({ compiler.get_decoration(image.id, spv::DecorationDescriptorSet), compiler.get_decoration(image.id, spv::DecorationBinding), "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE" });
+	}
+	std::sort(table.begin(), table.end());
+
+	size_t pushConstantSize = 0;
+	for (const auto& push : resources.push_constant_buffers)
+	{
+		pushConstantSize = compiler.get_declared_struct_size(compiler.get_type(push.base_type_id));
+	}
+
+	std::ofstream file(output, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to write " << output << "\n";
+		return 1;
+	}
+
+	file << "// Generated from " << name << " by ShaderEmbed, do not edit.\n"
+		<< "#pragma once\n\n"
+		<< "#include \"Core/EmbeddedShader.h\"\n\n"
+		<< "namespace Shaders {\n"
+		<< "\tnamespace Detail {\n"
+		<< "\t\tinline constexpr uint32_t " << identifier << "_code[] = {";
+	for (size_t i = 0; i < spirv.size(); i++)
+	{
+		file << (i % 8 == 0 ? "\n\t\t\t" : " ") << "0x" << std::hex << spirv[i] << std::dec << "u,";
+	}
+	file << "\n\t\t};\n";
+
+	if (!table.empty())
+	{
+		file << "\t\tinline constexpr ShaderResource " << identifier << "_resources[] = {\n";
+		for (const auto& resource : table)
+		{
+			file << "\t\t\t{ " << resource.set << ", " << resource.binding << ", " << resource.type << " },\n";
+		}
+		file << "\t\t};\n";
+	}
+	file << "\t}\n\n"
+		<< "\tinline constexpr EmbeddedShader " << identifier << "{ \"" << name << "\", " << stage << ", Detail::" << identifier << "_code, "
+		<< (table.empty() ? std::string("{}") : "Detail::" + identifier + "_resources") << ", " << pushConstantSize << " };\n"
+		<< "}\n";
+
+	return file.good() ? 0 : 1;
+}